@@ -0,0 +1,374 @@
+/* Codec throughput and quality on synthetic signals.
+ *
+ *     make bench && ./bench [frameSize] [options] [seconds=N] [csv=FILE]
+ *
+ * Every signal is coded with every profile: encode_frames() and decode_frames()
+ * are timed separately, best of BENCH_REPEATS runs from freshly constructed
+ * chunks, and the output is compared with the input, aligned by the codec delay.
+ * The options are those of main (entropy, dtx, sync, lifting, joint, qmf8 ...
+ * qmf64, bands2 ... bands16) plus stereo, which codes a second channel of the
+ * signal at 0.8 times its level with some noise of its own. The signals come from
+ * a fixed seed, so runs on different builds code the same samples; csv=FILE
+ * writes the results to FILE as comma separated values for tracking them. */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "globals.h"
+#include "codec.h"
+#include "profile.h"
+#include "quantizer.h"
+#include "dtx.h"
+#include "filterbank.h"
+#include "encode.h"
+#include "decode.h"
+#include "workers.h"
+
+/*Rate the signals are generated for, which sets the bit rates reported*/
+#define BENCH_RATE 8000
+#define BENCH_SECONDS 10
+#define BENCH_MAX_SECONDS 60
+#define BENCH_REPEATS 5
+
+/*Segments of segmental SNR, 20 ms, and their limits in dB*/
+#define BENCH_SEGMENT 160
+#define BENCH_SEGMENT_MIN -10.0
+#define BENCH_SEGMENT_MAX 35.0
+
+/*Longest codec delay searched, 16 subbands of 64 taps delay 945 samples*/
+#define BENCH_MAX_LAG 1024
+
+#define BENCH_SIGNALS 3
+
+#ifndef M_PI
+    #define M_PI 3.14159265358979323846
+#endif
+
+struct bench_result {
+    long words;
+    double encodeSeconds;
+    double decodeSeconds;
+    int lag;
+    double snr;
+    double segmentalSnr;
+};
+
+static const char *signalNames[BENCH_SIGNALS] = {"sweep", "noise", "speech"};
+
+static unsigned int seed;
+
+/* Uniform in [-1, 1) */
+static double _random()
+{
+    seed = seed * 1103515245u + 12345u;
+    return (double) (int) (seed & 0x7FFFFFFF) / 1073741824.0 - 1.0;
+}
+
+static double _now()
+{
+    #if defined(__unix__) || defined(__APPLE__)
+        struct timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec + now.tv_nsec * 1e-9;
+    #else
+        return (double) clock() / CLOCKS_PER_SEC;
+    #endif
+}
+
+/* Exponential sine sweep from 20 Hz to just below Nyquist at -6 dBFS */
+static void _sweep(double signal[], long samples)
+{
+    long t;
+    double f0 = 20.0;
+    double f1 = 0.48 * BENCH_RATE;
+    double duration = (double) samples / BENCH_RATE;
+    double k = log(f1 / f0);
+
+    for (t = 0 ; t < samples ; t++)
+        signal[t] = 0.5 * sin(2 * M_PI * f0 * duration / k * (exp(k * t / samples) - 1.0));
+}
+
+/* White noise at about -15 dBFS */
+static void _noise(double signal[], long samples)
+{
+    long t;
+
+    for (t = 0 ; t < samples ; t++)
+        signal[t] = 0.3 * _random();
+}
+
+/* Speech-like: two formant resonators in cascade, a fourth-order AR process,
+ * excited by a glottal pulse train of drifting pitch in voiced syllables and by
+ * noise in unvoiced ones, four syllables per second with pauses in between */
+static void _speech(double signal[], long samples)
+{
+    long t;
+    short f;
+    double syllable, envelope, excitation, phase = 0.0;
+    double peak = 0.0;
+    double formant[2], bandwidth[2] = {90.0, 140.0};
+    double a1[2], a2[2], y1[2] = {0.0, 0.0}, y2[2] = {0.0, 0.0}, y;
+    double pitch, r;
+    long index;
+
+    for (t = 0 ; t < samples ; t++) {
+        syllable = (double) t * 4 / BENCH_RATE;
+        index = (long) syllable;
+
+        // Formants move through each syllable, pitch drifts over the phrase
+        formant[0] = 350.0 + 350.0 * (0.5 + 0.5 * sin(2.3 * index + 3.0 * (syllable - index)));
+        formant[1] = 1000.0 + 1100.0 * (0.5 + 0.5 * sin(1.7 * index + 1.0 - 2.0 * (syllable - index)));
+        pitch = 110.0 + 40.0 * sin(2 * M_PI * t / (3.1 * BENCH_RATE));
+
+        envelope = (index % 5 == 4) ? 0.0 : sin(M_PI * (syllable - index));
+        phase += pitch / BENCH_RATE;
+        if (index % 3 == 2) {
+            excitation = 0.3 * _random();
+        } else if (phase >= 1.0) {
+            phase -= 1.0;
+            excitation = 1.0;
+        } else {
+            excitation = 0.02 * _random();
+        }
+
+        y = envelope * excitation;
+        for (f = 0 ; f < 2 ; f++) {
+            r = exp(-M_PI * bandwidth[f] / BENCH_RATE);
+            a1[f] = 2 * r * cos(2 * M_PI * formant[f] / BENCH_RATE);
+            a2[f] = -r * r;
+
+            y = y + a1[f] * y1[f] + a2[f] * y2[f];
+            y2[f] = y1[f];
+            y1[f] = y;
+        }
+
+        signal[t] = y;
+        if (fabs(y) > peak)
+            peak = fabs(y);
+    }
+
+    // Peaks at -6 dBFS
+    for (t = 0 ; t < samples ; t++)
+        signal[t] *= 0.5 / peak;
+}
+
+/* Interleaved pcm of the signal, the second channel at 0.8 times its level with noise at -50 dBFS */
+static void _pcm(const double signal[], long samples, short channels, short pcm[])
+{
+    long t;
+    short c;
+    double value;
+
+    for (t = 0 ; t < samples ; t++) {
+        for (c = 0 ; c < channels ; c++) {
+            value = (c == 0) ? signal[t] : 0.8 * signal[t] + 0.003 * _random();
+            pcm[t * channels + c] = (short) lrint(value * 32767.0);
+        }
+    }
+}
+
+/* SNR of output against pcm delayed by lag over the first samples */
+static double _snr(const short pcm[], const short output[], long samples, short channels, int lag)
+{
+    long i;
+    double signal = 0.0, error = 0.0, difference;
+
+    for (i = 0 ; i < (samples - lag) * channels ; i++) {
+        difference = (double) output[i + (long) lag * channels] - pcm[i];
+        signal += (double) pcm[i] * pcm[i];
+        error += difference * difference;
+    }
+
+    return 10.0 * log10((signal + 1.0) / (error + 1.0));
+}
+
+/* Mean SNR of the segments that are not silent, each limited to the segment range */
+static double _segmental_snr(const short pcm[], const short output[], long samples, short channels, int lag)
+{
+    long i, s, count = 0;
+    long segment = (long) BENCH_SEGMENT * channels;
+    double signal, error, difference, snr, sum = 0.0;
+
+    for (s = 0 ; s + segment <= (samples - lag) * channels ; s += segment) {
+        signal = 0.0;
+        error = 0.0;
+        for (i = s ; i < s + segment ; i++) {
+            difference = (double) output[i + (long) lag * channels] - pcm[i];
+            signal += (double) pcm[i] * pcm[i];
+            error += difference * difference;
+        }
+
+        // Below -60 dBFS the segment is a pause
+        if (signal < segment * 1073.0)
+            continue;
+
+        snr = 10.0 * log10((signal + 1.0) / (error + 1.0));
+        sum += (snr < BENCH_SEGMENT_MIN) ? BENCH_SEGMENT_MIN : (snr > BENCH_SEGMENT_MAX ? BENCH_SEGMENT_MAX : snr);
+        count++;
+    }
+
+    return count > 0 ? sum / count : 0.0;
+}
+
+/* Codes the pcm BENCH_REPEATS times, keeping the fastest encode and decode */
+static void _run(const short pcm[], short output[], short encoded[], int frames, short channels, short frameSize, const struct profile_struct *profile, const struct qmf_struct *qmf, short flags, struct bench_result *result)
+{
+    static struct encode_chunk_struct encodeChunk[MAX_CHANNELS];
+    static struct decode_chunk_struct decodeChunk[MAX_CHANNELS];
+    struct encode_chunk_struct *encodeChunks[MAX_CHANNELS];
+    struct decode_chunk_struct *decodeChunks[MAX_CHANNELS];
+    short r, c;
+    int lag, best = 0;
+    long samples = (long) frames * frameSize;
+    double start, elapsed, snr;
+
+    result->encodeSeconds = 1e30;
+    result->decodeSeconds = 1e30;
+
+    for (r = 0 ; r < BENCH_REPEATS ; r++) {
+        for (c = 0 ; c < channels ; c++) {
+            encodeChunks[c] = &encodeChunk[c];
+            decodeChunks[c] = &decodeChunk[c];
+            encode_construct(encodeChunks[c], frameSize, profile, qmf, flags);
+            decode_construct(decodeChunks[c], frameSize, profile, qmf, flags);
+        }
+
+        start = _now();
+        result->words = encode_frames(pcm, frames, encodeChunks, channels, encoded);
+        elapsed = _now() - start;
+        if (elapsed < result->encodeSeconds)
+            result->encodeSeconds = elapsed;
+
+        start = _now();
+        decode_frames(decodeChunks, channels, encoded, frames, output);
+        elapsed = _now() - start;
+        if (elapsed < result->decodeSeconds)
+            result->decodeSeconds = elapsed;
+    }
+
+    // The delay depends on the configuration only, found on the first second
+    result->snr = -1e30;
+    for (lag = 0 ; lag < BENCH_MAX_LAG && lag < samples / 2 ; lag++) {
+        snr = _snr(pcm, output, (samples < BENCH_RATE) ? samples : BENCH_RATE, channels, lag);
+        if (snr > result->snr) {
+            result->snr = snr;
+            best = lag;
+        }
+    }
+
+    result->lag = best;
+    result->snr = _snr(pcm, output, samples, channels, best);
+    result->segmentalSnr = _segmental_snr(pcm, output, samples, channels, best);
+}
+
+int main(int argc, char **argv)
+{
+    short frameSize, flags, depth, channels = 1;
+    short s, p;
+    int option, frames, seconds = BENCH_SECONDS;
+    long samples;
+    double bits, encodeNs, decodeNs;
+    const char *csvName = NULL;
+    const struct profile_struct *profile;
+    const struct qmf_struct *qmf;
+    struct bench_result result;
+    FILE *csv = NULL;
+
+    static double signal[BENCH_MAX_SECONDS * BENCH_RATE];
+    static short pcm[2 * BENCH_MAX_SECONDS * BENCH_RATE];
+    static short output[2 * BENCH_MAX_SECONDS * BENCH_RATE];
+    static short encoded[2 * BENCH_MAX_SECONDS * BENCH_RATE];
+
+    frameSize = (argc > 1) ? (short) atoi(argv[1]) : 160;
+    flags = 0;
+    depth = PROFILE_DEPTH;
+    qmf = &qmf_filters[QMF_DEFAULT];
+
+    for (option = 2 ; option < argc ; option++) {
+        if (strcmp(argv[option], "entropy") == 0) {
+            flags |= CODEC_ENTROPY;
+        } else if (strcmp(argv[option], "dtx") == 0) {
+            flags |= CODEC_DTX;
+        } else if (strcmp(argv[option], "sync") == 0) {
+            flags |= CODEC_SYNC;
+        } else if (strcmp(argv[option], "lifting") == 0) {
+            flags |= CODEC_LIFTING;
+        } else if (strcmp(argv[option], "joint") == 0) {
+            flags |= CODEC_JOINT;
+        } else if (strcmp(argv[option], "stereo") == 0) {
+            channels = 2;
+        } else if (qmf_find(argv[option]) != NULL) {
+            qmf = qmf_find(argv[option]);
+        } else if (strncmp(argv[option], "bands", 5) == 0 && atoi(argv[option] + 5) >= 2) {
+            for (depth = 1 ; depth < MAX_DEPTH && (2 << depth) <= atoi(argv[option] + 5) ; depth++) {}
+        } else if (strncmp(argv[option], "seconds=", 8) == 0) {
+            seconds = atoi(argv[option] + 8);
+        } else if (strncmp(argv[option], "csv=", 4) == 0) {
+            csvName = argv[option] + 4;
+        } else {
+            printf("Error: unknown option %s, expected entropy, dtx, sync, lifting, joint, stereo, qmf8 ... qmf64, bands2 ... bands16, seconds=N or csv=FILE.\n", argv[option]);
+            exit(1);
+        }
+    }
+
+    if (frameSize < MIN_FRAMESIZE * GROUPS(depth) || frameSize > MAX_FRAMESIZE || (frameSize % (GROUPS(depth) << 2))) {
+        printf("Error: frame size must be a multiple of %d between %d and %d for %d subbands.\n", GROUPS(depth) << 2, MIN_FRAMESIZE * GROUPS(depth), MAX_FRAMESIZE, 1 << depth);
+        exit(1);
+    }
+    if (seconds < 1 || seconds > BENCH_MAX_SECONDS) {
+        printf("Error: seconds must be between 1 and %d.\n", BENCH_MAX_SECONDS);
+        exit(1);
+    }
+
+    if (csvName != NULL) {
+        csv = fopen(csvName, "w");
+        if (csv == NULL) {
+            printf("Error: cannot write %s.\n", csvName);
+            exit(1);
+        }
+        fprintf(csv, "signal,profile,frame_size,flags,filter,subbands,channels,bits_per_sample,kbps,encode_fps,encode_ns_per_sample,decode_fps,decode_ns_per_sample,delay,snr_db,segmental_snr_db\n");
+    }
+
+    filterbank_construct();
+    workers_construct(channels > 2 ? channels / 2 - 1 : 0);
+
+    frames = seconds * BENCH_RATE / frameSize;
+    samples = (long) frames * frameSize;
+
+    printf("\n%-7s %-8s %6s %8s %10s %8s %10s %8s %6s %7s %7s\n", "signal", "profile", "bits", "kbit/s", "enc fps", "enc ns", "dec fps", "dec ns", "delay", "SNR", "segSNR");
+    for (s = 0 ; s < BENCH_SIGNALS ; s++) {
+        seed = 1;
+        if (s == 0)
+            _sweep(signal, samples);
+        else if (s == 1)
+            _noise(signal, samples);
+        else
+            _speech(signal, samples);
+        _pcm(signal, samples, channels, pcm);
+
+        for (p = 0 ; p < PROFILE_COUNT ; p++) {
+            profile = profile_find(profiles[p].name, depth);
+            _run(pcm, output, encoded, frames, channels, frameSize, profile, qmf, flags, &result);
+
+            // Per temporal sample of one channel
+            bits = result.words * 16.0 / samples / channels;
+            encodeNs = result.encodeSeconds * 1e9 / samples / channels;
+            decodeNs = result.decodeSeconds * 1e9 / samples / channels;
+
+            printf("%-7s %-8s %6.2f %8.1f %10.0f %8.1f %10.0f %8.1f %6d %7.2f %7.2f\n", signalNames[s], profile->name, bits, bits * BENCH_RATE / 1000.0,
+                frames / result.encodeSeconds, encodeNs, frames / result.decodeSeconds, decodeNs, result.lag, result.snr, result.segmentalSnr);
+
+            if (csv != NULL)
+                fprintf(csv, "%s,%s,%d,%d,%s,%d,%d,%.4f,%.3f,%.1f,%.3f,%.1f,%.3f,%d,%.3f,%.3f\n", signalNames[s], profile->name, frameSize, flags, (flags & CODEC_LIFTING) ? "lifting" : qmf->name,
+                    1 << depth, channels, bits, bits * BENCH_RATE / 1000.0, frames / result.encodeSeconds, encodeNs, frames / result.decodeSeconds, decodeNs, result.lag, result.snr, result.segmentalSnr);
+        }
+    }
+
+    if (csv != NULL)
+        fclose(csv);
+    workers_destruct();
+
+    return 0;
+}
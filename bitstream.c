@@ -0,0 +1,68 @@
+#include "globals.h"
+#include "codec.h"
+#include "profile.h"
+#include "bitstream.h"
+
+/* Number of 16-bit words in one encoded channel frame */
+short bitstream_size(const struct profile_struct *profile, short frameSize, short skip) {
+    short g;
+    short groups = GROUPS(profile->depth);
+    int bits = skip;
+
+    for (g = 0; g < groups; g++)
+        bits += (profile[g].nbits[0] + profile[g].nbits[1] + profile[g].nbits[2] + profile[g].nbits[3]) * (frameSize / groups >> 2);
+
+    return (short) ((bits + 15) >> 4);
+}
+
+/* The accumulator never holds more than 15 + MAX_NBITS pending bits */
+void bitstream_pack(const struct profile_struct *profile, short *restrict encoded, const short *restrict levels, short frameSize, short skip) {
+    short i, s, g;
+    short groups = GROUPS(profile->depth);
+    short count = (frameSize / groups >> 2) << 2;
+    short fill = skip;
+    unsigned int acc = (unsigned short) *encoded >> (16 - skip);
+
+    for (g = 0; g < groups; g++, profile++, levels += frameSize / groups) {
+        for (i = 0; i < count; i++) {
+            s = i & 3;
+            acc = (acc << profile->nbits[s]) | (unsigned int) (levels[i] - profile->minLevel[s]);
+            fill += profile->nbits[s];
+
+            if (fill >= 16) {
+                fill -= 16;
+                *encoded++ = (short) (acc >> fill);
+            }
+        }
+    }
+
+    if (fill > 0)
+        *encoded = (short) (acc << (16 - fill));
+}
+
+void bitstream_unpack(const struct profile_struct *profile, short *restrict levels, const short *restrict encoded, short frameSize, short skip) {
+    short i, s, g;
+    short groups = GROUPS(profile->depth);
+    short count = (frameSize / groups >> 2) << 2;
+    short fill = 0;
+    unsigned int acc = 0;
+
+    if (skip > 0) {
+        acc = (unsigned short) *encoded++;
+        fill = 16 - skip;
+    }
+
+    for (g = 0; g < groups; g++, profile++, levels += frameSize / groups) {
+        for (i = 0; i < count; i++) {
+            s = i & 3;
+
+            if (fill < profile->nbits[s]) {
+                acc = (acc << 16) | (unsigned short) *encoded++;
+                fill += 16;
+            }
+
+            fill -= profile->nbits[s];
+            levels[i] = (short) ((acc >> fill) & ((1u << profile->nbits[s]) - 1)) + profile->minLevel[s];
+        }
+    }
+}
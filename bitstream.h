@@ -0,0 +1,16 @@
+#ifndef __ENC_BITSTREAM_H__
+#define __ENC_BITSTREAM_H__
+
+/* Bit grouping of the quantised subband levels.
+ *
+ * levels[] holds the subband levels of one channel in the layout of codec.h,
+ * each packed MSB first at the nbits of its group's profile into consecutive
+ * 16-bit words, block by block; subbands of 0 bits are skipped. The last word is
+ * zero padded, so every channel section of a frame starts on a word boundary.
+ * The levels start skip bits into the first word, whose top skip bits belong to
+ * the caller and are kept. */
+short bitstream_size(const struct profile_struct *profile, short frameSize, short skip);
+void bitstream_pack(const struct profile_struct *profile, short *restrict encoded, const short *restrict levels, short frameSize, short skip);
+void bitstream_unpack(const struct profile_struct *profile, short *restrict levels, const short *restrict encoded, short frameSize, short skip);
+
+#endif
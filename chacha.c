@@ -0,0 +1,558 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "chacha.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define __ENC_CHACHA_X86__
+    #include <immintrin.h>
+#endif
+
+// State words of the vector backend, one lane per block, in SSE2 or NEON
+// registers where the compiler has vector extensions
+#if defined(__GNUC__)
+    typedef uint32_t chacha_vector_t __attribute__((vector_size(16)));
+    #define CHACHA_LANES 4
+#else
+    typedef uint32_t chacha_vector_t;
+    #define CHACHA_LANES 1
+#endif
+
+#define CHACHA_WIDE_LANES 8
+
+// Keystream generated per step of chacha_encrypt
+#define CHACHA_BATCH_BLOCKS 8
+
+#define ROTATE(x, n) (((x) << (n)) | ((x) >> (32-(n))))
+
+#define QUARTER_ROUND(a, b, c, d, rotate) { \
+    a += b; d ^= a; d = rotate(d, 16); \
+    c += d; b ^= c; b = rotate(b, 12); \
+    a += b; d ^= a; d = rotate(d, 8); \
+    c += d; b ^= c; b = rotate(b, 7); }
+
+// A column round and a diagonal round, on scalars and vectors alike
+#define DOUBLE_ROUND(x, rotate) { \
+    QUARTER_ROUND(x[0], x[4], x[8], x[12], rotate); \
+    QUARTER_ROUND(x[1], x[5], x[9], x[13], rotate); \
+    QUARTER_ROUND(x[2], x[6], x[10], x[14], rotate); \
+    QUARTER_ROUND(x[3], x[7], x[11], x[15], rotate); \
+    QUARTER_ROUND(x[0], x[5], x[10], x[15], rotate); \
+    QUARTER_ROUND(x[1], x[6], x[11], x[12], rotate); \
+    QUARTER_ROUND(x[2], x[7], x[8], x[13], rotate); \
+    QUARTER_ROUND(x[3], x[4], x[9], x[14], rotate); }
+
+typedef void (*chacha_blocks_t)(const uint8_t *restrict key, const uint8_t *restrict nonce, uint32_t firstBlock, size_t blocks, uint8_t *restrict keystream);
+
+static chacha_blocks_t blocksKernel = NULL;
+#if defined(__GNUC__) && defined(__SSE2__)
+    static const char *chacha_name = "sse2";
+#elif defined(__GNUC__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+    static const char *chacha_name = "neon";
+#elif defined(__GNUC__)
+    static const char *chacha_name = "vector";
+#else
+    static const char *chacha_name = "scalar";
+#endif
+
+static inline uint32_t _chacha_load32(const uint8_t *bytes) {
+    return (uint32_t) bytes[0] | ((uint32_t) bytes[1] << 8) | ((uint32_t) bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+static inline void _chacha_store32(uint8_t *bytes, uint32_t x) {
+    bytes[0] = (uint8_t) x;
+    bytes[1] = (uint8_t) (x >> 8);
+    bytes[2] = (uint8_t) (x >> 16);
+    bytes[3] = (uint8_t) (x >> 24);
+}
+
+static void _chacha_state(uint32_t *restrict state, const uint8_t *restrict key, const uint8_t *restrict nonce) {
+    int i;
+
+    // "expand 32-byte k"
+    state[0] = 0x61707865;
+    state[1] = 0x3320646e;
+    state[2] = 0x79622d32;
+    state[3] = 0x6b206574;
+
+    for (i = 0; i < 8; i++)
+        state[4+i] = _chacha_load32(key+4*i);
+
+    state[12] = 0;
+    for (i = 0; i < 3; i++)
+        state[13+i] = _chacha_load32(nonce+4*i);
+}
+
+static void _chacha_blocks_vector(const uint8_t *restrict key, const uint8_t *restrict nonce, uint32_t firstBlock, size_t blocks, uint8_t *restrict keystream) {
+    int i, l, r;
+    size_t done;
+    size_t length;
+
+    uint32_t state[16];
+    uint32_t word;
+    uint32_t words[16*CHACHA_LANES];
+    uint8_t output[CHACHA_LANES*CHACHA_BLOCK_CHARS];
+    chacha_vector_t lanes;
+    chacha_vector_t input[16];
+    chacha_vector_t x[16];
+
+    _chacha_state(state, key, nonce);
+
+    // Every lane starts from the same state, but for the block counter
+    memset(&lanes, 0, sizeof(chacha_vector_t));
+    for (l = 0; l < CHACHA_LANES; l++) {
+        word = (uint32_t) l;
+        memcpy((uint32_t *) &lanes + l, &word, sizeof(uint32_t));
+    }
+    for (i = 0; i < 16; i++)
+        input[i] = lanes - lanes + state[i];
+
+    for (done = 0; done < blocks; done += CHACHA_LANES) {
+        input[12] = lanes + (firstBlock + (uint32_t) done);
+
+        for (i = 0; i < 16; i++)
+            x[i] = input[i];
+        for (r = 0; r < 10; r++)
+            DOUBLE_ROUND(x, ROTATE);
+        for (i = 0; i < 16; i++)
+            x[i] += input[i];
+
+        memcpy(words, x, sizeof(x));
+        for (l = 0; l < CHACHA_LANES; l++) {
+            for (i = 0; i < 16; i++)
+                _chacha_store32(output+l*CHACHA_BLOCK_CHARS+4*i, words[i*CHACHA_LANES+l]);
+        }
+
+        // The last pass may fill only some of its blocks
+        length = blocks - done < CHACHA_LANES ? blocks - done : CHACHA_LANES;
+        memcpy(keystream+done*CHACHA_BLOCK_CHARS, output, length*CHACHA_BLOCK_CHARS);
+    }
+}
+
+#ifdef __ENC_CHACHA_X86__
+    typedef uint32_t chacha_wide_t __attribute__((vector_size(32)));
+    typedef uint8_t chacha_wide_bytes_t __attribute__((vector_size(32)));
+
+    // Rotations by whole bytes as one byte shuffle within each word, with the caller's
+    // rotate16 and rotate8, the others by shifts
+    #define ROTATE_BYTES(x, n) ((n) == 16 ? (chacha_wide_t) __builtin_shuffle((chacha_wide_bytes_t) (x), rotate16) : \
+        (n) == 8 ? (chacha_wide_t) __builtin_shuffle((chacha_wide_bytes_t) (x), rotate8) : ROTATE(x, n))
+
+    // Stores the 8 blocks of x, which holds word i of every block in x[i], one per lane.
+    // Two unpacks give 4 words of 4 blocks per 128 bit half, a lane permute joins
+    // the halves of a block.
+    __attribute__((target("avx2")))
+    static void _chacha_store_avx2(const chacha_wide_t *restrict x, uint8_t *restrict keystream) {
+        int g, k;
+
+        __m256i t[4];
+        __m256i y[4][4];
+
+        for (g = 0; g < 4; g++) {
+            t[0] = _mm256_unpacklo_epi32((__m256i) x[4*g], (__m256i) x[4*g+1]);
+            t[1] = _mm256_unpackhi_epi32((__m256i) x[4*g], (__m256i) x[4*g+1]);
+            t[2] = _mm256_unpacklo_epi32((__m256i) x[4*g+2], (__m256i) x[4*g+3]);
+            t[3] = _mm256_unpackhi_epi32((__m256i) x[4*g+2], (__m256i) x[4*g+3]);
+
+            // Words 4g to 4g+3 of block k in the low half and of block k+4 in the high half
+            y[g][0] = _mm256_unpacklo_epi64(t[0], t[2]);
+            y[g][1] = _mm256_unpackhi_epi64(t[0], t[2]);
+            y[g][2] = _mm256_unpacklo_epi64(t[1], t[3]);
+            y[g][3] = _mm256_unpackhi_epi64(t[1], t[3]);
+        }
+
+        for (k = 0; k < 4; k++) {
+            _mm256_storeu_si256((__m256i *) (keystream+k*CHACHA_BLOCK_CHARS), _mm256_permute2x128_si256(y[0][k], y[1][k], 0x20));
+            _mm256_storeu_si256((__m256i *) (keystream+k*CHACHA_BLOCK_CHARS+32), _mm256_permute2x128_si256(y[2][k], y[3][k], 0x20));
+            _mm256_storeu_si256((__m256i *) (keystream+(k+4)*CHACHA_BLOCK_CHARS), _mm256_permute2x128_si256(y[0][k], y[1][k], 0x31));
+            _mm256_storeu_si256((__m256i *) (keystream+(k+4)*CHACHA_BLOCK_CHARS+32), _mm256_permute2x128_si256(y[2][k], y[3][k], 0x31));
+        }
+    }
+
+    // The vector backend with 8 blocks in AVX2 registers. x86 is little endian, so the
+    // transposed words are the keystream bytes.
+    __attribute__((target("avx2")))
+    static void _chacha_blocks_avx2(const uint8_t *restrict key, const uint8_t *restrict nonce, uint32_t firstBlock, size_t blocks, uint8_t *restrict keystream) {
+        int i, r;
+        size_t done;
+
+        uint32_t state[16];
+        uint8_t output[CHACHA_WIDE_LANES*CHACHA_BLOCK_CHARS];
+        chacha_wide_t lanes = {0, 1, 2, 3, 4, 5, 6, 7};
+        chacha_wide_bytes_t rotate16 = {2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13, 18, 19, 16, 17, 22, 23, 20, 21, 26, 27, 24, 25, 30, 31, 28, 29};
+        chacha_wide_bytes_t rotate8 = {3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14, 19, 16, 17, 18, 23, 20, 21, 22, 27, 24, 25, 26, 31, 28, 29, 30};
+        chacha_wide_t input[16];
+        chacha_wide_t x[16];
+
+        _chacha_state(state, key, nonce);
+
+        for (i = 0; i < 16; i++)
+            input[i] = lanes - lanes + state[i];
+
+        for (done = 0; done < blocks; done += CHACHA_WIDE_LANES) {
+            input[12] = lanes + (firstBlock + (uint32_t) done);
+
+            for (i = 0; i < 16; i++)
+                x[i] = input[i];
+            for (r = 0; r < 10; r++)
+                DOUBLE_ROUND(x, ROTATE_BYTES);
+            for (i = 0; i < 16; i++)
+                x[i] += input[i];
+
+            // The last pass may fill only some of its blocks, as for a single packet
+            if (blocks - done >= CHACHA_WIDE_LANES) {
+                _chacha_store_avx2(x, keystream+done*CHACHA_BLOCK_CHARS);
+            } else {
+                _chacha_store_avx2(x, output);
+                memcpy(keystream+done*CHACHA_BLOCK_CHARS, output, (blocks - done)*CHACHA_BLOCK_CHARS);
+            }
+        }
+    }
+#endif
+
+// Picks the backend, once
+static void _chacha_setup() {
+    blocksKernel = _chacha_blocks_vector;
+
+    #ifdef __ENC_CHACHA_X86__
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2")) {
+            blocksKernel = _chacha_blocks_avx2;
+            chacha_name = "avx2";
+        }
+    #endif
+
+    #ifndef __ENC_NO_PRINTS__
+        printf("ChaCha20 backend: %s\n", chacha_name);
+    #endif
+}
+
+// Poly1305 after poly1305-donna, in three 44 bit limbs where the compiler has 128 bit
+// products and in five 26 bit limbs elsewhere
+#if defined(__SIZEOF_INT128__)
+    struct chacha_poly1305 {
+        uint64_t r[3];
+        uint64_t h[3];
+        uint64_t pad[2];
+    };
+
+    static inline uint64_t _chacha_load64(const uint8_t *bytes) {
+        return (uint64_t) _chacha_load32(bytes) | ((uint64_t) _chacha_load32(bytes+4) << 32);
+    }
+
+    static void _chacha_poly_init(struct chacha_poly1305 *restrict mac, const uint8_t *restrict oneTimeKey) {
+        uint64_t t0 = _chacha_load64(oneTimeKey);
+        uint64_t t1 = _chacha_load64(oneTimeKey+8);
+
+        // r clamped as RFC 8439 requires
+        mac->r[0] = t0 & 0xffc0fffffff;
+        mac->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffff;
+        mac->r[2] = (t1 >> 24) & 0x00ffffffc0f;
+
+        mac->h[0] = mac->h[1] = mac->h[2] = 0;
+        mac->pad[0] = _chacha_load64(oneTimeKey+16);
+        mac->pad[1] = _chacha_load64(oneTimeKey+24);
+    }
+
+    // Folds size bytes into the hash, the last block padded with zeros as the AEAD pads its fields
+    static void _chacha_poly_update(struct chacha_poly1305 *restrict mac, const uint8_t *restrict data, size_t size) {
+        size_t offset;
+
+        uint8_t block[16];
+        uint64_t r0 = mac->r[0], r1 = mac->r[1], r2 = mac->r[2];
+        uint64_t s1 = r1*(5 << 2), s2 = r2*(5 << 2);
+        uint64_t h0 = mac->h[0], h1 = mac->h[1], h2 = mac->h[2];
+        uint64_t c, t0, t1;
+        unsigned __int128 d0, d1, d2;
+        const uint8_t *m;
+
+        for (offset = 0; offset < size; offset += 16) {
+            m = data+offset;
+            if (size - offset < 16) {
+                memset(block, 0, 16);
+                memcpy(block, m, size - offset);
+                m = block;
+            }
+
+            // h += m, with the bit above the block set
+            t0 = _chacha_load64(m);
+            t1 = _chacha_load64(m+8);
+            h0 += t0 & 0xfffffffffff;
+            h1 += ((t0 >> 44) | (t1 << 20)) & 0xfffffffffff;
+            h2 += ((t1 >> 24) & 0x3ffffffffff) | ((uint64_t) 1 << 40);
+
+            // h *= r, modulo 2^130 - 5
+            d0 = (unsigned __int128) h0*r0 + (unsigned __int128) h1*s2 + (unsigned __int128) h2*s1;
+            d1 = (unsigned __int128) h0*r1 + (unsigned __int128) h1*r0 + (unsigned __int128) h2*s2;
+            d2 = (unsigned __int128) h0*r2 + (unsigned __int128) h1*r1 + (unsigned __int128) h2*r0;
+
+            c = (uint64_t) (d0 >> 44); h0 = (uint64_t) d0 & 0xfffffffffff;
+            d1 += c; c = (uint64_t) (d1 >> 44); h1 = (uint64_t) d1 & 0xfffffffffff;
+            d2 += c; c = (uint64_t) (d2 >> 42); h2 = (uint64_t) d2 & 0x3ffffffffff;
+            h0 += c*5; c = h0 >> 44; h0 &= 0xfffffffffff;
+            h1 += c;
+        }
+
+        mac->h[0] = h0;
+        mac->h[1] = h1;
+        mac->h[2] = h2;
+    }
+
+    // h fully reduced and masked with the pad
+    static void _chacha_poly_finish(struct chacha_poly1305 *restrict mac, uint8_t *restrict tag) {
+        int i;
+
+        uint64_t h0 = mac->h[0], h1 = mac->h[1], h2 = mac->h[2];
+        uint64_t g0, g1, g2;
+        uint64_t c, mask;
+
+        c = h1 >> 44; h1 &= 0xfffffffffff;
+        h2 += c; c = h2 >> 42; h2 &= 0x3ffffffffff;
+        h0 += c*5; c = h0 >> 44; h0 &= 0xfffffffffff;
+        h1 += c; c = h1 >> 44; h1 &= 0xfffffffffff;
+        h2 += c; c = h2 >> 42; h2 &= 0x3ffffffffff;
+        h0 += c*5; c = h0 >> 44; h0 &= 0xfffffffffff;
+        h1 += c;
+
+        // g = h + 5 - 2^130, taken without a branch if it does not borrow
+        g0 = h0 + 5; c = g0 >> 44; g0 &= 0xfffffffffff;
+        g1 = h1 + c; c = g1 >> 44; g1 &= 0xfffffffffff;
+        g2 = h2 + c - ((uint64_t) 1 << 42);
+
+        mask = (g2 >> 63) - 1;
+        h0 = (h0 & ~mask) | (g0 & mask);
+        h1 = (h1 & ~mask) | (g1 & mask);
+        h2 = (h2 & ~mask) | (g2 & mask);
+
+        h0 += mac->pad[0] & 0xfffffffffff; c = h0 >> 44; h0 &= 0xfffffffffff;
+        h1 += (((mac->pad[0] >> 44) | (mac->pad[1] << 20)) & 0xfffffffffff) + c; c = h1 >> 44; h1 &= 0xfffffffffff;
+        h2 += ((mac->pad[1] >> 24) & 0x3ffffffffff) + c;
+
+        h0 = h0 | (h1 << 44);
+        h1 = (h1 >> 20) | (h2 << 24);
+
+        for (i = 0; i < 8; i++) {
+            tag[i] = (uint8_t) (h0 >> (8*i));
+            tag[8+i] = (uint8_t) (h1 >> (8*i));
+        }
+    }
+#else
+    struct chacha_poly1305 {
+        uint32_t r[5];
+        uint32_t h[5];
+        uint32_t pad[4];
+    };
+
+    static void _chacha_poly_init(struct chacha_poly1305 *restrict mac, const uint8_t *restrict oneTimeKey) {
+        int i;
+
+        // r clamped as RFC 8439 requires
+        mac->r[0] = _chacha_load32(oneTimeKey) & 0x3ffffff;
+        mac->r[1] = (_chacha_load32(oneTimeKey+3) >> 2) & 0x3ffff03;
+        mac->r[2] = (_chacha_load32(oneTimeKey+6) >> 4) & 0x3ffc0ff;
+        mac->r[3] = (_chacha_load32(oneTimeKey+9) >> 6) & 0x3f03fff;
+        mac->r[4] = (_chacha_load32(oneTimeKey+12) >> 8) & 0x00fffff;
+
+        for (i = 0; i < 5; i++)
+            mac->h[i] = 0;
+        for (i = 0; i < 4; i++)
+            mac->pad[i] = _chacha_load32(oneTimeKey+16+4*i);
+    }
+
+    // Folds size bytes into the hash, the last block padded with zeros as the AEAD pads its fields
+    static void _chacha_poly_update(struct chacha_poly1305 *restrict mac, const uint8_t *restrict data, size_t size) {
+        size_t offset;
+
+        uint8_t block[16];
+        uint32_t r0 = mac->r[0], r1 = mac->r[1], r2 = mac->r[2], r3 = mac->r[3], r4 = mac->r[4];
+        uint32_t s1 = r1*5, s2 = r2*5, s3 = r3*5, s4 = r4*5;
+        uint32_t h0 = mac->h[0], h1 = mac->h[1], h2 = mac->h[2], h3 = mac->h[3], h4 = mac->h[4];
+        uint32_t c;
+        uint64_t d0, d1, d2, d3, d4;
+        const uint8_t *m;
+
+        for (offset = 0; offset < size; offset += 16) {
+            m = data+offset;
+            if (size - offset < 16) {
+                memset(block, 0, 16);
+                memcpy(block, m, size - offset);
+                m = block;
+            }
+
+            // h += m, with the bit above the block set
+            h0 += _chacha_load32(m) & 0x3ffffff;
+            h1 += (_chacha_load32(m+3) >> 2) & 0x3ffffff;
+            h2 += (_chacha_load32(m+6) >> 4) & 0x3ffffff;
+            h3 += (_chacha_load32(m+9) >> 6) & 0x3ffffff;
+            h4 += (_chacha_load32(m+12) >> 8) | (1 << 24);
+
+            // h *= r, modulo 2^130 - 5
+            d0 = (uint64_t) h0*r0 + (uint64_t) h1*s4 + (uint64_t) h2*s3 + (uint64_t) h3*s2 + (uint64_t) h4*s1;
+            d1 = (uint64_t) h0*r1 + (uint64_t) h1*r0 + (uint64_t) h2*s4 + (uint64_t) h3*s3 + (uint64_t) h4*s2;
+            d2 = (uint64_t) h0*r2 + (uint64_t) h1*r1 + (uint64_t) h2*r0 + (uint64_t) h3*s4 + (uint64_t) h4*s3;
+            d3 = (uint64_t) h0*r3 + (uint64_t) h1*r2 + (uint64_t) h2*r1 + (uint64_t) h3*r0 + (uint64_t) h4*s4;
+            d4 = (uint64_t) h0*r4 + (uint64_t) h1*r3 + (uint64_t) h2*r2 + (uint64_t) h3*r1 + (uint64_t) h4*r0;
+
+            c = (uint32_t) (d0 >> 26); h0 = (uint32_t) d0 & 0x3ffffff;
+            d1 += c; c = (uint32_t) (d1 >> 26); h1 = (uint32_t) d1 & 0x3ffffff;
+            d2 += c; c = (uint32_t) (d2 >> 26); h2 = (uint32_t) d2 & 0x3ffffff;
+            d3 += c; c = (uint32_t) (d3 >> 26); h3 = (uint32_t) d3 & 0x3ffffff;
+            d4 += c; c = (uint32_t) (d4 >> 26); h4 = (uint32_t) d4 & 0x3ffffff;
+            h0 += c*5; c = h0 >> 26; h0 &= 0x3ffffff;
+            h1 += c;
+        }
+
+        mac->h[0] = h0;
+        mac->h[1] = h1;
+        mac->h[2] = h2;
+        mac->h[3] = h3;
+        mac->h[4] = h4;
+    }
+
+    // h fully reduced and masked with the pad
+    static void _chacha_poly_finish(struct chacha_poly1305 *restrict mac, uint8_t *restrict tag) {
+        uint32_t h0, h1, h2, h3, h4;
+        uint32_t g0, g1, g2, g3, g4;
+        uint32_t c, mask;
+        uint64_t f;
+
+        h0 = mac->h[0]; h1 = mac->h[1]; h2 = mac->h[2]; h3 = mac->h[3]; h4 = mac->h[4];
+
+        c = h1 >> 26; h1 &= 0x3ffffff;
+        h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+        h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+        h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+        h0 += c*5; c = h0 >> 26; h0 &= 0x3ffffff;
+        h1 += c;
+
+        // g = h + 5 - 2^130, taken without a branch if it does not borrow
+        g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+        g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+        g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+        g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+        g4 = h4 + c - (1 << 26);
+
+        mask = (g4 >> 31) - 1;
+        h0 = (h0 & ~mask) | (g0 & mask);
+        h1 = (h1 & ~mask) | (g1 & mask);
+        h2 = (h2 & ~mask) | (g2 & mask);
+        h3 = (h3 & ~mask) | (g3 & mask);
+        h4 = (h4 & ~mask) | (g4 & mask);
+
+        h0 = h0 | (h1 << 26);
+        h1 = (h1 >> 6) | (h2 << 20);
+        h2 = (h2 >> 12) | (h3 << 14);
+        h3 = (h3 >> 18) | (h4 << 8);
+
+        f = (uint64_t) h0 + mac->pad[0]; _chacha_store32(tag, (uint32_t) f);
+        f = (uint64_t) h1 + mac->pad[1] + (f >> 32); _chacha_store32(tag+4, (uint32_t) f);
+        f = (uint64_t) h2 + mac->pad[2] + (f >> 32); _chacha_store32(tag+8, (uint32_t) f);
+        f = (uint64_t) h3 + mac->pad[3] + (f >> 32); _chacha_store32(tag+12, (uint32_t) f);
+    }
+#endif
+
+// The lengths of aad and data close the hashed message
+static void _chacha_poly_lengths(struct chacha_poly1305 *restrict mac, size_t aadSize, size_t size) {
+    int i;
+
+    uint8_t lengths[16];
+
+    for (i = 0; i < 8; i++) {
+        lengths[i] = (uint8_t) ((uint64_t) aadSize >> (8*i));
+        lengths[8+i] = (uint8_t) ((uint64_t) size >> (8*i));
+    }
+    _chacha_poly_update(mac, lengths, 16);
+}
+
+// The size of the batch of data starting at offset
+static size_t _chacha_batch(size_t size, size_t offset) {
+    if (size - offset > CHACHA_BATCH_BLOCKS*CHACHA_BLOCK_CHARS)
+        return CHACHA_BATCH_BLOCKS*CHACHA_BLOCK_CHARS;
+
+    return size - offset;
+}
+
+void chacha_blocks(const uint8_t *restrict key, const uint8_t *restrict nonce, uint32_t firstBlock, size_t blocks, uint8_t *restrict keystream) {
+    if (blocksKernel == NULL)
+        _chacha_setup();
+
+    blocksKernel(key, nonce, firstBlock, blocks, keystream);
+}
+
+void chacha_encrypt(const uint8_t *restrict key, const uint8_t *restrict nonce, const uint8_t *restrict aad, size_t aadSize, const uint8_t *restrict input, uint8_t *restrict output, size_t size, uint8_t *restrict tag) {
+    size_t offset;
+    size_t length;
+    size_t i;
+
+    struct chacha_poly1305 mac;
+    uint8_t keystream[(CHACHA_BATCH_BLOCKS+1)*CHACHA_BLOCK_CHARS];
+    uint8_t *stream;
+
+    // The first batch starts a block early, block 0 keys Poly1305
+    length = _chacha_batch(size, 0);
+    chacha_blocks(key, nonce, 0, 1 + (length + CHACHA_BLOCK_CHARS - 1)/CHACHA_BLOCK_CHARS, keystream);
+    _chacha_poly_init(&mac, keystream);
+    _chacha_poly_update(&mac, aad, aadSize);
+    stream = keystream+CHACHA_BLOCK_CHARS;
+
+    // Batches are whole blocks but the last, so Poly1305 pads only at the end
+    for (offset = 0; offset < size; offset += length) {
+        length = _chacha_batch(size, offset);
+        if (offset > 0) {
+            chacha_blocks(key, nonce, (uint32_t) (1 + offset/CHACHA_BLOCK_CHARS), (length + CHACHA_BLOCK_CHARS - 1)/CHACHA_BLOCK_CHARS, keystream);
+            stream = keystream;
+        }
+
+        for (i = 0; i < length; i++)
+            output[offset+i] = input[offset+i] ^ stream[i];
+        _chacha_poly_update(&mac, output+offset, length);
+    }
+
+    _chacha_poly_lengths(&mac, aadSize, size);
+    _chacha_poly_finish(&mac, tag);
+}
+
+int chacha_decrypt(const uint8_t *restrict key, const uint8_t *restrict nonce, const uint8_t *restrict aad, size_t aadSize, const uint8_t *restrict input, uint8_t *restrict output, size_t size, const uint8_t *restrict tag) {
+    size_t offset;
+    size_t length;
+    size_t i;
+
+    struct chacha_poly1305 mac;
+    uint8_t keystream[(CHACHA_BATCH_BLOCKS+1)*CHACHA_BLOCK_CHARS];
+    uint8_t expectedTag[CHACHA_TAG_CHARS];
+    uint8_t difference = 0;
+    uint8_t *stream;
+
+    // The first batch of keystream is kept for after the tag matched
+    length = _chacha_batch(size, 0);
+    chacha_blocks(key, nonce, 0, 1 + (length + CHACHA_BLOCK_CHARS - 1)/CHACHA_BLOCK_CHARS, keystream);
+    _chacha_poly_init(&mac, keystream);
+    _chacha_poly_update(&mac, aad, aadSize);
+    _chacha_poly_update(&mac, input, size);
+    _chacha_poly_lengths(&mac, aadSize, size);
+    _chacha_poly_finish(&mac, expectedTag);
+
+    for (i = 0; i < CHACHA_TAG_CHARS; i++)
+        difference |= expectedTag[i] ^ tag[i];
+    if (difference != 0)
+        return -1;
+
+    stream = keystream+CHACHA_BLOCK_CHARS;
+    for (offset = 0; offset < size; offset += length) {
+        length = _chacha_batch(size, offset);
+        if (offset > 0) {
+            chacha_blocks(key, nonce, (uint32_t) (1 + offset/CHACHA_BLOCK_CHARS), (length + CHACHA_BLOCK_CHARS - 1)/CHACHA_BLOCK_CHARS, keystream);
+            stream = keystream;
+        }
+
+        for (i = 0; i < length; i++)
+            output[offset+i] = input[offset+i] ^ stream[i];
+    }
+
+    return 0;
+}
+
+const char *chacha_backend() {
+    return chacha_name;
+}
@@ -0,0 +1,26 @@
+#ifndef __ENC_CHACHA_H__
+#define __ENC_CHACHA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ChaCha20-Poly1305 (RFC 8439) with 96 bit nonces
+#define CHACHA_KEY_CHARS   32
+#define CHACHA_NONCE_CHARS 12
+#define CHACHA_BLOCK_CHARS 64
+#define CHACHA_TAG_CHARS   16
+
+// Keystream of blocks blocks from the block counter firstBlock on, picking the backend on the first call
+void chacha_blocks(const uint8_t *restrict key, const uint8_t *restrict nonce, uint32_t firstBlock, size_t blocks, uint8_t *restrict keystream);
+
+// Encrypts size bytes from block 1 on and tags them together with aadSize bytes of aad,
+// block 0 keying Poly1305
+void chacha_encrypt(const uint8_t *restrict key, const uint8_t *restrict nonce, const uint8_t *restrict aad, size_t aadSize, const uint8_t *restrict input, uint8_t *restrict output, size_t size, uint8_t *restrict tag);
+
+// Checks the tag in constant time and only then decrypts, returns 0 if it matches.
+// On a mismatch output is left untouched.
+int chacha_decrypt(const uint8_t *restrict key, const uint8_t *restrict nonce, const uint8_t *restrict aad, size_t aadSize, const uint8_t *restrict input, uint8_t *restrict output, size_t size, const uint8_t *restrict tag);
+
+const char *chacha_backend();
+
+#endif
@@ -1,38 +1,58 @@
 #define QLENGTH 10 /*windowlength for the quantisation*/
-#define FLENGTH 20
-#define FLENGTH_2 10
+/*Longest QMF prototype, the filters of a stream are chosen at setup from qmf_tables.h, see filterbank.h*/
+#define MAX_FLENGTH 64
 
-/*Scaled filtercoefficients (with 2^15)*/
-#define ANALYSISFILTER_EVEN {-20, 60, 0, -599, 3554, 15618, -3137, 1229, -398, 82}
-#define ANALYSISFILTER_ODD {82, -398, 1229, -3137, 15618, 3554, -599, 0, 60, -20}
-#define SYNTHESISFILTER_EVEN {-20<<1, 60<<1, 0<<1, -599<<1, 3554<<1, 15618<<1, -3137<<1, 1229<<1, -398<<1, 82<<1}
-#define SYNTHESISFILTER_ODD {82<<1, -398<<1, 1229<<1, -3137<<1, 15618<<1, 3554<<1, -599<<1, 0<<1, 60<<1, -20<<1}
+/*Levels of the subband tree, each splitting every band of the one above in two: a stream
+  codes 2^depth subbands, its depth is set by the bit allocation profile*/
+#define MAX_DEPTH 4
+#define MAX_SUBBANDS (1 << MAX_DEPTH)
 
-/*Scaled step sizes for quantisation for nbits = [5,3,2,2]*/
+/*A channel frame of subband values is laid out in GROUPS(depth) blocks of frameSize / GROUPS
+  entries, 4 lanes per step, which the quantiser codes as separate 4-lane states: subband b is
+  lane b & 3 of block b >> 2. Two subbands take two lanes each, of alternate positions.*/
+#define MAX_GROUPS (MAX_SUBBANDS / 4)
+#define GROUPS(depth) ((depth) > 2 ? 1 << ((depth) - 2) : 1)
+#define SUBBAND_INDEX(depth, frameSize, b, t) (((b) >> 2) * ((frameSize) / GROUPS(depth)) + ((t) << ((depth) < 2 ? (depth) : 2)) + ((b) & 3))
+
+/*Capacity of the filter histories of one tree level, shared by its nodes: each of the 2^level
+  nodes has LEVEL_HISTORY >> level entries, FLENGTH/2 - 1 past entries plus its share of the
+  largest frame*/
+#define LEVEL_HISTORY ((MAX_SUBBANDS/2) * (MAX_FLENGTH/2 - 1) + MAX_FRAMESIZE/2)
+
+/*Scaled step sizes for quantisation; bit allocation, PHI and the step size limits per subband are in profile.c*/
 #define QSTART 33
 #define QMIN 2
+#define QMAX 8192 /*largest step size limit of any profile*/
 
 #define MU_1 19595
 #define MU_2 6291
 #define MU_3 -27525
 #define MU_4 -131
 
-#define PHI_1 2212
-#define PHI_2 4342
-#define PHI_3 10650
-#define PHI_4 13107
-
-#define QMAX_1 1024
-#define QMAX_2 4096
-#define QMAX_3 8192
-#define QMAX_4 8192
-
-#define MAX_LEVEL_1 15
-#define MAX_LEVEL_2 3
-#define MAX_LEVEL_3 1
-#define MAX_LEVEL_4 1
-
-#define MIN_LEVEL_1 -16
-#define MIN_LEVEL_2 -4
-#define MIN_LEVEL_3 -2
-#define MIN_LEVEL_4 -2
+/*Temporal samples over which packet loss concealment fades out*/
+#define PLC_FADE 480
+
+/*Codec options, the same for all channels of a stream*/
+#define CODEC_ENTROPY 0x1 /*entropy code the quantised levels, see entropy.h*/
+#define CODEC_DTX 0x2 /*discontinuous transmission during silence, see dtx.h*/
+#define CODEC_SYNC 0x4 /*periodic sync frames for random access, see decode_seek()*/
+#define CODEC_LIFTING 0x8 /*integer lifting filter bank instead of the QMFs, see filterbank.h*/
+#define CODEC_JOINT 0x10 /*joint stereo of channel pairs, see stereo.h*/
+
+/*Temporal samples between sync frames, rounded down to whole frames; at least MAX_FRAMESIZE*/
+#define SYNC_PERIOD 8000
+/*Temporal samples after a sync frame until a decoder started there matches one that
+  ran before: the synthesis histories of all levels, 56 for 20 taps and two levels*/
+#define SYNC_PREROLL(flength, depth) ((((flength)/2 - 1) * ((2 << (depth)) - 2) + (1 << (depth)) - 1) & -(1 << (depth)))
+/*Quantiser snapshot in front of every speech section of a sync frame*/
+#define SYNC_WORDS 8
+/*Temporal samples a segment encoder runs ahead of its sync frame: the analysis filters and the DTX hangover*/
+#define SYNC_WARMUP 1744
+#define SYNC_FRAME(flags, frameSize, frame) (((flags) & CODEC_SYNC) && (frame) % (SYNC_PERIOD / (frameSize)) == 0)
+
+/*Version of the encoder and decoder state of encode_serialize() and decode_serialize()*/
+#define CODEC_STATE_VERSION 1
+/*An int of serialised state as two words, the high one first*/
+#define STATE_HIGH(value) ((short) ((unsigned int) (value) >> 16))
+#define STATE_LOW(value) ((short) (value))
+#define STATE_INT(high, low) ((int) (((unsigned int) (unsigned short) (high) << 16) | (unsigned short) (low)))
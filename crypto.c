@@ -22,6 +22,9 @@ const uint8_t sha256_prefix[19] =
 const size_t sha256_prefix_size = sizeof(sha256_prefix);
 
 static void _hash(uint8_t *hash, uint8_t *data, size_t hashLength, size_t dataLength);
+static void _ctrBlocks(const struct enc_cipher_ctx *restrict cipher, uint8_t *restrict keystream, uint32_t packetCounter, uint32_t firstBlock, size_t blocks);
+static void _packetNonce(const struct enc_cipher_ctx *restrict cipher, uint8_t *restrict packetNonce, uint32_t packetCounter);
+static void _ctrXor(unsigned char *restrict output, const struct enc_cipher_ctx *restrict cipher, uint32_t packetCounter, unsigned char *restrict input, size_t dataSize);
 #ifdef __ENC_USE_SHA1__
     static void _hash_sha1(uint8_t *hash, uint8_t *data, size_t hashLength, size_t dataLength);
 #endif
@@ -139,12 +142,12 @@ void _calculateSymmetricKey(digit_t *restrict key, digit_t *restrict modExpResul
     mpModExp(key, modExpResult, secret, prime, ENC_PRIVATE_KEY_DIGITS);
 }
 
-void _deriveKeys(uint8_t *restrict aesKey, uint8_t *restrict hashKey, uint8_t *restrict CTRNonce, digit_t *restrict symmetricKey) {
+void _deriveKeys(uint8_t *restrict aesKey, uint8_t *restrict hashKey, uint8_t *restrict CTRNonce, uint8_t *restrict chachaKey, struct enc_cipher_ctx *restrict cipher, digit_t *restrict symmetricKey, uint8_t offeredSuites, uint8_t suite) {
     #ifndef __ENC_NO_PRINTS__
         size_t i;
     #endif
 
-    uint8_t hashMessage[ENC_PRIVATE_KEY_CHARS+1];
+    uint8_t hashMessage[ENC_PRIVATE_KEY_CHARS+3];
     uint8_t hashResult[ENC_HASH_DIGEST_CHARS];
 
     mpConvToOctets(symmetricKey, ENC_PRIVATE_KEY_DIGITS, hashMessage, ENC_PRIVATE_KEY_CHARS);
@@ -153,8 +156,11 @@ void _deriveKeys(uint8_t *restrict aesKey, uint8_t *restrict hashKey, uint8_t *r
         printf("---> _deriveKeys \n");
     #endif
 
+    // The later keys chain from this hash, so they depend on the suites as well
     hashMessage[ENC_PRIVATE_KEY_CHARS] = 1;
-    _hash(hashResult, hashMessage, ENC_HASH_DIGEST_CHARS, ENC_PRIVATE_KEY_CHARS+1);
+    hashMessage[ENC_PRIVATE_KEY_CHARS+1] = offeredSuites;
+    hashMessage[ENC_PRIVATE_KEY_CHARS+2] = suite;
+    _hash(hashResult, hashMessage, ENC_HASH_DIGEST_CHARS, ENC_PRIVATE_KEY_CHARS+3);
     memcpy(aesKey, hashResult, ENC_AES_KEY_CHARS);
 
     memset(hashMessage, 0, (ENC_PRIVATE_KEY_CHARS+1));
@@ -169,6 +175,19 @@ void _deriveKeys(uint8_t *restrict aesKey, uint8_t *restrict hashKey, uint8_t *r
     _hash(hashResult, hashMessage, ENC_HASH_DIGEST_CHARS, ENC_PRIVATE_KEY_CHARS+1);
     memcpy(CTRNonce, hashResult, ENC_CTR_NONCE_CHARS);
 
+    // ChaCha20 takes 256 bit keys: straight from the shared secret under its own
+    // label, and always SHA-256 so it fills the key whichever hash is configured
+    memset(chachaKey, 0, ENC_CHACHA_KEY_CHARS);
+    if (suite == ENC_SUITE_CHACHA_POLY) {
+        mpConvToOctets(symmetricKey, ENC_PRIVATE_KEY_DIGITS, hashMessage, ENC_PRIVATE_KEY_CHARS);
+        hashMessage[ENC_PRIVATE_KEY_CHARS] = 4;
+        hashMessage[ENC_PRIVATE_KEY_CHARS+1] = offeredSuites;
+        hashMessage[ENC_PRIVATE_KEY_CHARS+2] = suite;
+        _hash_sha2(chachaKey, hashMessage, ENC_CHACHA_KEY_CHARS, ENC_PRIVATE_KEY_CHARS+3);
+    }
+
+    _initCipher(cipher, aesKey, CTRNonce, chachaKey);
+
     #ifndef __ENC_NO_PRINTS__
         printf("---| aesKey\n");
         for (i = 0; i < ENC_AES_KEY_CHARS; i++)
@@ -184,6 +203,13 @@ void _deriveKeys(uint8_t *restrict aesKey, uint8_t *restrict hashKey, uint8_t *r
         for (i = 0; i < ENC_CTR_NONCE_CHARS; i++)
             printf("%x", CTRNonce[i]);
         printf("\n");
+
+        if (suite == ENC_SUITE_CHACHA_POLY) {
+            printf("---| chachaKey\n");
+            for (i = 0; i < ENC_CHACHA_KEY_CHARS; i++)
+                printf("%x", chachaKey[i]);
+            printf("\n");
+        }
     #endif
 }
 
@@ -343,49 +369,96 @@ void _pkcs_prepareHash(uint8_t *restrict preparedHash, const uint8_t *restrict p
 }
 
 // Encryption
-void _encryptData(unsigned char *restrict encryptedData, uint8_t *restrict aesKey, uint8_t *restrict nonce, uint32_t packetCounter, unsigned char *restrict dataToEncrypt, size_t dataSize) {
-    aes_key key;
+void _initCipher(struct enc_cipher_ctx *restrict cipher, uint8_t *restrict aesKey, uint8_t *restrict nonce, uint8_t *restrict chachaKey) {
+    ctr_setKey(&cipher->key, aesKey, ENC_AES_KEY_BITS);
+    memcpy(cipher->nonce, nonce, ENC_CTR_NONCE_CHARS);
+    gcm_hashKey(&cipher->key, cipher->ghashKey);
+    memcpy(cipher->chachaKey, chachaKey, ENC_CHACHA_KEY_CHARS);
+}
 
-    size_t blockCounter;
-    size_t i;
+static void _ctrBlocks(const struct enc_cipher_ctx *restrict cipher, uint8_t *restrict keystream, uint32_t packetCounter, uint32_t firstBlock, size_t blocks) {
+    unsigned char counterBlock[aes_BLOCK_SIZE];
+
+    memcpy(counterBlock, cipher->nonce, ENC_CTR_NONCE_CHARS);
+    counterBlock[ENC_CTR_PACKET_OFFSET] = (unsigned char) packetCounter;
+    counterBlock[ENC_CTR_PACKET_OFFSET+1] = (unsigned char) (packetCounter >> 8);
+    counterBlock[ENC_CTR_PACKET_OFFSET+2] = (unsigned char) (packetCounter >> 16);
+    counterBlock[ENC_CTR_PACKET_OFFSET+3] = (unsigned char) (packetCounter >> 24);
+
+    // The backend fills in the block counter
+    ctr_blocks(&cipher->key, counterBlock, firstBlock, CTR_LITTLE_ENDIAN, blocks, keystream);
+}
+
+void _ctrKeystream(const struct enc_cipher_ctx *restrict cipher, uint8_t *restrict keystream, uint32_t packetCounter, size_t packets, size_t blocks) {
+    size_t packet;
+
+    for (packet = 0; packet < packets; packet++)
+        _ctrBlocks(cipher, keystream+packet*blocks*aes_BLOCK_SIZE, packetCounter+(uint32_t) packet, 0, blocks);
+}
 
-    unsigned char encryptedBlock[aes_BLOCK_SIZE];
-    unsigned char blockToEncrypt[aes_BLOCK_SIZE];
+static void _ctrXor(unsigned char *restrict output, const struct enc_cipher_ctx *restrict cipher, uint32_t packetCounter, unsigned char *restrict input, size_t dataSize) {
+    size_t blocks;
+    size_t offset;
+    size_t length;
+    size_t i;
 
-    for (blockCounter = 0; blockCounter < dataSize/aes_BLOCK_SIZE; blockCounter++) {
-        memcpy(blockToEncrypt, nonce, ENC_CTR_NONCE_CHARS);
-        memcpy(blockToEncrypt+ENC_CTR_NONCE_CHARS, &packetCounter, sizeof(uint32_t));
-        memcpy(blockToEncrypt+ENC_CTR_NONCE_CHARS+sizeof(uint32_t), &blockCounter, sizeof(size_t));
+    uint8_t keystream[ENC_CTR_BATCH_BLOCKS*aes_BLOCK_SIZE];
 
-        aes_set_encrypt_key(&key, aesKey, ENC_AES_KEY_BITS);
+    // A batch of keystream at a time, the last block may be partial
+    for (offset = 0; offset < dataSize; offset += length) {
+        length = dataSize - offset;
+        if (length > sizeof(keystream))
+            length = sizeof(keystream);
+        blocks = (length + aes_BLOCK_SIZE - 1)/aes_BLOCK_SIZE;
 
-        aes_encrypt(&key, blockToEncrypt, encryptedBlock);
+        _ctrBlocks(cipher, keystream, packetCounter, (uint32_t) (offset/aes_BLOCK_SIZE), blocks);
 
-        for (i = 0; i < aes_BLOCK_SIZE; i++)
-            encryptedData[i+blockCounter*aes_BLOCK_SIZE] = encryptedBlock[i] ^ dataToEncrypt[i+blockCounter*aes_BLOCK_SIZE];
+        for (i = 0; i < length; i++)
+            output[offset+i] = keystream[i] ^ input[offset+i];
     }
 }
 
-void _decryptData(unsigned char *restrict decryptedData, uint8_t *restrict aesKey, uint8_t *restrict nonce, uint32_t packetCounter, unsigned char *restrict dataToDecrypt, size_t dataSize) {
-    aes_key key;
+void _encryptData(unsigned char *restrict encryptedData, const struct enc_cipher_ctx *restrict cipher, uint32_t packetCounter, unsigned char *restrict dataToEncrypt, size_t dataSize) {
+    _ctrXor(encryptedData, cipher, packetCounter, dataToEncrypt, dataSize);
+}
+
+void _decryptData(unsigned char *restrict decryptedData, const struct enc_cipher_ctx *restrict cipher, uint32_t packetCounter, unsigned char *restrict dataToDecrypt, size_t dataSize) {
+    _ctrXor(decryptedData, cipher, packetCounter, dataToDecrypt, dataSize);
+}
 
-    size_t blockCounter;
-    size_t i;
+static void _packetNonce(const struct enc_cipher_ctx *restrict cipher, uint8_t *restrict packetNonce, uint32_t packetCounter) {
+    memcpy(packetNonce, cipher->nonce, ENC_CTR_NONCE_CHARS);
+    packetNonce[ENC_CTR_PACKET_OFFSET] = (uint8_t) packetCounter;
+    packetNonce[ENC_CTR_PACKET_OFFSET+1] = (uint8_t) (packetCounter >> 8);
+    packetNonce[ENC_CTR_PACKET_OFFSET+2] = (uint8_t) (packetCounter >> 16);
+    packetNonce[ENC_CTR_PACKET_OFFSET+3] = (uint8_t) (packetCounter >> 24);
+}
 
-    unsigned char encryptedBlock[aes_BLOCK_SIZE];
-    unsigned char blockToEncrypt[aes_BLOCK_SIZE];
+void _sealData(unsigned char *restrict encryptedData, uint8_t *restrict tag, const struct enc_cipher_ctx *restrict cipher, uint8_t suite, uint32_t packetCounter, const uint8_t *restrict header, size_t headerSize, unsigned char *restrict dataToEncrypt, size_t dataSize) {
+    uint8_t packetNonce[GCM_IV_CHARS];
 
-    for (blockCounter = 0; blockCounter < dataSize/aes_BLOCK_SIZE; blockCounter++) {
-        memcpy(blockToEncrypt, nonce, ENC_CTR_NONCE_CHARS);
-        memcpy(blockToEncrypt+ENC_CTR_NONCE_CHARS, &packetCounter, sizeof(uint32_t));
-        memcpy(blockToEncrypt+ENC_CTR_NONCE_CHARS+sizeof(uint32_t), &blockCounter, sizeof(size_t));
+    _packetNonce(cipher, packetNonce, packetCounter);
+    if (suite == ENC_SUITE_CHACHA_POLY)
+        chacha_encrypt(cipher->chachaKey, packetNonce, header, headerSize, dataToEncrypt, encryptedData, dataSize, tag);
+    else
+        gcm_encrypt(&cipher->key, cipher->ghashKey, packetNonce, header, headerSize, dataToEncrypt, encryptedData, dataSize, tag);
+}
 
-        aes_set_encrypt_key(&key, aesKey, ENC_AES_KEY_BITS);
-        aes_encrypt(&key, blockToEncrypt, encryptedBlock);
+int _openData(unsigned char *restrict decryptedData, const struct enc_cipher_ctx *restrict cipher, uint8_t suite, uint32_t packetCounter, const uint8_t *restrict header, size_t headerSize, unsigned char *restrict dataToDecrypt, size_t dataSize, const uint8_t *restrict tag) {
+    int returnStatus;
 
-        for (i = 0; i < aes_BLOCK_SIZE; i++)
-            decryptedData[i+blockCounter*aes_BLOCK_SIZE] = encryptedBlock[i] ^ dataToDecrypt[i+blockCounter*aes_BLOCK_SIZE];
-    }
+    uint8_t packetNonce[GCM_IV_CHARS];
+
+    _packetNonce(cipher, packetNonce, packetCounter);
+    if (suite == ENC_SUITE_CHACHA_POLY)
+        returnStatus = chacha_decrypt(cipher->chachaKey, packetNonce, header, headerSize, dataToDecrypt, decryptedData, dataSize, tag);
+    else
+        returnStatus = gcm_decrypt(&cipher->key, cipher->ghashKey, packetNonce, header, headerSize, dataToDecrypt, decryptedData, dataSize, tag);
+
+    if (returnStatus != 0)
+        return ENC_TAG_REJECTED;
+
+    return ENC_ACCEPT_PACKET;
 }
 
 void _convFromOctets() {
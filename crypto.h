@@ -9,6 +9,9 @@
 #include "aes.h"
 #include "bigdigits.h"
 #include "crt.h"
+#include "chacha.h"
+#include "ctr.h"
+#include "gcm.h"
 #include "protocol.h"
 #include "types.h"
 #include "sha1.h"
@@ -70,6 +73,30 @@
 #define ENC_CTR_NONCE_CHARS            8
 #define ENC_CTR_NONCE_DIGITS           2
 
+// Counter block: nonce | packet counter | block counter, both counters 32 bit little endian
+#define ENC_CTR_PACKET_OFFSET          ENC_CTR_NONCE_CHARS
+#define ENC_CTR_BATCH_BLOCKS           16
+
+// ChaCha20-Poly1305
+#define ENC_CHACHA_KEY_CHARS           CHACHA_KEY_CHARS
+
+// Cipher Suites, one bit each so an offer is their union
+#define ENC_SUITE_CTR_HMAC             0x01
+#define ENC_SUITE_AES_GCM              0x02
+#define ENC_SUITE_CHACHA_POLY          0x04
+#define ENC_SUITES                     (ENC_SUITE_CTR_HMAC | ENC_SUITE_AES_GCM | ENC_SUITE_CHACHA_POLY)
+
+// Tags of the AEAD suites
+#define ENC_AEAD_TAG_CHARS             16
+
+// Session cipher, the AES key schedule expanded once per session key
+struct enc_cipher_ctx {
+    struct ctr_key key;
+    uint8_t nonce[ENC_CTR_NONCE_CHARS];
+    uint8_t ghashKey[GCM_BLOCK_CHARS];
+    uint8_t chachaKey[ENC_CHACHA_KEY_CHARS];
+};
+
 // Diffie-Hellman
 extern digit_t Enc_GeneratorDigits[ENC_PRIVATE_KEY_DIGITS];
 extern digit_t Enc_PrimeDigits[ENC_PRIVATE_KEY_DIGITS];
@@ -85,7 +112,9 @@ extern digit_t Enc_PublicExpDigits[ENC_PRIVATE_KEY_DIGITS];
 
 // Keys
 void _calculateSymmetricKey(digit_t *restrict key, digit_t *restrict modExpResult, digit_t *restrict secret);
-void _deriveKeys(uint8_t *restrict aesKey, uint8_t *restrict hashKey, uint8_t *restrict CTRKey, digit_t *restrict symmetricKey);
+// The offered and chosen suites go into the keys, so a changed offer fails the signatures.
+// The ChaCha20 key is only derived for that suite and left zero otherwise.
+void _deriveKeys(uint8_t *restrict aesKey, uint8_t *restrict hashKey, uint8_t *restrict CTRKey, uint8_t *restrict chachaKey, struct enc_cipher_ctx *restrict cipher, digit_t *restrict symmetricKey, uint8_t offeredSuites, uint8_t suite);
 
 // Hashes
 void _hmac(uint8_t *restrict hmac, uint8_t *restrict data, uint8_t *restrict key);
@@ -95,8 +124,17 @@ void _sign(digit_t *restrict signature, uint8_t *restrict message, digit_t *rest
 void _sign_crt(digit_t *restrict signature, digit_t *restrict message, digit_t *restrict privateExponent, digit_t *restrict p, digit_t *restrict q);
 int _verify(digit_t *restrict signature, uint8_t *restrict message, digit_t *restrict publicExponent, digit_t *restrict modulus);
 
-void _encryptData(unsigned char *restrict encryptedData, uint8_t *restrict aesKey, uint8_t *restrict nonce, uint32_t packetCounter, unsigned char *restrict dataToEncrypt, size_t dataSize);
-void _decryptData(unsigned char *restrict decryptedData, uint8_t *restrict aesKey, uint8_t *restrict nonce, uint32_t packetCounter, unsigned char *restrict dataToDecrypt, size_t dataSize);
+// Encryption
+void _initCipher(struct enc_cipher_ctx *restrict cipher, uint8_t *restrict aesKey, uint8_t *restrict nonce, uint8_t *restrict chachaKey);
+// Keystream of packets packets from packetCounter on, blocks blocks each, packet after packet
+void _ctrKeystream(const struct enc_cipher_ctx *restrict cipher, uint8_t *restrict keystream, uint32_t packetCounter, size_t packets, size_t blocks);
+void _encryptData(unsigned char *restrict encryptedData, const struct enc_cipher_ctx *restrict cipher, uint32_t packetCounter, unsigned char *restrict dataToEncrypt, size_t dataSize);
+void _decryptData(unsigned char *restrict decryptedData, const struct enc_cipher_ctx *restrict cipher, uint32_t packetCounter, unsigned char *restrict dataToDecrypt, size_t dataSize);
+
+// AES-GCM or ChaCha20-Poly1305, the nonce being the CTR nonce and the packet counter as the counter block of CTR starts
+void _sealData(unsigned char *restrict encryptedData, uint8_t *restrict tag, const struct enc_cipher_ctx *restrict cipher, uint8_t suite, uint32_t packetCounter, const uint8_t *restrict header, size_t headerSize, unsigned char *restrict dataToEncrypt, size_t dataSize);
+// Returns ENC_TAG_REJECTED, leaving decryptedData untouched, unless the tag matches
+int _openData(unsigned char *restrict decryptedData, const struct enc_cipher_ctx *restrict cipher, uint8_t suite, uint32_t packetCounter, const uint8_t *restrict header, size_t headerSize, unsigned char *restrict dataToDecrypt, size_t dataSize, const uint8_t *restrict tag);
 
 void _convFromOctets();
 
@@ -0,0 +1,569 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "bigdigits.h"
+#include "ctr.h"
+#include "types.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define __ENC_CTR_X86__
+    #include <immintrin.h>
+#endif
+
+// Bit planes of the bitsliced backend, two lanes of 4 blocks in a vector register
+// (SSE2, NEON) where the compiler has vector extensions
+#if defined(__GNUC__)
+    typedef uint64_t ctr_slice_t __attribute__((vector_size(16)));
+    #define CTR_SLICE_LANES 2
+#else
+    typedef uint64_t ctr_slice_t;
+    #define CTR_SLICE_LANES 1
+#endif
+
+#define CTR_SLICED_BLOCKS (4*CTR_SLICE_LANES)
+
+// Rotations of a plane by whole rows, row r+1 moving to row r first
+#define ROTATE_ROWS(x, rows) (((x) >> (16*(rows))) | ((x) << (64-16*(rows))))
+
+typedef void (*ctr_blocks_t)(const struct ctr_key *restrict key, const uint8_t *restrict counterBlock, uint32_t firstBlock, int order, size_t blocks, uint8_t *restrict keystream);
+
+static ctr_blocks_t blocksKernel = NULL;
+static const char *ctr_name = "bitsliced";
+
+static void _ctr_store_counter(uint8_t *bytes, uint32_t blockCounter, int order) {
+    int i;
+
+    for (i = 0; i < 4; i++)
+        bytes[order == CTR_BIG_ENDIAN ? 3-i : i] = (uint8_t) (blockCounter >> (8*i));
+}
+
+#ifdef __ENC_CTR_TABLES__
+    // One block per aes_encrypt call. Faster than the bitsliced backend on some
+    // cores, but its table lookups depend on the key and data
+    static void _ctr_blocks_tables(const struct ctr_key *restrict key, const uint8_t *restrict counterBlock, uint32_t firstBlock, int order, size_t blocks, uint8_t *restrict keystream) {
+        size_t i;
+        uint32_t blockCounter;
+
+        unsigned char block[aes_BLOCK_SIZE];
+
+        memcpy(block, counterBlock, aes_BLOCK_SIZE);
+
+        for (i = 0; i < blocks; i++) {
+            blockCounter = firstBlock + (uint32_t) i;
+            _ctr_store_counter(block+CTR_COUNTER_OFFSET, blockCounter, order);
+
+            aes_encrypt(&key->tables, block, keystream+i*aes_BLOCK_SIZE);
+        }
+    }
+#endif
+
+// Bitsliced AES, constant time: no memory access or branch depends on the key or
+// the data. In each 64-bit lane byte (row r, column c) of block b sits at bit
+// 16r+4c+b of the planes, so a row is a 16 bit field, ShiftRows rotates within
+// the fields and MixColumns rotates whole rows.
+
+// The 4 bytes of x in the even bytes of a word and back
+static uint64_t _ctr_spread(uint32_t x) {
+    uint64_t y = x;
+
+    y = (y | (y << 16)) & 0x0000FFFF0000FFFFull;
+    y = (y | (y << 8)) & 0x00FF00FF00FF00FFull;
+
+    return y;
+}
+
+static uint32_t _ctr_gather(uint64_t y) {
+    y &= 0x00FF00FF00FF00FFull;
+    y = (y | (y >> 8)) & 0x0000FFFF0000FFFFull;
+    y = (y | (y >> 16)) & 0x00000000FFFFFFFFull;
+
+    return (uint32_t) y;
+}
+
+static uint32_t _ctr_load32(const uint8_t *bytes) {
+    return (uint32_t) bytes[0] | ((uint32_t) bytes[1] << 8) | ((uint32_t) bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+static void _ctr_store32(uint8_t *bytes, uint32_t x) {
+    bytes[0] = (uint8_t) x;
+    bytes[1] = (uint8_t) (x >> 8);
+    bytes[2] = (uint8_t) (x >> 16);
+    bytes[3] = (uint8_t) (x >> 24);
+}
+
+#define SWAP_BITS(a, b, mask, shift) { t = (((a) >> (shift)) ^ (b)) & (mask); (b) ^= t; (a) ^= t << (shift); }
+
+// Bit 8m+i of word j to bit 8m+j of word i, its own inverse
+static void _ctr_ortho(uint64_t *w) {
+    uint64_t t;
+
+    SWAP_BITS(w[0], w[1], 0x5555555555555555ull, 1);
+    SWAP_BITS(w[2], w[3], 0x5555555555555555ull, 1);
+    SWAP_BITS(w[4], w[5], 0x5555555555555555ull, 1);
+    SWAP_BITS(w[6], w[7], 0x5555555555555555ull, 1);
+
+    SWAP_BITS(w[0], w[2], 0x3333333333333333ull, 2);
+    SWAP_BITS(w[1], w[3], 0x3333333333333333ull, 2);
+    SWAP_BITS(w[4], w[6], 0x3333333333333333ull, 2);
+    SWAP_BITS(w[5], w[7], 0x3333333333333333ull, 2);
+
+    SWAP_BITS(w[0], w[4], 0x0F0F0F0F0F0F0F0Full, 4);
+    SWAP_BITS(w[1], w[5], 0x0F0F0F0F0F0F0F0Full, 4);
+    SWAP_BITS(w[2], w[6], 0x0F0F0F0F0F0F0F0Full, 4);
+    SWAP_BITS(w[3], w[7], 0x0F0F0F0F0F0F0F0Full, 4);
+}
+
+// 4 consecutive blocks into the planes. Byte m of word j, before _ctr_ortho, ends
+// at bit 8m+j, so word 4p+b holds columns p and p+2 of block b, bytes interleaved.
+static void _ctr_pack(uint64_t *restrict planes, const uint8_t *restrict blocks) {
+    int j;
+    const uint8_t *block;
+
+    for (j = 0; j < CTR_SLICE_PLANES; j++) {
+        block = blocks+(j & 3)*aes_BLOCK_SIZE+(j >> 2)*4;
+        planes[j] = _ctr_spread(_ctr_load32(block)) | (_ctr_spread(_ctr_load32(block+8)) << 8);
+    }
+
+    _ctr_ortho(planes);
+}
+
+static void _ctr_unpack(uint8_t *restrict blocks, uint64_t *restrict planes) {
+    int j;
+    uint8_t *block;
+
+    _ctr_ortho(planes);
+
+    for (j = 0; j < CTR_SLICE_PLANES; j++) {
+        block = blocks+(j & 3)*aes_BLOCK_SIZE+(j >> 2)*4;
+        _ctr_store32(block, _ctr_gather(planes[j]));
+        _ctr_store32(block+8, _ctr_gather(planes[j] >> 8));
+    }
+}
+
+// The S-box circuit of Boyar and Peralta, 113 gates, q[i] holding bit i
+static inline void _ctr_sub_bytes(ctr_slice_t *q) {
+    ctr_slice_t x0, x1, x2, x3, x4, x5, x6, x7;
+    ctr_slice_t y1, y2, y3, y4, y5, y6, y7, y8, y9;
+    ctr_slice_t y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+    ctr_slice_t y20, y21;
+    ctr_slice_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+    ctr_slice_t z10, z11, z12, z13, z14, z15, z16, z17;
+    ctr_slice_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+    ctr_slice_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+    ctr_slice_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+    ctr_slice_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+    ctr_slice_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+    ctr_slice_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+    ctr_slice_t t60, t61, t62, t63, t64, t65, t66, t67;
+    ctr_slice_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+    x0 = q[7];
+    x1 = q[6];
+    x2 = q[5];
+    x3 = q[4];
+    x4 = q[3];
+    x5 = q[2];
+    x6 = q[1];
+    x7 = q[0];
+
+    // Top linear transformation
+    y14 = x3 ^ x5;
+    y13 = x0 ^ x6;
+    y9 = x0 ^ x3;
+    y8 = x0 ^ x5;
+    t0 = x1 ^ x2;
+    y1 = t0 ^ x7;
+    y4 = y1 ^ x3;
+    y12 = y13 ^ y14;
+    y2 = y1 ^ x0;
+    y5 = y1 ^ x6;
+    y3 = y5 ^ y8;
+    t1 = x4 ^ y12;
+    y15 = t1 ^ x5;
+    y20 = t1 ^ x1;
+    y6 = y15 ^ x7;
+    y10 = y15 ^ t0;
+    y11 = y20 ^ y9;
+    y7 = x7 ^ y11;
+    y17 = y10 ^ y11;
+    y19 = y10 ^ y8;
+    y16 = t0 ^ y11;
+    y21 = y13 ^ y16;
+    y18 = x0 ^ y16;
+
+    // Inversion in GF(2^8)
+    t2 = y12 & y15;
+    t3 = y3 & y6;
+    t4 = t3 ^ t2;
+    t5 = y4 & x7;
+    t6 = t5 ^ t2;
+    t7 = y13 & y16;
+    t8 = y5 & y1;
+    t9 = t8 ^ t7;
+    t10 = y2 & y7;
+    t11 = t10 ^ t7;
+    t12 = y9 & y11;
+    t13 = y14 & y17;
+    t14 = t13 ^ t12;
+    t15 = y8 & y10;
+    t16 = t15 ^ t12;
+    t17 = t4 ^ t14;
+    t18 = t6 ^ t16;
+    t19 = t9 ^ t14;
+    t20 = t11 ^ t16;
+    t21 = t17 ^ y20;
+    t22 = t18 ^ y19;
+    t23 = t19 ^ y21;
+    t24 = t20 ^ y18;
+
+    t25 = t21 ^ t22;
+    t26 = t21 & t23;
+    t27 = t24 ^ t26;
+    t28 = t25 & t27;
+    t29 = t28 ^ t22;
+    t30 = t23 ^ t24;
+    t31 = t22 ^ t26;
+    t32 = t31 & t30;
+    t33 = t32 ^ t24;
+    t34 = t23 ^ t33;
+    t35 = t27 ^ t33;
+    t36 = t24 & t35;
+    t37 = t36 ^ t34;
+    t38 = t27 ^ t36;
+    t39 = t29 & t38;
+    t40 = t25 ^ t39;
+
+    t41 = t40 ^ t37;
+    t42 = t29 ^ t33;
+    t43 = t29 ^ t40;
+    t44 = t33 ^ t37;
+    t45 = t42 ^ t41;
+    z0 = t44 & y15;
+    z1 = t37 & y6;
+    z2 = t33 & x7;
+    z3 = t43 & y16;
+    z4 = t40 & y1;
+    z5 = t29 & y7;
+    z6 = t42 & y11;
+    z7 = t45 & y17;
+    z8 = t41 & y10;
+    z9 = t44 & y12;
+    z10 = t37 & y3;
+    z11 = t33 & y4;
+    z12 = t43 & y13;
+    z13 = t40 & y5;
+    z14 = t29 & y2;
+    z15 = t42 & y9;
+    z16 = t45 & y14;
+    z17 = t41 & y8;
+
+    // Bottom linear transformation
+    t46 = z15 ^ z16;
+    t47 = z10 ^ z11;
+    t48 = z5 ^ z13;
+    t49 = z9 ^ z10;
+    t50 = z2 ^ z12;
+    t51 = z2 ^ z5;
+    t52 = z7 ^ z8;
+    t53 = z0 ^ z3;
+    t54 = z6 ^ z7;
+    t55 = z16 ^ z17;
+    t56 = z12 ^ t48;
+    t57 = t50 ^ t53;
+    t58 = z4 ^ t46;
+    t59 = z3 ^ t54;
+    t60 = t46 ^ t57;
+    t61 = z14 ^ t57;
+    t62 = t52 ^ t58;
+    t63 = t49 ^ t58;
+    t64 = z4 ^ t59;
+    t65 = t61 ^ t62;
+    t66 = z1 ^ t63;
+    s0 = t59 ^ t63;
+    s6 = t56 ^ ~t62;
+    s7 = t48 ^ ~t60;
+    t67 = t64 ^ t65;
+    s3 = t53 ^ t66;
+    s4 = t51 ^ t66;
+    s5 = t47 ^ t65;
+    s1 = t64 ^ ~s3;
+    s2 = t55 ^ ~t67;
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
+
+// Row r rotates left by r columns, 4 bits each
+static inline void _ctr_shift_rows(ctr_slice_t *q) {
+    int i;
+
+    for (i = 0; i < CTR_SLICE_PLANES; i++) {
+        q[i] = (q[i] & 0x000000000000FFFFull)
+            | ((q[i] & 0x00000000FFF00000ull) >> 4) | ((q[i] & 0x00000000000F0000ull) << 12)
+            | ((q[i] & 0x0000FF0000000000ull) >> 8) | ((q[i] & 0x000000FF00000000ull) << 8)
+            | ((q[i] & 0xF000000000000000ull) >> 12) | ((q[i] & 0x0FFF000000000000ull) << 4);
+    }
+}
+
+// 2 a[r] ^ 3 a[r+1] ^ a[r+2] ^ a[r+3] as 2 (a[r] ^ a[r+1]) ^ a[r+1] ^ a[r+2] ^ a[r+3]
+static inline void _ctr_mix_columns(ctr_slice_t *q) {
+    int i;
+
+    ctr_slice_t next[CTR_SLICE_PLANES];
+    ctr_slice_t sum[CTR_SLICE_PLANES];
+
+    for (i = 0; i < CTR_SLICE_PLANES; i++) {
+        next[i] = ROTATE_ROWS(q[i], 1);
+        sum[i] = q[i] ^ next[i];
+        q[i] = next[i] ^ ROTATE_ROWS(q[i], 2) ^ ROTATE_ROWS(q[i], 3);
+    }
+
+    // Doubling in GF(2^8) modulo x^8 + x^4 + x^3 + x + 1
+    q[0] ^= sum[7];
+    q[1] ^= sum[0] ^ sum[7];
+    q[2] ^= sum[1];
+    q[3] ^= sum[2] ^ sum[7];
+    q[4] ^= sum[3] ^ sum[7];
+    q[5] ^= sum[4];
+    q[6] ^= sum[5];
+    q[7] ^= sum[6];
+}
+
+static inline void _ctr_add_round_key(ctr_slice_t *q, const uint64_t *slicedKey) {
+    int i;
+
+    for (i = 0; i < CTR_SLICE_PLANES; i++)
+        q[i] ^= slicedKey[i];
+}
+
+static void _ctr_blocks_sliced(const struct ctr_key *restrict key, const uint8_t *restrict counterBlock, uint32_t firstBlock, int order, size_t blocks, uint8_t *restrict keystream) {
+    int r, b, l, i;
+    int rounds = key->tables.rounds;
+    size_t done;
+    size_t length;
+    uint32_t blockCounter;
+
+    uint8_t counterBlocks[CTR_SLICED_BLOCKS*aes_BLOCK_SIZE];
+    uint8_t output[CTR_SLICED_BLOCKS*aes_BLOCK_SIZE];
+    uint64_t planes[CTR_SLICE_LANES][CTR_SLICE_PLANES];
+    ctr_slice_t q[CTR_SLICE_PLANES];
+
+    for (b = 0; b < CTR_SLICED_BLOCKS; b++)
+        memcpy(counterBlocks+b*aes_BLOCK_SIZE, counterBlock, aes_BLOCK_SIZE);
+
+    for (done = 0; done < blocks; done += CTR_SLICED_BLOCKS) {
+        for (b = 0; b < CTR_SLICED_BLOCKS; b++) {
+            blockCounter = firstBlock + (uint32_t) (done + b);
+            _ctr_store_counter(counterBlocks+b*aes_BLOCK_SIZE+CTR_COUNTER_OFFSET, blockCounter, order);
+        }
+
+        // 4 blocks per lane
+        for (l = 0; l < CTR_SLICE_LANES; l++)
+            _ctr_pack(planes[l], counterBlocks+4*l*aes_BLOCK_SIZE);
+        for (i = 0; i < CTR_SLICE_PLANES; i++) {
+            for (l = 0; l < CTR_SLICE_LANES; l++)
+                memcpy((uint64_t *) &q[i] + l, &planes[l][i], sizeof(uint64_t));
+        }
+
+        _ctr_add_round_key(q, key->slicedKeys);
+        for (r = 1; r < rounds; r++) {
+            _ctr_sub_bytes(q);
+            _ctr_shift_rows(q);
+            _ctr_mix_columns(q);
+            _ctr_add_round_key(q, key->slicedKeys+r*CTR_SLICE_PLANES);
+        }
+        _ctr_sub_bytes(q);
+        _ctr_shift_rows(q);
+        _ctr_add_round_key(q, key->slicedKeys+rounds*CTR_SLICE_PLANES);
+
+        for (i = 0; i < CTR_SLICE_PLANES; i++) {
+            for (l = 0; l < CTR_SLICE_LANES; l++)
+                memcpy(&planes[l][i], (uint64_t *) &q[i] + l, sizeof(uint64_t));
+        }
+        for (l = 0; l < CTR_SLICE_LANES; l++)
+            _ctr_unpack(output+4*l*aes_BLOCK_SIZE, planes[l]);
+
+        // The last pass may fill only some of its blocks
+        length = blocks - done < CTR_SLICED_BLOCKS ? blocks - done : CTR_SLICED_BLOCKS;
+        memcpy(keystream+done*aes_BLOCK_SIZE, output, length*aes_BLOCK_SIZE);
+    }
+}
+
+// SubWord of the key schedule through the bitsliced S-box
+static uint32_t _ctr_sub_word(uint32_t word) {
+    int i, l;
+
+    uint8_t blocks[4*aes_BLOCK_SIZE];
+    uint64_t planes[CTR_SLICE_PLANES];
+    ctr_slice_t q[CTR_SLICE_PLANES];
+
+    memset(blocks, 0, sizeof(blocks));
+    _ctr_store32(blocks, word);
+
+    _ctr_pack(planes, blocks);
+    for (i = 0; i < CTR_SLICE_PLANES; i++) {
+        for (l = 0; l < CTR_SLICE_LANES; l++)
+            memcpy((uint64_t *) &q[i] + l, &planes[i], sizeof(uint64_t));
+    }
+
+    _ctr_sub_bytes(q);
+
+    for (i = 0; i < CTR_SLICE_PLANES; i++)
+        memcpy(&planes[i], &q[i], sizeof(uint64_t));
+    _ctr_unpack(blocks, planes);
+
+    return _ctr_load32(blocks);
+}
+
+#ifdef __ENC_CTR_X86__
+    // CTR_PIPELINE_BLOCKS independent blocks per round hide the latency of aesenc.
+    // The block counter is kept little endian in the top 32 bit lane, so
+    // _mm_add_epi32 steps it and wraps it as the tables backend does, and a
+    // shuffle turns it big endian where asked.
+    __attribute__((target("aes,ssse3")))
+    static void _ctr_blocks_aesni(const struct ctr_key *restrict key, const uint8_t *restrict counterBlock, uint32_t firstBlock, int order, size_t blocks, uint8_t *restrict keystream) {
+        int r, j;
+        int rounds = key->tables.rounds;
+        size_t i;
+
+        __m128i roundKey[aes_MAXNR+1];
+        __m128i block[CTR_PIPELINE_BLOCKS];
+        __m128i counter;
+        __m128i one = _mm_set_epi32(1, 0, 0, 0);
+        __m128i byteOrder = (order == CTR_BIG_ENDIAN) ? _mm_set_epi8(12, 13, 14, 15, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0) : _mm_set_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+        for (r = 0; r <= rounds; r++)
+            roundKey[r] = _mm_loadu_si128((const __m128i *) (key->roundKeys+r*aes_BLOCK_SIZE));
+
+        counter = _mm_loadu_si128((const __m128i *) counterBlock);
+        counter = _mm_or_si128(_mm_and_si128(counter, _mm_set_epi32(0, -1, -1, -1)), _mm_set_epi32((int) firstBlock, 0, 0, 0));
+
+        // Unrolled, so the blocks stay in registers at -O2 too
+        for (i = 0; i + CTR_PIPELINE_BLOCKS <= blocks; i += CTR_PIPELINE_BLOCKS) {
+            #pragma GCC unroll 8
+            for (j = 0; j < CTR_PIPELINE_BLOCKS; j++) {
+                block[j] = _mm_xor_si128(_mm_shuffle_epi8(counter, byteOrder), roundKey[0]);
+                counter = _mm_add_epi32(counter, one);
+            }
+
+            for (r = 1; r < rounds; r++) {
+                #pragma GCC unroll 8
+                for (j = 0; j < CTR_PIPELINE_BLOCKS; j++)
+                    block[j] = _mm_aesenc_si128(block[j], roundKey[r]);
+            }
+
+            #pragma GCC unroll 8
+            for (j = 0; j < CTR_PIPELINE_BLOCKS; j++)
+                _mm_storeu_si128((__m128i *) (keystream+(i+j)*aes_BLOCK_SIZE), _mm_aesenclast_si128(block[j], roundKey[rounds]));
+        }
+
+        for ( ; i < blocks; i++) {
+            block[0] = _mm_xor_si128(_mm_shuffle_epi8(counter, byteOrder), roundKey[0]);
+            counter = _mm_add_epi32(counter, one);
+
+            for (r = 1; r < rounds; r++)
+                block[0] = _mm_aesenc_si128(block[0], roundKey[r]);
+
+            _mm_storeu_si128((__m128i *) (keystream+i*aes_BLOCK_SIZE), _mm_aesenclast_si128(block[0], roundKey[rounds]));
+        }
+    }
+#endif
+
+// Picks the backend, once
+static void _ctr_setup() {
+    blocksKernel = _ctr_blocks_sliced;
+
+    #ifdef __ENC_CTR_TABLES__
+        blocksKernel = _ctr_blocks_tables;
+        ctr_name = "tables";
+    #endif
+
+    #ifdef __ENC_CTR_X86__
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("aes") && __builtin_cpu_supports("ssse3")) {
+            blocksKernel = _ctr_blocks_aesni;
+            ctr_name = "aes-ni";
+        }
+    #endif
+
+    #ifndef __ENC_NO_PRINTS__
+        printf("AES-CTR backend: %s\n", ctr_name);
+    #endif
+}
+
+int ctr_setKey(struct ctr_key *restrict key, const unsigned char *restrict userKey, int bits) {
+    int i, b;
+    int words = bits/32;
+    uint32_t temp;
+    uint32_t rcon = 0x01;
+    uint32_t *w = key->tables.rd_key;
+
+    uint8_t blocks[4*aes_BLOCK_SIZE];
+
+    if (blocksKernel == NULL)
+        _ctr_setup();
+
+    if (!userKey || !key)
+        return -1;
+    if (bits != 128 && bits != 192 && bits != 256)
+        return -2;
+
+    // FIPS-197 key expansion, the words big endian as in aes.c, without its tables
+    key->tables.rounds = words+6;
+    for (i = 0; i < words; i++)
+        w[i] = ((uint32_t) userKey[4*i] << 24) | ((uint32_t) userKey[4*i+1] << 16) | ((uint32_t) userKey[4*i+2] << 8) | userKey[4*i+3];
+
+    for (i = words; i < 4*(key->tables.rounds+1); i++) {
+        temp = w[i-1];
+        if (i % words == 0) {
+            temp = _ctr_sub_word((temp << 8) | (temp >> 24)) ^ (rcon << 24);
+            rcon = (rcon << 1) ^ (0x11B & -(rcon >> 7));
+        } else if (words > 6 && i % words == 4) {
+            temp = _ctr_sub_word(temp);
+        }
+        w[i] = w[i-words] ^ temp;
+    }
+
+    for (i = 0; i < 4*(key->tables.rounds+1); i++) {
+        key->roundKeys[4*i] = (uint8_t) (w[i] >> 24);
+        key->roundKeys[4*i+1] = (uint8_t) (w[i] >> 16);
+        key->roundKeys[4*i+2] = (uint8_t) (w[i] >> 8);
+        key->roundKeys[4*i+3] = (uint8_t) w[i];
+    }
+
+    // The same round key for every block of a lane
+    for (i = 0; i <= key->tables.rounds; i++) {
+        for (b = 0; b < 4; b++)
+            memcpy(blocks+b*aes_BLOCK_SIZE, key->roundKeys+i*aes_BLOCK_SIZE, aes_BLOCK_SIZE);
+
+        _ctr_pack(key->slicedKeys+i*CTR_SLICE_PLANES, blocks);
+    }
+
+    return 0;
+}
+
+void ctr_blocks(const struct ctr_key *restrict key, const uint8_t *restrict counterBlock, uint32_t firstBlock, int order, size_t blocks, uint8_t *restrict keystream) {
+    blocksKernel(key, counterBlock, firstBlock, order, blocks, keystream);
+}
+
+const char *ctr_backend() {
+    return ctr_name;
+}
+
+int ctr_hardware() {
+    if (blocksKernel == NULL)
+        _ctr_setup();
+
+    #ifdef __ENC_CTR_X86__
+        return blocksKernel == _ctr_blocks_aesni;
+    #else
+        return 0;
+    #endif
+}
@@ -0,0 +1,41 @@
+#ifndef __ENC_CTR_H__
+#define __ENC_CTR_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes.h"
+
+// Counter block: the last 4 bytes hold the block counter, in either byte order
+#define CTR_COUNTER_OFFSET 12
+#define CTR_LITTLE_ENDIAN 0
+#define CTR_BIG_ENDIAN 1
+
+// AES-NI keeps this many counter blocks in flight
+#define CTR_PIPELINE_BLOCKS 8
+
+// The bitsliced backend holds bit i of every byte of 4 blocks in the 64-bit plane i
+#define CTR_SLICE_PLANES 8
+
+// An expanded AES encryption key, as the T-tables of aes.c use it, as the
+// round keys in byte order the vector backends load and as bit planes
+struct ctr_key {
+    aes_key tables;
+    uint8_t roundKeys[(aes_MAXNR+1)*aes_BLOCK_SIZE];
+    uint64_t slicedKeys[(aes_MAXNR+1)*CTR_SLICE_PLANES];
+};
+
+// Expands the key in constant time, picking the backend on the first call. bits can be 128, 192 or 256
+int ctr_setKey(struct ctr_key *restrict key, const unsigned char *restrict userKey, int bits);
+
+// Keystream of blocks counter blocks: counterBlock with the block counter set to
+// firstBlock, firstBlock+1, ... in the given order, wrapping at 32 bits as the
+// inc32 of GCM does. Every backend produces the same bytes.
+void ctr_blocks(const struct ctr_key *restrict key, const uint8_t *restrict counterBlock, uint32_t firstBlock, int order, size_t blocks, uint8_t *restrict keystream);
+
+const char *ctr_backend();
+
+// Whether the backend runs on AES instructions, picking it if no key was set yet
+int ctr_hardware();
+
+#endif
@@ -1,402 +1,857 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "globals.h"
 #include "codec.h"
+#include "profile.h"
+#include "quantizer.h"
+#include "dtx.h"
+#include "stereo.h"
+#include "filterbank.h"
+#include "qmf_tables.h"
 #include "decode.h"
+#include "bitstream.h"
+#include "entropy.h"
+#include "workers.h"
 
-#define CONV(signal, index, filter) (signal)[(index)]*(filter)[0] + (signal)[(index)-1]*(filter)[1] + (signal)[(index)-2]*(filter)[2] + (signal)[(index)-3]*(filter)[3] + (signal)[(index)-4]*(filter)[4] + (signal)[(index)-5]*(filter)[5] + (signal)[(index)-6]*(filter)[6] + (signal)[(index)-7]*(filter)[7] + (signal)[(index)-8]*(filter)[8] + (signal)[(index)-9]*(filter)[9];
-#define SUMABS(signal) abs((signal[0])) + abs((signal[1])) + abs((signal[2])) + abs((signal[3])) + abs((signal[4])) + abs((signal[5])) + abs((signal[6])) + abs((signal[7])) + abs((signal[8])) + abs((signal[9]));
+#ifndef MIN
+    #define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
 
-void decode(struct decode_chunk_struct * restrict chunk_left, struct decode_chunk_struct * restrict chunk_right, short encoded[BUFFERSIZE], short decoded_0[BUFFERSIZE])
+/* Constructs the quantiser of every group of the profile */
+static void _quantizer_restart(struct quantizer_struct quantizer[], const struct profile_struct *profile)
 {
-    short i, j, e;
+    short g;
 
-    short decoded_left1a[BUFFERSIZE_4];
-    short decoded_left1b[BUFFERSIZE_4];
-    short decoded_right1a[BUFFERSIZE_4];
-    short decoded_right1b[BUFFERSIZE_4];
-    short encoded_tmp[BUFFERSIZE];
+    for (g = 0 ; g < GROUPS(profile->depth) ; g++)
+        quantizer_construct(&quantizer[g], profile + g);
+}
 
-    short filter_even[FLENGTH_2] = SYNTHESISFILTER_EVEN;
-    short filter_odd[FLENGTH_2] = SYNTHESISFILTER_ODD;
-    int even;
-    int odd;
-    int mean;
+void decode_construct(struct decode_chunk_struct *chunk, short frameSize, const struct profile_struct *profile, const struct qmf_struct *qmf, short flags)
+{
+    memset(chunk, 0, sizeof(struct decode_chunk_struct));
+    chunk->frameSize = frameSize;
+    chunk->flags = flags;
+    chunk->qmf = qmf;
+    chunk->profile = profile;
+    chunk->side = profile_side(profile);
+
+    _quantizer_restart(chunk->quantizer, profile);
+    comfort_noise_construct(&chunk->noise, 1);
+}
 
-    div_t temp_div;
-    int temp_sum;
+/* Moves the taps - 1 history entries of the window at offset to the front */
+static void _mirror_history(short history[], short offset, short taps)
+{
+    memmove(history, history + offset, (taps - 1) * sizeof(short));
+}
 
+/* One synthesis output: the taps entries of signal up to index against the filter */
+QMF_INLINE int _conv(const short *signal, short index, const short *filter, const short taps)
+{
+    short k;
+    int sum = 0;
 
-    /********************/
-    /** Bit Degrouping **/
-    /********************/
-    encoded_tmp[0] = ((encoded[0] & 0xF800) >> 11) + MIN_LEVEL_1;
-    encoded_tmp[1] = ((encoded[0] & 0x700) >> 8) + MIN_LEVEL_2;
-    encoded_tmp[2] = ((encoded[0] & 0xC0) >> 6) + MIN_LEVEL_3;
-    encoded_tmp[3] = ((encoded[0] & 0x30) >> 4) + MIN_LEVEL_4;
-    encoded_tmp[6] = ((encoded[0] & 0xc) >> 2) + MIN_LEVEL_3;
-    encoded_tmp[7] = (encoded[0] & 0x3) + MIN_LEVEL_4;
-
-    encoded_tmp[4] = ((encoded[1] & 0xF800) >> 11) + MIN_LEVEL_1;
-    encoded_tmp[5] = ((encoded[1] & 0x700) >> 8) + MIN_LEVEL_2;
-    encoded_tmp[8] = ((encoded[1] & 0xF8) >> 3) + MIN_LEVEL_1;
-    encoded_tmp[9] = (encoded[1] & 0x7) + MIN_LEVEL_2;
-
-    encoded_tmp[10] = ((encoded[2] & 0xc000) >> 14) + MIN_LEVEL_3;
-    encoded_tmp[11] = ((encoded[2] & 0x3000) >> 12) + MIN_LEVEL_4;
-    encoded_tmp[12] = ((encoded[2] & 0xF80) >> 7) + MIN_LEVEL_1;
-    encoded_tmp[13] = ((encoded[2] & 0x70) >> 4) + MIN_LEVEL_2;
-    encoded_tmp[14] = ((encoded[2] & 0xc) >> 2) + MIN_LEVEL_3;
-    encoded_tmp[15] = (encoded[2] & 0x3) + MIN_LEVEL_4;
-
-    encoded_tmp[16] = ((encoded[3] & 0xF800) >> 11) + MIN_LEVEL_1;
-    encoded_tmp[17] = ((encoded[3] & 0x700) >> 8) + MIN_LEVEL_2;
-    encoded_tmp[18] = ((encoded[3] & 0xC0) >> 6) + MIN_LEVEL_3;
-    encoded_tmp[19] = ((encoded[3] & 0x30) >> 4) + MIN_LEVEL_4;
-    encoded_tmp[22] = ((encoded[3] & 0xc) >> 2) + MIN_LEVEL_3;
-    encoded_tmp[23] = (encoded[3] & 0x3) + MIN_LEVEL_4;
-
-    encoded_tmp[20] = ((encoded[4] & 0xF800) >> 11) + MIN_LEVEL_1;
-    encoded_tmp[21] = ((encoded[4] & 0x700) >> 8) + MIN_LEVEL_2;
-    encoded_tmp[24] = ((encoded[4] & 0xF8) >> 3) + MIN_LEVEL_1;
-    encoded_tmp[25] = (encoded[4] & 0x7) + MIN_LEVEL_2;
-
-    encoded_tmp[26] = ((encoded[5] & 0xc000) >> 14) + MIN_LEVEL_3;
-    encoded_tmp[27] = ((encoded[5] & 0x3000) >> 12) + MIN_LEVEL_4;
-    encoded_tmp[28] = ((encoded[5] & 0xF80) >> 7) + MIN_LEVEL_1;
-    encoded_tmp[29] = ((encoded[5] & 0x70) >> 4) + MIN_LEVEL_2;
-    encoded_tmp[30] = ((encoded[5] & 0xc) >> 2) + MIN_LEVEL_3;
-    encoded_tmp[31] = (encoded[5] & 0x3) + MIN_LEVEL_4;
-
-    encoded_tmp[32] = ((encoded[6] & 0xF800) >> 11) + MIN_LEVEL_1;
-    encoded_tmp[33] = ((encoded[6] & 0x700) >> 8) + MIN_LEVEL_2;
-    encoded_tmp[34] = ((encoded[6] & 0xC0) >> 6) + MIN_LEVEL_3;
-    encoded_tmp[35] = ((encoded[6] & 0x30) >> 4) + MIN_LEVEL_4;
-    encoded_tmp[38] = ((encoded[6] & 0xc) >> 2) + MIN_LEVEL_3;
-    encoded_tmp[39] = (encoded[6] & 0x3) + MIN_LEVEL_4;
-
-    encoded_tmp[36] = ((encoded[7] & 0xF800) >> 11) + MIN_LEVEL_1;
-    encoded_tmp[37] = ((encoded[7] & 0x700) >> 8) + MIN_LEVEL_2;
-
-
-    for (i = 0 ; i < BUFFERSIZE_8 ; i++) {
-        chunk_left->diff_deq_index++;
-        if (chunk_left->diff_deq_index >= QLENGTH) {
-            chunk_left->diff_deq_index = 0;
-        }
+    QMF_UNROLL
+    for (k = 0 ; k < taps ; k++)
+        sum += signal[index - k] * filter[k];
 
-        /*******************************/
-        /** Decoding Subband One Left **/
-        /*******************************/
-        chunk_left->diff_deq[0][chunk_left->diff_deq_index] = (short) (encoded_tmp[i << 3] * chunk_left->Qstep[0]);
+    return sum;
+}
 
-        // meanAbs
-        temp_sum = SUMABS(chunk_left->diff_deq[0]);
+/* Words of the DTX header in front of the sections of a frame of channels */
+static short _header_words(struct decode_chunk_struct *const chunks[], short channels)
+{
+    short bits = (channels << 1) + ((chunks[0]->flags & CODEC_JOINT) ? STEREO_BITS(channels) : 0);
 
-        temp_div = div(temp_sum, QLENGTH);
+    return (chunks[0]->flags & CODEC_DTX) ? DTX_HEADER_WORDS(bits) : 0;
+}
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            mean = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            mean = temp_div.quot - 1;
-        } else {
-            mean = temp_div.quot;
-        }
+/* Bits in front of the levels of channel c of a frame of channels: the stereo
+ * mode of its pair on the first channel of a pair without CODEC_DTX */
+static short _skip(const struct decode_chunk_struct *chunk, short c, short channels)
+{
+    return ((chunk->flags & (CODEC_JOINT | CODEC_DTX)) == CODEC_JOINT && !(c & 1) && c + 1 < channels) ? 2 : 0;
+}
 
-        chunk_left->Qstep[0] = (short) (mean * PHI_1 >> 13);
-        if (chunk_left->Qstep[0] < QMIN) {
-            chunk_left->Qstep[0] = QMIN;
-        } else if (chunk_left->Qstep[0] > QMAX_1) {
-            chunk_left->Qstep[0] = QMAX_1;
-        }
+/* Stereo mode of the pair of channel c in the frame at encoded, whose first
+ * channel has its section at section, see stereo.h */
+static short _stereo_mode(struct decode_chunk_struct *const chunks[], const short *encoded, const short *section, short channels, short c, short sync)
+{
+    unsigned int header;
+    short mode;
+
+    if (!(chunks[0]->flags & CODEC_JOINT) || (c | 1) >= channels)
+        return STEREO_LR;
+
+    if (chunks[0]->flags & CODEC_DTX) {
+        header = (unsigned short) encoded[0];
+        if (_header_words(chunks, channels) > 1)
+            header |= (unsigned int) (unsigned short) encoded[1] << 16;
+        mode = STEREO_MODE(header >> (channels << 1), c >> 1);
+    } else {
+        mode = (unsigned short) section[sync ? SYNC_WORDS * GROUPS(chunks[0]->profile->depth) : 0] >> 14;
+    }
 
-        encoded_tmp[i << 3] = (short) (chunk_left->diff_deq[0][chunk_left->diff_deq_index] + chunk_left->prediction[0]);
-        chunk_left->prediction[0] = (short)((MU_1*(encoded_tmp[i << 3])) >> 15);
+    return (mode == STEREO_MS || mode == STEREO_MID) ? mode : STEREO_LR;
+}
 
-        /*******************************/
-        /** Decoding Subband Two Left **/
-        /*******************************/
-        chunk_left->diff_deq[1][chunk_left->diff_deq_index] = (short) (encoded_tmp[(i << 3)+1] * chunk_left->Qstep[1]);
+/* Type of the section of channel c in the frame at encoded, whose pair is in the given stereo mode */
+static short _section_type(struct decode_chunk_struct *const chunks[], const short *encoded, short c, short mode)
+{
+    short type;
 
-        //meanAbs
-        temp_sum = SUMABS(chunk_left->diff_deq[1]);
+    if ((c & 1) && mode == STEREO_MID)
+        return DTX_NODATA;
+    if (!(chunks[0]->flags & CODEC_DTX))
+        return DTX_SPEECH;
 
-        temp_div = div(temp_sum, QLENGTH);
+    type = DTX_TYPE((unsigned short) *encoded, c);
+    return (type == DTX_SPEECH || type == DTX_SID) ? type : DTX_NODATA;
+}
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            mean = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            mean = temp_div.quot - 1;
-        } else {
-            mean = temp_div.quot;
-        }
+/* Profile of channel c in a frame of the given stereo mode */
+static const struct profile_struct *_profile(const struct decode_chunk_struct *chunk, short c, short mode)
+{
+    return ((c & 1) && mode == STEREO_MS) ? chunk->side : chunk->profile;
+}
 
-        chunk_left->Qstep[1] = (short) (mean * PHI_2 >> 13);
-        if (chunk_left->Qstep[1] < QMIN) {
-            chunk_left->Qstep[1] = QMIN;
-        } else if (chunk_left->Qstep[1] > QMAX_2) {
-            chunk_left->Qstep[1] = QMAX_2;
-        }
+/* Words of a section of the given type whose levels start skip bits in, at most its worst case */
+static short _section_length(const struct decode_chunk_struct *chunk, const struct profile_struct *profile, const short *section, short type, short sync, short skip)
+{
+    short snapshot = sync ? SYNC_WORDS * GROUPS(profile->depth) : 0;
 
-        encoded_tmp[(i << 3)+1] = (short) (chunk_left->diff_deq[1][chunk_left->diff_deq_index] + chunk_left->prediction[1]);
-        chunk_left->prediction[1] = (short)((MU_2*(encoded_tmp[(i << 3)+1])) >> 15);
+    if (type == DTX_NODATA)
+        return 0;
+    if (type == DTX_SID)
+        return 1;
+    if (chunk->flags & CODEC_ENTROPY)
+        return snapshot + entropy_length(profile, chunk->frameSize, section + snapshot, skip);
 
-        /*********************************/
-        /** Decoding Subband Three Left **/
-        /*********************************/
-        chunk_left->diff_deq[2][chunk_left->diff_deq_index] = (short) (encoded_tmp[(i << 3)+2] * chunk_left->Qstep[2]);
+    return snapshot + bitstream_size(profile, chunk->frameSize, skip);
+}
 
-        //meanAbs
-        temp_sum = SUMABS(chunk_left->diff_deq[2]);
+/* Finds the section of channel c in a frame of channels at encoded, or the next
+ * frame for c == channels, and the stereo mode of its pair when mode is not NULL.
+ * Sections may vary in length, so they are followed from the first. */
+static short *_section(struct decode_chunk_struct *const chunks[], const short *encoded, short channels, short c, short sync, short *mode)
+{
+    const short *section = encoded + _header_words(chunks, channels);
+    const struct profile_struct *profile;
+    short pair = STEREO_LR;
+    short i;
+
+    for (i = 0 ; i < c ; i++) {
+        if (!(i & 1))
+            pair = _stereo_mode(chunks, encoded, section, channels, i, sync);
+        profile = _profile(chunks[i], i, pair);
+        section += _section_length(chunks[i], profile, section, _section_type(chunks, encoded, i, pair), sync, _skip(chunks[i], i, channels));
+    }
 
-        temp_div = div(temp_sum, QLENGTH);
+    if (mode != NULL)
+        *mode = (c & 1) ? pair : _stereo_mode(chunks, encoded, section, channels, c, sync);
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            mean = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            mean = temp_div.quot - 1;
-        } else {
-            mean = temp_div.quot;
-        }
+    return (short *) section;
+}
 
-        chunk_left->Qstep[2] = (short) (mean * PHI_3 >> 13);
-        if (chunk_left->Qstep[2] < QMIN) {
-            chunk_left->Qstep[2] = QMIN;
-        } else if (chunk_left->Qstep[2] > QMAX_3) {
-            chunk_left->Qstep[2] = QMAX_3;
-        }
+/* Words of frames consecutive frames from frame number start */
+static long _walk_frames(struct decode_chunk_struct *const chunks[], short channels, const short encoded[], int start, int frames)
+{
+    const short *end = encoded;
+    int frame;
 
-        encoded_tmp[(i << 3)+2] = (short) (chunk_left->diff_deq[2][chunk_left->diff_deq_index] + chunk_left->prediction[2]);
-        chunk_left->prediction[2] = (short)((MU_3*(encoded_tmp[(i << 3)+2])) >> 15);
+    for (frame = start ; frame < start + frames ; frame++)
+        end = _section(chunks, end, channels, channels, SYNC_FRAME(chunks[0]->flags, chunks[0]->frameSize, frame), NULL);
 
-        /********************************/
-        /** Decoding Subband Four Left **/
-        /********************************/
-        chunk_left->diff_deq[3][chunk_left->diff_deq_index] = (short) (encoded_tmp[(i << 3)+3] * chunk_left->Qstep[3]);
+    return end - encoded;
+}
 
-        //meanAbs
-        temp_sum = SUMABS(chunk_left->diff_deq[3]);
+/* Channels are decoded in pairs, so the quantiser advances both in one step */
+struct decode_job {
+    struct decode_chunk_struct *const *chunks;
+    short channels;
+    short *encoded;
+    short *const *decoded;
+};
+
+struct decode_frames_job {
+    struct decode_chunk_struct *const *chunks;
+    short channels;
+    int frames;
+    const short *encoded;
+    short *pcm;
+};
+
+/* Segments of a span, each with its own decoders, start at sync frames */
+struct decode_segments_job {
+    struct decode_chunk_struct *const *chunks;
+    short channels;
+    short segments;
+    const short *encoded;
+    short *pcm;
+    int start;
+    int frames;
+    int bounds[MAX_SEGMENTS + 1];
+};
+
+/* Gathers the subbands of one channel frame from their groups, subband b at b * (frameSize >> depth) */
+static void _subbands(const struct decode_chunk_struct *restrict chunk, const short *restrict values, short *restrict bands)
+{
+    short i, b;
+    short depth = chunk->profile->depth;
+    short samples = chunk->frameSize >> depth;
 
-        temp_div = div(temp_sum, QLENGTH);
+    for (b = 0 ; b < (1 << depth) ; b++) {
+        for (i = 0 ; i < samples ; i++)
+            bands[b * samples + i] = values[SUBBAND_INDEX(depth, chunk->frameSize, b, i)];
+    }
+}
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            mean = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            mean = temp_div.quot - 1;
-        } else {
-            mean = temp_div.quot;
-        }
+/* Recombines the 2^depth reconstructed subbands of one channel frame, from the
+ * deepest level of the tree up */
+QMF_INLINE void _decode_synthesis_taps(struct decode_chunk_struct *restrict chunk, const short *restrict values, short *restrict decoded, const short taps)
+{
+    short i, j, l, n;
+    short depth = chunk->profile->depth;
 
-        chunk_left->Qstep[3] = (short) (mean * PHI_4 >> 13);
-        if (chunk_left->Qstep[3] < QMIN) {
-            chunk_left->Qstep[3] = QMIN;
-        } else if (chunk_left->Qstep[3] > QMAX_4) {
-            chunk_left->Qstep[3] = QMAX_4;
-        }
+    /*Output samples per node of the level and its history per node*/
+    short samples;
+    short stride;
 
-        encoded_tmp[(i << 3)+3] = (short) (chunk_left->diff_deq[3][chunk_left->diff_deq_index] + chunk_left->prediction[3]);
-        chunk_left->prediction[3] = (short)((MU_4*(encoded_tmp[(i << 3)+3])) >> 15);
+    /*Inputs of every level, child c of level l + 1 at c * (frameSize >> (l + 1))*/
+    short bands[2][MAX_FRAMESIZE];
+    const short *input = bands[depth & 1];
+    const short *low, *high;
+    short *output;
 
-        /********************************/
-        /** Decoding Subband One Right **/
-        /********************************/
-        chunk_right->diff_deq[0][chunk_left->diff_deq_index] = (short) (encoded_tmp[(i << 3)+4] * chunk_right->Qstep[0]);
+    /*Current windows into a node's history*/
+    short *t1, *t2;
+    struct synthesis_level_struct *level;
 
-        //meanAbs
-        temp_sum = SUMABS(chunk_right->diff_deq[0]);
+    const short *filter_even = chunk->qmf->synthesis_even;
+    const short *filter_odd = chunk->qmf->synthesis_odd;
 
-        temp_div = div(temp_sum, QLENGTH);
+    _subbands(chunk, values, bands[depth & 1]);
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            mean = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            mean = temp_div.quot - 1;
-        } else {
-            mean = temp_div.quot;
+    /***************/
+    /** Synthesis **/
+    /***************/
+    for (l = depth - 1 ; l >= 0 ; l--) {
+        level = &chunk->levels[l];
+        samples = chunk->frameSize >> l;
+        stride = LEVEL_HISTORY >> l;
+        output = (l == 0) ? decoded : bands[l & 1];
+
+        // Mirror the history to the front once the next frame does not fit behind it
+        if (level->window + taps - 1 + (samples >> 1) > stride) {
+            for (n = 0 ; n < (1 << l) ; n++) {
+                _mirror_history(level->t1 + n * stride, level->window, taps);
+                _mirror_history(level->t2 + n * stride, level->window, taps);
+            }
+            level->window = 0;
         }
 
-        chunk_right->Qstep[0] = (short) (mean * PHI_1 >> 13);
-        if (chunk_right->Qstep[0] < QMIN) {
-            chunk_right->Qstep[0] = QMIN;
-        } else if (chunk_right->Qstep[0] > QMAX_1) {
-            chunk_right->Qstep[0] = QMAX_1;
+        for (n = 0 ; n < (1 << l) ; n++) {
+            t1 = level->t1 + n * stride + level->window;
+            t2 = level->t2 + n * stride + level->window;
+            low = input + n * samples;
+            high = low + (samples >> 1);
+
+            for (i = 0 ; i < (samples >> 1) ; i++) {
+                j = i + taps - 1;
+                t1[j] = low[i] + high[i];
+                t2[j] = low[i] - high[i];
+
+                output[n * samples + (i << 1)] = _conv(t1, j, filter_even, taps) >> 14;
+                output[n * samples + (i << 1) + 1] = _conv(t2, j, filter_odd, taps) >> 14;
+            }
         }
 
-        encoded_tmp[(i << 3)+4] = (short) (chunk_right->diff_deq[0][chunk_left->diff_deq_index] + chunk_right->prediction[0]);
-        chunk_right->prediction[0] = (short)((MU_1*(encoded_tmp[(i << 3)+4])) >> 15);
+        level->window += samples >> 1;
+        input = output;
+    }
+}
 
-        /********************************/
-        /** Decoding Subband Two Right **/
-        /********************************/
-        chunk_right->diff_deq[1][chunk_left->diff_deq_index] = (short) (encoded_tmp[(i << 3)+5] * chunk_right->Qstep[1]);
+#define DECODE_SYNTHESIS(length) \
+    static void _decode_synthesis_##length(struct decode_chunk_struct *restrict chunk, const short *restrict values, short *restrict decoded) \
+    { \
+        _decode_synthesis_taps(chunk, values, decoded, length/2); \
+    }
 
-        //meanAbs
-        temp_sum = SUMABS(chunk_right->diff_deq[1]);
+QMF_LENGTHS(DECODE_SYNTHESIS)
 
-        temp_div = div(temp_sum, QLENGTH);
+static inline short _saturate(int value)
+{
+    return (short) (value > 32767 ? 32767 : (value < -32768 ? -32768 : value));
+}
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            mean = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            mean = temp_div.quot - 1;
-        } else {
-            mean = temp_div.quot;
+/* _decode_synthesis_taps() with the lifting filter bank of CODEC_LIFTING, its
+ * subbands shifted back from QMF scale to lifting scale */
+static void _decode_synthesis_lifting(struct decode_chunk_struct *restrict chunk, const short *restrict values, short *restrict decoded)
+{
+    short i, l, n, b, scale;
+    short depth = chunk->profile->depth;
+    short samples = chunk->frameSize >> depth;
+    int bands[2][MAX_FRAMESIZE];
+    const int *input = bands[depth & 1];
+    int *output;
+
+    for (b = 0 ; b < (1 << depth) ; b++) {
+        scale = 1 << lifting_shift(depth, b);
+        for (i = 0 ; i < samples ; i++)
+            bands[depth & 1][b * samples + i] = values[SUBBAND_INDEX(depth, chunk->frameSize, b, i)] * scale;
+    }
+
+    for (l = depth - 1 ; l >= 0 ; l--) {
+        samples = chunk->frameSize >> l;
+        output = bands[l & 1];
+
+        for (n = 0 ; n < (1 << l) ; n++)
+            lifting_synthesis(&chunk->levels[l].lifting[n], input + n * samples, input + n * samples + (samples >> 1), samples >> 1, output + n * samples);
+
+        input = output;
+    }
+
+    for (i = 0 ; i < chunk->frameSize ; i++)
+        decoded[i] = _saturate(input[i]);
+}
+
+/* Synthesis with the kernel of the chunk's filter bank */
+static void _decode_synthesis(struct decode_chunk_struct *restrict chunk, const short *restrict values, short *restrict decoded)
+{
+    #define DECODE_SYNTHESIS_CASE(length) \
+        case length: \
+            _decode_synthesis_##length(chunk, values, decoded); \
+            break;
+
+    if (chunk->flags & CODEC_LIFTING) {
+        _decode_synthesis_lifting(chunk, values, decoded);
+        return;
+    }
+
+    switch (chunk->qmf->length) {
+        QMF_LENGTHS(DECODE_SYNTHESIS_CASE)
+    }
+}
+
+/* Continues the last received frame of subband values for a lost one, mirrored
+ * at its ends so the extension stays continuous, fading out over PLC_FADE.
+ * Every block of the frame is continued alike, step by step of 4 lanes. */
+static void _conceal(struct decode_chunk_struct *restrict chunk, short *restrict values)
+{
+    short i, s, m, g;
+    short groups = GROUPS(chunk->profile->depth);
+    short block = chunk->frameSize / groups;
+    short samples = block >> 2;
+
+    /*Temporal samples per step*/
+    short step = chunk->frameSize / samples;
+    int t, gain;
+
+    for (i = 0 ; i < samples ; i++) {
+        t = chunk->lost + i * step;
+        m = (short) ((t / step) % (samples << 1));
+        m = (m < samples) ? samples - 1 - m : m - samples;
+        gain = (t < PLC_FADE) ? ((PLC_FADE - t) << 15) / PLC_FADE : 0;
+
+        for (g = 0 ; g < groups ; g++) {
+            for (s = 0 ; s < 4 ; s++)
+                values[g * block + (i << 2) + s] = (short) ((chunk->concealment[g * block + (m << 2) + s] * gain) >> 15);
         }
+    }
+
+    if (chunk->lost < PLC_FADE)
+        chunk->lost += chunk->frameSize;
+}
+
+/* Crossfades from the concealment into the first frame received after a loss */
+static void _ramp_in(struct decode_chunk_struct *restrict chunk, short *restrict values)
+{
+    short i, e, g;
+    short block = chunk->frameSize / GROUPS(chunk->profile->depth);
+    short samples = block >> 2;
+    short concealed[MAX_FRAMESIZE];
+
+    _conceal(chunk, concealed);
 
-        chunk_right->Qstep[1] = (short) (mean * PHI_2 >> 13);
-        if (chunk_right->Qstep[1] < QMIN) {
-            chunk_right->Qstep[1] = QMIN;
-        } else if (chunk_right->Qstep[1] > QMAX_2) {
-            chunk_right->Qstep[1] = QMAX_2;
+    for (g = 0 ; g < chunk->frameSize ; g += block) {
+        for (i = 0 ; i < samples ; i++) {
+            for (e = g + (i << 2) ; e < g + (i << 2) + 4 ; e++)
+                values[e] = (short) ((concealed[e] * (samples - i) + values[e] * i) / samples);
         }
+    }
 
-        encoded_tmp[(i << 3)+5] = (short) (chunk_right->diff_deq[1][chunk_left->diff_deq_index] + chunk_right->prediction[1]);
-        chunk_right->prediction[1] = (short)((MU_2*(encoded_tmp[(i << 3)+5])) >> 15);
+    chunk->lost = 0;
+}
 
-        /**********************************/
-        /** Decoding Subband Three Right **/
-        /**********************************/
-        chunk_right->diff_deq[2][chunk_left->diff_deq_index] = (short) (encoded_tmp[(i << 3)+6] * chunk_right->Qstep[2]);
+/* Runs the quantisers of the given channels group by group over their frames of values */
+static void _quantize_groups(struct decode_chunk_struct *const chunks[], short *const values[], short channels, short encode)
+{
+    short c, g;
+    short groups, block;
+    short *levels[2] = {NULL, NULL};
+    struct quantizer_struct *states[2] = {NULL, NULL};
 
-        //meanAbs
-        temp_sum = SUMABS(chunk_right->diff_deq[2]);
+    if (channels == 0)
+        return;
 
-        temp_div = div(temp_sum, QLENGTH);
+    groups = GROUPS(chunks[0]->profile->depth);
+    block = chunks[0]->frameSize / groups;
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            mean = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            mean = temp_div.quot - 1;
-        } else {
-            mean = temp_div.quot;
+    for (g = 0 ; g < groups ; g++) {
+        for (c = 0 ; c < channels ; c++) {
+            states[c] = &chunks[c]->quantizer[g];
+            levels[c] = values[c] + g * block;
         }
 
-        chunk_right->Qstep[2] = (short) (mean * PHI_3 >> 13);
-        if (chunk_right->Qstep[2] < QMIN) {
-            chunk_right->Qstep[2] = QMIN;
-        } else if (chunk_right->Qstep[2] > QMAX_3) {
-            chunk_right->Qstep[2] = QMAX_3;
-        }
+        if (encode)
+            quantizer_encode(states, levels, channels, block >> 2);
+        else
+            quantizer_decode(states, levels, channels, block >> 2);
+    }
+}
 
-        encoded_tmp[(i << 3)+6] = (short) (chunk_right->diff_deq[2][chunk_left->diff_deq_index] + chunk_right->prediction[2]);
-        chunk_right->prediction[2] = (short)((MU_3*(encoded_tmp[(i << 3)+6])) >> 15);
+/* Conceals one lost frame of up to two channels */
+static void _decode_lost(struct decode_chunk_struct *const chunks[], short channels, short *const decoded[])
+{
+    short c;
+    short mode = (channels == 2) ? chunks[1]->stereo : STEREO_LR;
+    short values[2][MAX_FRAMESIZE];
+    short scratch[2][MAX_FRAMESIZE];
+    short *levels[2] = {scratch[0], scratch[1]};
+
+    for (c = 0 ; c < channels ; c++) {
+        chunks[c]->frame++;
+        _conceal(chunks[c], values[c]);
+        memcpy(scratch[c], values[c], chunks[c]->frameSize * sizeof(short));
+    }
 
-        /*********************************/
-        /** Decoding Subband Four Right **/
-        /*********************************/
-        chunk_right->diff_deq[3][chunk_left->diff_deq_index] = (short) (encoded_tmp[(i << 3)+7] * chunk_right->Qstep[3]);
+    // Encoding the concealment moves the quantisers to where the encoder's would be for it, in the last stereo mode
+    if (mode != STEREO_LR)
+        stereo_forward(scratch[0], scratch[1], chunks[0]->frameSize);
+    _quantize_groups(chunks, levels, (mode == STEREO_MID) ? 1 : channels, 1);
 
-        //meanAbs
-        temp_sum = SUMABS(chunk_right->diff_deq[3]);
+    for (c = 0 ; c < channels ; c++)
+        _decode_synthesis(chunks[c], values[c], decoded[c]);
+}
 
-        temp_div = div(temp_sum, QLENGTH);
+/* Decodes one frame of up to two channels, whose pair is in the given stereo mode */
+static void _decode_pair(struct decode_chunk_struct *const chunks[], short channels, short *const encoded[], const short types[], short mode, short sync, short *const decoded[])
+{
+    short c, g;
+    short speech = 0;
+    short groups = GROUPS(chunks[0]->profile->depth);
+    short snapshot = sync ? SYNC_WORDS * groups : 0;
+    short values[2][MAX_FRAMESIZE];
+    short *levels[2] = {NULL, NULL};
+    const struct profile_struct *profile;
+    struct decode_chunk_struct *speaking[2] = {NULL, NULL};
+
+    // A channel whose signal changes with the mode restarts its quantiser on both ends
+    if ((chunks[0]->flags & CODEC_JOINT) && channels == 2) {
+        if ((mode == STEREO_LR) != (chunks[0]->stereo == STEREO_LR))
+            _quantizer_restart(chunks[0]->quantizer, chunks[0]->profile);
+        if (mode != chunks[1]->stereo)
+            _quantizer_restart(chunks[1]->quantizer, _profile(chunks[1], 1, mode));
+
+        chunks[0]->stereo = mode;
+        chunks[1]->stereo = mode;
+    }
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            mean = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            mean = temp_div.quot - 1;
+    /********************/
+    /** Bit Degrouping **/
+    /********************/
+    for (c = 0 ; c < channels ; c++) {
+        profile = _profile(chunks[c], c, mode);
+
+        // Sync frames restart the comfort noise, so it does not depend on where decoding started
+        if (sync)
+            chunks[c]->noise.seed = (unsigned int) chunks[c]->frame;
+        chunks[c]->frame++;
+
+        if (types[c] == DTX_SPEECH) {
+            if (sync) {
+                for (g = 0 ; g < groups ; g++)
+                    quantizer_import(&chunks[c]->quantizer[g], encoded[c] + g * SYNC_WORDS);
+            }
+
+            if (chunks[c]->flags & CODEC_ENTROPY)
+                entropy_unpack(profile, values[c], encoded[c] + snapshot, chunks[c]->frameSize, _skip(chunks[c], c, channels));
+            else
+                bitstream_unpack(profile, values[c], encoded[c] + snapshot, chunks[c]->frameSize, _skip(chunks[c], c, channels));
+
+            speaking[speech] = chunks[c];
+            levels[speech++] = values[c];
         } else {
-            mean = temp_div.quot;
+            // Silence restarts the quantiser on both ends
+            if (types[c] == DTX_SID)
+                comfort_noise_update(&chunks[c]->noise, *encoded[c]);
+
+            if (c == 1 && mode == STEREO_MID)
+                memset(values[c], 0, chunks[c]->frameSize * sizeof(short));
+            else
+                comfort_noise_generate(&chunks[c]->noise, values[c], chunks[c]->frameSize, profile->depth);
+            _quantizer_restart(chunks[c]->quantizer, profile);
         }
+    }
+
+    _quantize_groups(speaking, levels, speech, 0);
+
+    if (mode != STEREO_LR)
+        stereo_inverse(values[0], values[1], chunks[0]->frameSize);
 
-        chunk_right->Qstep[3] = (short) (mean * PHI_4 >> 13);
-        if (chunk_right->Qstep[3] < QMIN) {
-            chunk_right->Qstep[3] = QMIN;
-        } else if (chunk_right->Qstep[3] > QMAX_4) {
-            chunk_right->Qstep[3] = QMAX_4;
+    for (c = 0 ; c < channels ; c++) {
+        if (chunks[c]->lost > 0)
+            _ramp_in(chunks[c], values[c]);
+
+        memcpy(chunks[c]->concealment, values[c], chunks[c]->frameSize * sizeof(short));
+        _decode_synthesis(chunks[c], values[c], decoded[c]);
+    }
+}
+
+static void _decode_task(void *arg, short pair)
+{
+    struct decode_job *job = arg;
+    short first = pair << 1;
+    short *encoded[2];
+    short types[2];
+    short mode;
+    short sync = SYNC_FRAME(job->chunks[first]->flags, job->chunks[first]->frameSize, job->chunks[first]->frame);
+
+    if (job->encoded == NULL) {
+        _decode_lost(job->chunks + first, MIN(2, job->channels - first), job->decoded + first);
+        return;
+    }
+
+    encoded[0] = _section(job->chunks, job->encoded, job->channels, first, sync, &mode);
+    encoded[1] = _section(job->chunks, job->encoded, job->channels, first + 1, sync, NULL);
+    types[0] = _section_type(job->chunks, job->encoded, first, mode);
+    types[1] = _section_type(job->chunks, job->encoded, first + 1, mode);
+
+    _decode_pair(job->chunks + first, MIN(2, job->channels - first), encoded, types, mode, sync, job->decoded + first);
+}
+
+/* One channel pair over all frames of the span, so its state stays in cache */
+static void _decode_frames_task(void *arg, short pair)
+{
+    struct decode_frames_job *job = arg;
+    short first = pair << 1;
+    short channels = MIN(2, job->channels - first);
+    short frameSize = job->chunks[first]->frameSize;
+    const short *frameStart = job->encoded;
+    short buffer[2][MAX_FRAMESIZE];
+    short *decoded[2] = {buffer[0], buffer[1]};
+    short *encoded[2];
+    short types[2];
+    short mode;
+    short sync;
+    short *output = job->pcm + first;
+    short i, c;
+    int frame;
+
+    for (frame = 0 ; frame < job->frames ; frame++) {
+        sync = SYNC_FRAME(job->chunks[first]->flags, frameSize, job->chunks[first]->frame);
+        encoded[0] = _section(job->chunks, frameStart, job->channels, first, sync, &mode);
+        encoded[1] = _section(job->chunks, frameStart, job->channels, first + 1, sync, NULL);
+        types[0] = _section_type(job->chunks, frameStart, first, mode);
+        types[1] = _section_type(job->chunks, frameStart, first + 1, mode);
+        frameStart = _section(job->chunks, frameStart, job->channels, job->channels, sync, NULL);
+        _decode_pair(job->chunks + first, channels, encoded, types, mode, sync, decoded);
+
+        for (i = 0 ; i < frameSize ; i++) {
+            for (c = 0 ; c < channels ; c++)
+                output[c] = buffer[c][i];
+            output += job->channels;
         }
+    }
+}
+
+/* decode_frames() on the calling thread */
+static long _decode_span(struct decode_chunk_struct *const chunks[], short channels, const short encoded[], int frames, short pcm[])
+{
+    short i;
+    short pairs = (channels + 1) >> 1;
+    int start = chunks[0]->frame;
+    struct decode_frames_job job = {chunks, channels, frames, encoded, pcm};
 
-        encoded_tmp[(i << 3)+7] = (short) (chunk_right->diff_deq[3][chunk_left->diff_deq_index] + chunk_right->prediction[3]);
-        chunk_right->prediction[3] = (short)((MU_4*(encoded_tmp[(i << 3)+7])) >> 15);
+    for (i = 0 ; i < pairs ; i++) {
+        _decode_frames_task(&job, i);
     }
 
+    return _walk_frames(chunks, channels, encoded, start, frames);
+}
 
-    /***************/
-    /** Synthesis **/
-    /***************/
-    for (i = 0 ; i < BUFFERSIZE_4 ; i+=2) {
-        e = i >> 1;
-        j = e + FLENGTH_2 - 1;
-        chunk_left->t1_subband_2a[j] = encoded_tmp[e << 3] + encoded_tmp[(e << 3) + 1];
-        chunk_left->t2_subband_2a[j] = encoded_tmp[e << 3] - encoded_tmp[(e << 3) + 1];
-        chunk_left->t1_subband_2c[j] = encoded_tmp[(e << 3) + 2] + encoded_tmp[(e << 3) + 3];
-        chunk_left->t2_subband_2c[j] = encoded_tmp[(e << 3) + 2] - encoded_tmp[(e << 3) + 3];
-        chunk_right->t1_subband_2a[j] = encoded_tmp[(e << 3) + 4] + encoded_tmp[(e << 3) + 5];
-        chunk_right->t2_subband_2a[j] = encoded_tmp[(e << 3) + 4] - encoded_tmp[(e << 3) + 5];
-        chunk_right->t1_subband_2c[j] = encoded_tmp[(e << 3) + 6] + encoded_tmp[(e << 3) + 7];
-        chunk_right->t2_subband_2c[j] = encoded_tmp[(e << 3) + 6] - encoded_tmp[(e << 3) + 7];
+/* A segment after the first restarts at its sync frame. Its first frames only
+ * fill the synthesis filters, the segment before decodes them instead. */
+static void _decode_segment_task(void *arg, short segment)
+{
+    struct decode_segments_job *job = arg;
+    struct decode_chunk_struct *const *chunks = job->chunks + segment * job->channels;
+    short frameSize = chunks[0]->frameSize;
+    short scratch[MAX_CHANNELS * MAX_FRAMESIZE];
+    int first = job->bounds[segment];
+    int last = job->bounds[segment + 1];
+    short flength = (chunks[0]->flags & CODEC_LIFTING) ? LIFTING_LENGTH : chunks[0]->qmf->length;
+    int preroll = (SYNC_PREROLL(flength, chunks[0]->profile->depth) + frameSize - 1) / frameSize;
+    const short *encoded;
+    int frame;
+
+    if (first == last)
+        return;
+
+    encoded = job->encoded + _walk_frames(chunks, job->channels, job->encoded, job->start, first);
+
+    if (segment > 0) {
+        decode_seek(chunks, job->channels, job->start + first);
+
+        for (frame = 0 ; frame < preroll ; frame++)
+            encoded += _decode_span(chunks, job->channels, encoded, 1, scratch);
+        first += preroll;
+    }
 
-        even = CONV(chunk_left->t1_subband_2a, j, filter_even);
-        odd = CONV(chunk_left->t2_subband_2a, j, filter_odd);
+    if (segment + 1 < job->segments)
+        last = MIN(last + preroll, job->frames);
 
-        decoded_left1a[e << 1] = even >> 14;
-        decoded_left1a[(e << 1) + 1] = odd >> 14;
+    _decode_span(chunks, job->channels, encoded, last - first, job->pcm + (long) first * frameSize * job->channels);
+}
 
-        even = CONV(chunk_left->t1_subband_2c, j, filter_even);
-        odd = CONV(chunk_left->t2_subband_2c, j, filter_odd);
+long decode_frames(struct decode_chunk_struct *const chunks[], short channels, const short encoded[], int frames, short pcm[])
+{
+    short i;
+    short pairs = (channels + 1) >> 1;
+    int start = chunks[0]->frame;
+    struct decode_frames_job job = {chunks, channels, frames, encoded, pcm};
+
+    if ((long) frames * chunks[0]->frameSize < PARALLEL_FRAMESIZE) {
+        for (i = 0 ; i < pairs ; i++) {
+            _decode_frames_task(&job, i);
+        }
+    } else {
+        workers_run(_decode_frames_task, &job, pairs);
+    }
 
-        decoded_left1b[e << 1] = even >> 14;
-        decoded_left1b[(e << 1) + 1] = odd >> 14;
+    return _walk_frames(chunks, channels, encoded, start, frames);
+}
 
-        even = CONV(chunk_right->t1_subband_2a, j, filter_even);
-        odd = CONV(chunk_right->t2_subband_2a, j, filter_odd);
+long decode_length(struct decode_chunk_struct *const chunks[], short channels, const short encoded[], int frames)
+{
+    return _walk_frames(chunks, channels, encoded, chunks[0]->frame, frames);
+}
 
-        decoded_right1a[e << 1] = even >> 14;
-        decoded_right1a[(e << 1) + 1] = odd >> 14;
+int decode_seek(struct decode_chunk_struct *const chunks[], short channels, int frame)
+{
+    short c;
 
-        even = CONV(chunk_right->t1_subband_2c, j, filter_even);
-        odd = CONV(chunk_right->t2_subband_2c, j, filter_odd);
+    if (chunks[0]->flags & CODEC_SYNC)
+        frame -= frame % (SYNC_PERIOD / chunks[0]->frameSize);
+    else
+        frame = 0;
 
-        decoded_right1b[e << 1] = even >> 14;
-        decoded_right1b[(e << 1) + 1] = odd >> 14;
+    for (c = 0 ; c < channels ; c++) {
+        decode_construct(chunks[c], chunks[c]->frameSize, chunks[c]->profile, chunks[c]->qmf, chunks[c]->flags);
+        chunks[c]->frame = frame;
+    }
+
+    return frame;
+}
+
+long decode_segments(struct decode_chunk_struct *const chunks[], short channels, short segments, const short encoded[], int frames, short pcm[])
+{
+    short k, c;
+    int period = SYNC_PERIOD / chunks[0]->frameSize;
+    int bound;
+    struct decode_segments_job job;
+
+    if (!(chunks[0]->flags & CODEC_SYNC) || segments < 2)
+        return decode_frames(chunks, channels, encoded, frames, pcm);
+
+    job.chunks = chunks;
+    job.channels = channels;
+    job.segments = MIN(segments, MAX_SEGMENTS);
+    job.encoded = encoded;
+    job.pcm = pcm;
+    job.start = chunks[0]->frame;
+    job.frames = frames;
+
+    // Even splits, moved up to the next sync frame; none but the first may start at the span
+    job.bounds[0] = 0;
+    for (k = 1 ; k < job.segments ; k++) {
+        bound = job.start + (int) ((long) frames * k / job.segments);
+        if (bound == job.start)
+            bound++;
+        bound = (bound + period - 1) / period * period - job.start;
+
+        if (bound < job.bounds[k - 1])
+            bound = job.bounds[k - 1];
+        job.bounds[k] = MIN(bound, frames);
+    }
+    job.bounds[job.segments] = frames;
+
+    workers_run(_decode_segment_task, &job, job.segments);
+
+    // The decoders of the last segment that ran hold the state after the span
+    for (k = job.segments - 1 ; k > 0 && job.bounds[k] == frames ; k--) {}
+    if (k > 0) {
+        for (c = 0 ; c < channels ; c++)
+            *chunks[c] = *chunks[k * channels + c];
+    }
 
-        j =  i + FLENGTH_2 - 1;
-        chunk_left->t1_subband_1[j] = decoded_left1a[i] + decoded_left1b[i];
-        chunk_left->t2_subband_1[j] = decoded_left1a[i] - decoded_left1b[i];
-        chunk_right->t1_subband_1[j] = decoded_right1a[i] + decoded_right1b[i];
-        chunk_right->t2_subband_1[j] = decoded_right1a[i] - decoded_right1b[i];
+    return _walk_frames(chunks, channels, encoded, job.start, frames);
+}
 
-        even = CONV(chunk_left->t1_subband_1, j, filter_even);
-        odd = CONV(chunk_left->t2_subband_1, j, filter_odd);
+short decode(struct decode_chunk_struct *const chunks[], short channels, short encoded[], short *const decoded[])
+{
+    short i;
+    short pairs = (channels + 1) >> 1;
+    int start = chunks[0]->frame;
+    struct decode_job job = {chunks, channels, encoded, decoded};
+
+    if (chunks[0]->frameSize < PARALLEL_FRAMESIZE) {
+        for (i = 0 ; i < pairs ; i++) {
+            _decode_task(&job, i);
+        }
+    } else {
+        workers_run(_decode_task, &job, pairs);
+    }
 
-        j += 1;
-        decoded_0[i << 2] = even >> 14;
-        decoded_0[(i << 2) + 2] = odd >> 14;
+    if (encoded == NULL)
+        return 0;
 
-        chunk_left->t1_subband_1[j] = decoded_left1a[i+1] + decoded_left1b[i+1];
-        chunk_left->t2_subband_1[j] = decoded_left1a[i+1] - decoded_left1b[i+1];
-        chunk_right->t1_subband_1[j] = decoded_right1a[i+1] + decoded_right1b[i+1];
-        chunk_right->t2_subband_1[j] = decoded_right1a[i+1] - decoded_right1b[i+1];
+    return (short) _walk_frames(chunks, channels, encoded, start, 1);
+}
 
-        even = CONV(chunk_left->t1_subband_1, j, filter_even);
-        odd = CONV(chunk_left->t2_subband_1, j, filter_odd);
+/* A serialised state starts with its version, frameSize, flags, the number of its
+ * profile in profiles[], the depth, the number of its filter bank in qmf_filters[],
+ * the frame in two words, the stereo mode and whether the quantisers use the side
+ * profile */
+#define STATE_HEADER 10
 
-        decoded_0[(i+1) << 2] = even >> 14;
-        decoded_0[((i+1) << 2) + 2] = odd >> 14;
+/* Words of the serialised state of a decoder of this configuration */
+static short _state_words(short frameSize, short flags, const struct profile_struct *profile, const struct qmf_struct *qmf)
+{
+    short node = (flags & CODEC_LIFTING) ? LIFTING_STATE_WORDS : qmf->length - 2;
 
-        even = CONV(chunk_right->t1_subband_1, j, filter_even);
-        odd = CONV(chunk_right->t2_subband_1, j, filter_odd);
+    return STATE_HEADER + ((1 << profile->depth) - 1) * node + GROUPS(profile->depth) * QUANTIZER_STATE_WORDS + 8 + frameSize;
+}
 
-        decoded_0[((i+1) << 2) + 1] = even >> 14;
-        decoded_0[((i+1) << 2) + 3] = odd >> 14;
+short decode_serialize(const struct decode_chunk_struct *chunk, short words[])
+{
+    short l, n, g, p, s;
+    short depth = chunk->profile->depth;
+    short taps = chunk->qmf->length >> 1;
+    short stride;
+    short *out = words;
+    const struct synthesis_level_struct *level;
+
+    p = profile_index(chunk->profile);
+    if (p < 0)
+        return 0;
+
+    *out++ = CODEC_STATE_VERSION;
+    *out++ = chunk->frameSize;
+    *out++ = chunk->flags;
+    *out++ = p;
+    *out++ = depth;
+    *out++ = (short) (chunk->qmf - qmf_filters);
+    *out++ = STATE_HIGH(chunk->frame);
+    *out++ = STATE_LOW(chunk->frame);
+    *out++ = chunk->stereo;
+    *out++ = (chunk->quantizer[0].profile == chunk->side) ? 1 : 0;
+
+    // Only the history the next frame reads, in front of the window
+    for (l = 0 ; l < depth ; l++) {
+        level = &chunk->levels[l];
+        stride = LEVEL_HISTORY >> l;
+
+        for (n = 0 ; n < (1 << l) ; n++) {
+            if (chunk->flags & CODEC_LIFTING) {
+                lifting_serialize(&level->lifting[n], out);
+                out += LIFTING_STATE_WORDS;
+            } else {
+                memcpy(out, level->t1 + n * stride + level->window, (taps - 1) * sizeof(short));
+                memcpy(out + taps - 1, level->t2 + n * stride + level->window, (taps - 1) * sizeof(short));
+                out += (taps - 1) << 1;
+            }
+        }
     }
 
-    // Last shift buffers
-    for (i = 0 ; i < FLENGTH_2 - 1 ; i++) {
-        chunk_left->t1_subband_2a[i] = chunk_left->t1_subband_2a[BUFFERSIZE_8 + i];
-        chunk_left->t2_subband_2a[i] = chunk_left->t2_subband_2a[BUFFERSIZE_8 + i];
-        chunk_left->t1_subband_2c[i] = chunk_left->t1_subband_2c[BUFFERSIZE_8 + i];
-        chunk_left->t2_subband_2c[i] = chunk_left->t2_subband_2c[BUFFERSIZE_8 + i];
-        chunk_right->t1_subband_2a[i] = chunk_right->t1_subband_2a[BUFFERSIZE_8 + i];
-        chunk_right->t2_subband_2a[i] = chunk_right->t2_subband_2a[BUFFERSIZE_8 + i];
-        chunk_right->t1_subband_2c[i] = chunk_right->t1_subband_2c[BUFFERSIZE_8 + i];
-        chunk_right->t2_subband_2c[i] = chunk_right->t2_subband_2c[BUFFERSIZE_8 + i];
-
-        chunk_left->t1_subband_1[i] = chunk_left->t1_subband_1[BUFFERSIZE_4 + i];
-        chunk_left->t2_subband_1[i] = chunk_left->t2_subband_1[BUFFERSIZE_4 + i];
-        chunk_right->t1_subband_1[i] = chunk_right->t1_subband_1[BUFFERSIZE_4 + i];
-        chunk_right->t2_subband_1[i] = chunk_right->t2_subband_1[BUFFERSIZE_4 + i];
+    for (g = 0 ; g < GROUPS(depth) ; g++, out += QUANTIZER_STATE_WORDS)
+        quantizer_serialize(&chunk->quantizer[g], out);
+
+    for (s = 0 ; s < 4 ; s++)
+        *out++ = chunk->noise.amplitude[s];
+    *out++ = STATE_HIGH(chunk->noise.seed);
+    *out++ = STATE_LOW(chunk->noise.seed);
+
+    *out++ = STATE_HIGH(chunk->lost);
+    *out++ = STATE_LOW(chunk->lost);
+    memcpy(out, chunk->concealment, chunk->frameSize * sizeof(short));
+    out += chunk->frameSize;
+
+    return (short) (out - words);
+}
+
+short decode_deserialize(struct decode_chunk_struct *chunk, const short words[], short length)
+{
+    short l, n, g, s;
+    short frameSize, flags, taps;
+    short stride;
+    const short *in = words + STATE_HEADER;
+    const struct profile_struct *profile;
+    const struct qmf_struct *qmf;
+    struct synthesis_level_struct *level;
+
+    if (length < STATE_HEADER || words[0] != CODEC_STATE_VERSION)
+        return 0;
+    if (words[3] < 0 || words[3] >= PROFILE_COUNT || words[5] < 0 || words[5] >= QMF_COUNT)
+        return 0;
+
+    frameSize = words[1];
+    flags = words[2];
+    profile = profile_find(profiles[words[3]].name, words[4]);
+    qmf = &qmf_filters[words[5]];
+    taps = qmf->length >> 1;
+
+    if (profile == NULL || frameSize < MIN_FRAMESIZE * GROUPS(profile->depth) || frameSize > MAX_FRAMESIZE || frameSize % (GROUPS(profile->depth) << 2))
+        return 0;
+    if (length < _state_words(frameSize, flags, profile, qmf))
+        return 0;
+
+    decode_construct(chunk, frameSize, profile, qmf, flags);
+    chunk->frame = STATE_INT(words[6], words[7]);
+    chunk->stereo = (words[8] == STEREO_MS || words[8] == STEREO_MID) ? words[8] : STEREO_LR;
+    if (words[9])
+        _quantizer_restart(chunk->quantizer, chunk->side);
+
+    // The histories go to the front of the windows
+    for (l = 0 ; l < profile->depth ; l++) {
+        level = &chunk->levels[l];
+        stride = LEVEL_HISTORY >> l;
+
+        for (n = 0 ; n < (1 << l) ; n++) {
+            if (flags & CODEC_LIFTING) {
+                lifting_deserialize(&level->lifting[n], in);
+                in += LIFTING_STATE_WORDS;
+            } else {
+                memcpy(level->t1 + n * stride, in, (taps - 1) * sizeof(short));
+                memcpy(level->t2 + n * stride, in + taps - 1, (taps - 1) * sizeof(short));
+                in += (taps - 1) << 1;
+            }
+        }
     }
 
-    return;
+    for (g = 0 ; g < GROUPS(profile->depth) ; g++, in += QUANTIZER_STATE_WORDS)
+        quantizer_deserialize(&chunk->quantizer[g], in);
+
+    for (s = 0 ; s < 4 ; s++)
+        chunk->noise.amplitude[s] = *in++;
+    chunk->noise.seed = (unsigned int) STATE_INT(in[0], in[1]);
+    in += 2;
+
+    chunk->lost = STATE_INT(in[0], in[1]);
+    in += 2;
+    memcpy(chunk->concealment, in, frameSize * sizeof(short));
+    in += frameSize;
+
+    return (short) (in - words);
 }
@@ -1,18 +1,73 @@
 struct decode_chunk_struct {
-    short t1_subband_1[FLENGTH/2 - 1 + BUFFERSIZE/4];
-    short t2_subband_1[FLENGTH/2 - 1 + BUFFERSIZE/4];
+    /*Temporal sample positions per frame*/
+    short frameSize;
 
-    short t1_subband_2a[FLENGTH/2 - 1 + BUFFERSIZE/8];
-    short t2_subband_2a[FLENGTH/2 - 1 + BUFFERSIZE/8];
-    short t1_subband_2c[FLENGTH/2 - 1 + BUFFERSIZE/8];
-    short t2_subband_2c[FLENGTH/2 - 1 + BUFFERSIZE/8];
+    /*CODEC_* options*/
+    short flags;
 
-    /*Quantisation*/
-    short prediction[4];
-    short Qstep[4];
-    short diff_deq[4][QLENGTH];
-    short diff_deq_index;
+    /*Synthesis filter bank*/
+    const struct qmf_struct *qmf;
 
+    /*Bit allocation of the stream and of a side channel with CODEC_JOINT*/
+    const struct profile_struct *profile;
+    const struct profile_struct *side;
+
+    /*Sliding windows of the sums and differences of the children per tree level,
+      node n of level l at n * (LEVEL_HISTORY >> l): frames are appended behind the
+      FLENGTH/2 - 1 entries of history, which are only mirrored back to the front
+      once the next frame no longer fits*/
+    struct synthesis_level_struct {
+        short t1[LEVEL_HISTORY];
+        short t2[LEVEL_HISTORY];
+        short window;
+
+        /*Lifting steps per node with CODEC_LIFTING*/
+        struct lifting_struct lifting[MAX_SUBBANDS/2];
+    } levels[MAX_DEPTH];
+
+    /*Quantisation, one state per group of four lanes*/
+    struct quantizer_struct quantizer[MAX_GROUPS];
+
+    /*Comfort noise for CODEC_DTX*/
+    struct comfort_noise_struct noise;
+
+    /*Packet loss concealment: the last received frame of subband values and the
+      temporal samples concealed since, up to PLC_FADE*/
+    short concealment[MAX_FRAMESIZE];
+    int lost;
+
+    /*Frames decoded or concealed so far, which places the sync frames*/
+    int frame;
+
+    /*Joint stereo mode of the channel's pair in the last frame with CODEC_JOINT*/
+    short stereo;
 };
 
-void decode(struct decode_chunk_struct * restrict chunk_left, struct decode_chunk_struct * restrict chunk_right, short encoded[BUFFERSIZE], short decoded_0[BUFFERSIZE]);
+/*Largest serialised decoder state in words: a header, the live filter history of every node, the quantisers,
+  the comfort noise and the concealment*/
+#define DECODE_STATE_WORDS (18 + (MAX_SUBBANDS - 1) * (MAX_FLENGTH - 2) + MAX_GROUPS * QUANTIZER_STATE_WORDS + MAX_FRAMESIZE)
+
+void decode_construct(struct decode_chunk_struct *chunk, short frameSize, const struct profile_struct *profile, const struct qmf_struct *qmf, short flags);
+/* Writes the whole state of a channel's decoder, its configuration included, to at most DECODE_STATE_WORDS words
+ * in the version CODEC_STATE_VERSION, so that a live stream can move to a decoder elsewhere. Returns the words written,
+ * or 0 for a profile that is not one of profiles[] and so could not be restored. */
+short decode_serialize(const struct decode_chunk_struct *chunk, short words[]);
+/* Constructs chunk from the length words of a serialised state, after which it decodes as the decoder that wrote it.
+ * Returns the words read, or 0 for a state of another version or configuration this build does not have, which
+ * leaves chunk unchanged. */
+short decode_deserialize(struct decode_chunk_struct *chunk, const short words[], short length);
+/* Decodes one frame of each channel as laid out by encode(); decoded[c] receives frameSize samples of channel c.
+ * A NULL encoded marks a lost frame, which is concealed. Returns the words read. */
+short decode(struct decode_chunk_struct *const chunks[], short channels, short encoded[], short *const decoded[]);
+/* Decodes frames consecutive frames as written by encode_frames() into interleaved pcm. Returns the words read. */
+long decode_frames(struct decode_chunk_struct *const chunks[], short channels, const short encoded[], int frames, short pcm[]);
+/* Words of frames consecutive frames at encoded, without decoding them */
+long decode_length(struct decode_chunk_struct *const chunks[], short channels, const short encoded[], int frames);
+/* Restarts the decoders for random access with CODEC_SYNC: returns the sync frame at or before frame, from which
+ * decoding must continue. Its output matches a decoder that ran from the start after SYNC_PREROLL() temporal samples.
+ * Without CODEC_SYNC this is frame 0. */
+int decode_seek(struct decode_chunk_struct *const chunks[], short channels, int frame);
+/* decode_frames() split at sync frames into up to segments parts decoded at once, each by its own set of decoders:
+ * chunks holds segments sets of channels constructed alike, the first of which is the stream's and holds the state
+ * after the span. The output is that of decode_frames(). Without CODEC_SYNC this is decode_frames(). */
+long decode_segments(struct decode_chunk_struct *const chunks[], short channels, short segments, const short encoded[], int frames, short pcm[]);
@@ -0,0 +1,106 @@
+#include <string.h>
+#include "globals.h"
+#include "codec.h"
+#include "dtx.h"
+
+/* RMS at the geometric centre of the mean square range [2^(i-1), 2^i) of energy index i */
+static const short amplitude[16] = {0, 1, 2, 2, 3, 5, 7, 10, 14, 20, 28, 39, 55, 78, 111, 157};
+
+/* Comfort noise amplitude of a subband at each depth relative to its quarter of
+ * the band, scaled with 2^12: every level halves the amplitude and the band,
+ * so a subband's mean square is 64 / subbands^3 of the quarter's */
+static const short depthGain[MAX_DEPTH + 1] = {0, 11585, 4096, 1448, 512};
+
+/* Bit length of the mean square, so one index step is 3 dB */
+static short _energy_index(long ms)
+{
+    short index = 0;
+
+    while (ms > 0 && index < 15) {
+        ms >>= 1;
+        index++;
+    }
+
+    return index;
+}
+
+short dtx_classify(struct dtx_struct *state, const short values[], short frameSize, short depth, short sync, short *sid)
+{
+    short i, b, e;
+    short samples = frameSize >> depth;
+    long band;
+    long ms[4] = {0, 0, 0, 0};
+
+    // Mean squares of the four quarters of the band, on the scale of two levels
+    for (b = 0 ; b < (1 << depth) ; b++) {
+        band = 0;
+        for (i = 0 ; i < samples ; i++) {
+            e = SUBBAND_INDEX(depth, frameSize, b, i);
+            band += (long) values[e] * values[e];
+        }
+        band /= samples;
+
+        if (depth < 2) {
+            ms[b << 1] = band >> 3;
+            ms[(b << 1) + 1] = band >> 3;
+        } else {
+            ms[b >> (depth - 2)] += band << ((depth - 2) << 1);
+        }
+    }
+
+    if (ms[0] + ms[1] + ms[2] + ms[3] > DTX_THRESHOLD) {
+        state->hangover = DTX_HANGOVER;
+        state->untilSid = 0;
+        return DTX_SPEECH;
+    }
+
+    if (state->hangover > 0) {
+        state->hangover -= frameSize;
+        return DTX_SPEECH;
+    }
+
+    // A descriptor on entering silence, then once per period
+    if (state->untilSid > 0 && !sync) {
+        state->untilSid -= frameSize;
+        return DTX_NODATA;
+    }
+
+    state->untilSid = DTX_SID_PERIOD - frameSize;
+    *sid = (short) ((_energy_index(ms[0]) << 12) | (_energy_index(ms[1]) << 8) | (_energy_index(ms[2]) << 4) | _energy_index(ms[3]));
+    return DTX_SID;
+}
+
+void comfort_noise_construct(struct comfort_noise_struct *state, unsigned int seed)
+{
+    memset(state, 0, sizeof(struct comfort_noise_struct));
+    state->seed = seed;
+}
+
+void comfort_noise_update(struct comfort_noise_struct *state, short sid)
+{
+    short s;
+
+    for (s = 0 ; s < 4 ; s++)
+        state->amplitude[s] = amplitude[((unsigned short) sid >> (12 - (s << 2))) & 15];
+}
+
+void comfort_noise_generate(struct comfort_noise_struct *state, short values[], short frameSize, short depth)
+{
+    short i, b;
+    short block = frameSize / GROUPS(depth);
+    short count = (block >> 2) << 2;
+    short lanes = (depth < 2) ? 1 : 3;
+    int noise;
+
+    for (i = 0 ; i < count * GROUPS(depth) ; i++) {
+        state->seed = state->seed * 1103515245u + 12345u;
+
+        // Subband of the entry, then the quarter of the band its descriptor energy is of
+        b = ((i / block) << 2) + (i % block & lanes);
+        b = (depth < 2) ? b << 1 : b >> (depth - 2);
+
+        // Uniform over [-32768, 32767] has an RMS of 18919, 7/2^17 of which is about 1
+        noise = (int) (short) (state->seed >> 16);
+        values[(i / block) * block + i % block] = (short) ((((noise * state->amplitude[b] * 7) >> 17) * depthGain[depth]) >> 12);
+    }
+}
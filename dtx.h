@@ -0,0 +1,53 @@
+#ifndef __ENC_DTX_H__
+#define __ENC_DTX_H__
+
+/* Discontinuous transmission.
+ *
+ * With CODEC_DTX every frame starts with a header word holding the type of
+ * each channel section in 2 bits, channel c at bits 2c, and the joint stereo
+ * modes above them (see stereo.h); the bits past 16 of more than five joint
+ * channels take a second word, whose bit 0 is header bit 16. A speech section is
+ * coded as usual, a silence descriptor (SID) is one word with the 4-bit
+ * energy index of each subband, and a channel without data has no section.
+ * A frame whose header is zero carries nothing and need not be sent: the
+ * decoder continues its comfort noise. Encoder and decoder reset their
+ * quantiser on every frame that is not speech, so both stay in sync. */
+#define DTX_NODATA 0
+#define DTX_SPEECH 1
+#define DTX_SID 2
+
+#define DTX_TYPE(header, c) (((header) >> ((c) << 1)) & 3)
+/*Words of the header of a frame whose types and stereo modes take bits*/
+#define DTX_HEADER_WORDS(bits) (((bits) + 15) >> 4)
+
+/*Mean square of the four subbands below which a frame is silence, noise of about -53 dBFS*/
+#define DTX_THRESHOLD 512
+/*Temporal samples coded as speech after the last one above the threshold*/
+#define DTX_HANGOVER 800
+/*Temporal samples between silence descriptors*/
+#define DTX_SID_PERIOD 1600
+
+struct dtx_struct {
+    /*Temporal samples left, a zeroed state starts silent with a descriptor*/
+    short hangover;
+    short untilSid;
+};
+
+struct comfort_noise_struct {
+    short amplitude[4];
+    unsigned int seed;
+};
+
+/* Classifies one channel frame of subband values of a tree of depth levels as
+ * laid out by the encoder, writing the descriptor to sid when it returns
+ * DTX_SID. The descriptor holds the energies of the four quarters of the band
+ * whatever the depth. Silent sync frames always carry a descriptor, so a
+ * decoder starting there has one. */
+short dtx_classify(struct dtx_struct *state, const short values[], short frameSize, short depth, short sync, short *sid);
+
+void comfort_noise_construct(struct comfort_noise_struct *state, unsigned int seed);
+void comfort_noise_update(struct comfort_noise_struct *state, short sid);
+/* Fills one channel frame with subband values of the last descriptor's energies */
+void comfort_noise_generate(struct comfort_noise_struct *state, short values[], short frameSize, short depth);
+
+#endif
@@ -1,580 +1,694 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "globals.h"
 #include "codec.h"
+#include "profile.h"
+#include "quantizer.h"
+#include "dtx.h"
+#include "stereo.h"
+#include "filterbank.h"
 #include "encode.h"
+#include "bitstream.h"
+#include "entropy.h"
+#include "workers.h"
 
-#define CONV(signal, index, filter) (signal)[(index)]*(filter)[0] + (signal)[(index)-1]*(filter)[1] + (signal)[(index)-2]*(filter)[2] + (signal)[(index)-3]*(filter)[3] + (signal)[(index)-4]*(filter)[4] + (signal)[(index)-5]*(filter)[5] + (signal)[(index)-6]*(filter)[6] + (signal)[(index)-7]*(filter)[7] + (signal)[(index)-8]*(filter)[8] + (signal)[(index)-9]*(filter)[9];
-#define SUMABS(signal) abs((signal[0])) + abs((signal[1])) + abs((signal[2])) + abs((signal[3])) + abs((signal[4])) + abs((signal[5])) + abs((signal[6])) + abs((signal[7])) + abs((signal[8])) + abs((signal[9]));
+#ifndef MIN
+    #define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
 
-void encode(short buffer[BUFFERSIZE], struct encode_chunk_struct * restrict chunk_left, struct encode_chunk_struct * restrict chunk_right, short encoded[BUFFERSIZE])
+/* Constructs the quantiser of every group of the profile */
+static void _quantizer_restart(struct quantizer_struct quantizer[], const struct profile_struct *profile)
 {
-    short i, j, e;
-    short encoded_tmp[BUFFERSIZE];
+    short g;
 
-    short filter_even[FLENGTH_2] = ANALYSISFILTER_EVEN;
-    short filter_odd[FLENGTH_2] = ANALYSISFILTER_ODD;
-    int t1;
-    int t2;
-
-    div_t temp_div;
-    int temp_sum;
-
-    /**************/
-    /** Analysis **/
-    /**************/
-    // First shift buffers
-    for (i = 0 ; i < FLENGTH_2 - 1 ; i++) {
-        e = BUFFERSIZE_4 + i;
-        chunk_left->even_subband_1[i] = chunk_left->even_subband_1[e];
-        chunk_left->odd_subband_1[i] = chunk_left->odd_subband_1[e];
-
-        chunk_right->even_subband_1[i] = chunk_right->even_subband_1[e];
-        chunk_right->odd_subband_1[i] = chunk_right->odd_subband_1[e];
+    for (g = 0 ; g < GROUPS(profile->depth) ; g++)
+        quantizer_construct(&quantizer[g], profile + g);
+}
 
-        e = BUFFERSIZE_8 + i;
-        chunk_left->even_subband_2a[i] = chunk_left->even_subband_2a[e];
-        chunk_left->odd_subband_2a[i] = chunk_left->odd_subband_2a[e];
+void encode_construct(struct encode_chunk_struct *chunk, short frameSize, const struct profile_struct *profile, const struct qmf_struct *qmf, short flags)
+{
+    memset(chunk, 0, sizeof(struct encode_chunk_struct));
+    chunk->frameSize = frameSize;
+    chunk->flags = flags;
+    chunk->qmf = qmf;
+    chunk->profile = profile;
+    chunk->side = profile_side(profile);
+
+    _quantizer_restart(chunk->quantizer, profile);
+}
 
-        chunk_left->even_subband_2c[i] = chunk_left->even_subband_2c[e];
-        chunk_left->odd_subband_2c[i] = chunk_left->odd_subband_2c[e];
+/* Moves the taps - 1 history pairs of the window at offset to the front */
+static void _mirror_history(short pairs[], short offset, short taps)
+{
+    memmove(pairs, pairs + (offset << 1), ((taps - 1) << 1) * sizeof(short));
+}
 
-        chunk_right->even_subband_2a[i] = chunk_right->even_subband_2a[e];
-        chunk_right->odd_subband_2a[i] = chunk_right->odd_subband_2a[e];
+/* Words in front of the section in a slot: the type of the section with
+ * CODEC_DTX, then the stereo mode of the channel's pair with CODEC_JOINT, then
+ * the words of the section with CODEC_ENTROPY */
+static short _slot_header(const struct encode_chunk_struct *chunk)
+{
+    return ((chunk->flags & CODEC_DTX) ? 1 : 0) + ((chunk->flags & CODEC_JOINT) ? 1 : 0) + ((chunk->flags & CODEC_ENTROPY) ? 1 : 0);
+}
 
-        chunk_right->even_subband_2c[i] = chunk_right->even_subband_2c[e];
-        chunk_right->odd_subband_2c[i] = chunk_right->odd_subband_2c[e];
-    }
+/* Bits in front of the levels of channel c of a frame of channels: the stereo
+ * mode of its pair on the first channel of a pair without CODEC_DTX */
+static short _skip(const struct encode_chunk_struct *chunk, short c, short channels)
+{
+    return ((chunk->flags & (CODEC_JOINT | CODEC_DTX)) == CODEC_JOINT && !(c & 1) && c + 1 < channels) ? 2 : 0;
+}
 
-    i = FLENGTH_2 - 1;
-    chunk_left->even_subband_1[i] = buffer[0];
-    chunk_left->odd_subband_1[i] = chunk_left->odd_1_lastvalue;
-
-    chunk_right->even_subband_1[i] = buffer[1];
-    chunk_right->odd_subband_1[i] = chunk_right->odd_1_lastvalue;
-
-    chunk_left->odd_1_lastvalue = buffer[BUFFERSIZE - 2];
-    chunk_right->odd_1_lastvalue = buffer[BUFFERSIZE - 1];
-
-    // Stage One: loop for i = 0
-    e = FLENGTH_2 - 1;
-    t1 = CONV(chunk_left->even_subband_1, e, filter_even);
-    t2 = CONV(chunk_left->odd_subband_1, e, filter_odd);
-    chunk_left->odd_subband_2a[e] = chunk_left->odd_2a_lastvalue;
-    chunk_left->odd_subband_2c[e] = chunk_left->odd_2c_lastvalue;
-    chunk_left->even_subband_2a[e] = (t1 + t2) >> 16;
-    chunk_left->even_subband_2c[e] = (t2 - t1) >> 16;
-
-    t1 = CONV(chunk_right->even_subband_1, e, filter_even);
-    t2 = CONV(chunk_right->odd_subband_1, e, filter_odd);
-    chunk_right->even_subband_2a[e] = (t1 + t2) >> 16;
-    chunk_right->even_subband_2c[e] = (t2 - t1) >> 16;
-    chunk_right->odd_subband_2a[e] = chunk_right->odd_2a_lastvalue;
-    chunk_right->odd_subband_2c[e] = chunk_right->odd_2c_lastvalue;
-
-    for (i = 1 ; i < BUFFERSIZE_4 ; i+=2) {
-        e = i << 2;
-        j = i + FLENGTH_2 - 1;
-        chunk_left->even_subband_1[j] = buffer[e];
-        chunk_left->odd_subband_1[j] = buffer[e - 2];
-
-        chunk_right->even_subband_1[j] = buffer[e + 1];
-        chunk_right->odd_subband_1[j] = buffer[e - 1];
-
-        e = (i + 1) << 2;
-        j += 1;
-        chunk_left->even_subband_1[j] = buffer[e];
-        chunk_left->odd_subband_1[j] = buffer[e - 2];
-
-        chunk_right->even_subband_1[j] = buffer[e + 1];
-        chunk_right->odd_subband_1[j] = buffer[e - 1];
-
-        // Stage One
-        e = (i >> 1) + FLENGTH_2;
-        j -= 1;
-        t1 = CONV(chunk_left->even_subband_1, j, filter_even);
-        t2 = CONV(chunk_left->odd_subband_1, j, filter_odd);
-
-        chunk_left->odd_subband_2a[e] = (t1 + t2) >> 16;
-        chunk_left->odd_subband_2c[e] = (t2 - t1) >> 16;
-
-        t1 = CONV(chunk_right->even_subband_1, j, filter_even);
-        t2 = CONV(chunk_right->odd_subband_1, j, filter_odd);
-
-        chunk_right->odd_subband_2a[e] = (t1 + t2) >> 16;
-        chunk_right->odd_subband_2c[e] = (t2 - t1) >> 16;
-
-        if (i + 1 < BUFFERSIZE_4) {
-            j += 1;
-            t1 = CONV(chunk_left->even_subband_1, j, filter_even);
-            t2 = CONV(chunk_left->odd_subband_1, j, filter_odd);
-
-            chunk_left->even_subband_2a[e] = (t1 + t2) >> 16;
-            chunk_left->even_subband_2c[e] = (t2 - t1) >> 16;
-
-            t1 = CONV(chunk_right->even_subband_1, j, filter_even);
-            t2 = CONV(chunk_right->odd_subband_1, j, filter_odd);
-
-            chunk_right->even_subband_2a[e] = (t1 + t2) >> 16;
-            chunk_right->even_subband_2c[e] = (t2 - t1) >> 16;
-        }
+/* Words reserved for one channel: entropy coded, DTX, joint stereo and sync
+ * sections are written to worst case slots in parallel and compacted afterwards.
+ * A side channel's profile is never larger than the stream's. */
+static short _slot_size(const struct encode_chunk_struct *chunk)
+{
+    short size;
+    short skip = _skip(chunk, 0, 2);
 
-        // Stage Two
-        j = (i - 1) << 2;
-        e = e - 1;
-        t1 = CONV(chunk_left->even_subband_2a, e, filter_even);
-        t2 = CONV(chunk_left->odd_subband_2a, e, filter_odd);
+    if (chunk->flags & CODEC_ENTROPY)
+        size = entropy_size(chunk->profile, chunk->frameSize, skip);
+    else
+        size = bitstream_size(chunk->profile, chunk->frameSize, skip);
 
-        encoded_tmp[j] = (t1 + t2) >> 16;
-        encoded_tmp[j+1] = (t2 - t1) >> 16;
+    if (chunk->flags & CODEC_SYNC)
+        size += SYNC_WORDS * GROUPS(chunk->profile->depth);
 
-        t1 = CONV(chunk_left->even_subband_2c, e, filter_even);
-        t2 = CONV(chunk_left->odd_subband_2c, e, filter_odd);
+    return size + _slot_header(chunk);
+}
 
-        encoded_tmp[j+2] = (t1 + t2) >> 16;
-        encoded_tmp[j+3] = (t2 - t1) >> 16;
+/* Profile of channel c in a frame of the given stereo mode */
+static const struct profile_struct *_profile(const struct encode_chunk_struct *chunk, short c, short mode)
+{
+    return ((c & 1) && mode == STEREO_MS) ? chunk->side : chunk->profile;
+}
 
-        t1 = CONV(chunk_right->even_subband_2a, e, filter_even);
-        t2 = CONV(chunk_right->odd_subband_2a, e, filter_odd);
+/* Words of the section of the given type in slot, whose levels start skip bits in */
+static short _section_length(const struct encode_chunk_struct *chunk, const struct profile_struct *profile, const short *slot, short type, short sync, short skip)
+{
+    short snapshot = sync ? SYNC_WORDS * GROUPS(profile->depth) : 0;
 
-        encoded_tmp[j+4] = (t1 + t2) >> 16;
-        encoded_tmp[j+5] = (t2 - t1) >> 16;
+    if (type == DTX_NODATA)
+        return 0;
+    if (type == DTX_SID)
+        return 1;
+    if (chunk->flags & CODEC_ENTROPY)
+        return snapshot + slot[_slot_header(chunk) - 1];
 
-        t1 = CONV(chunk_right->even_subband_2c, e, filter_even);
-        t2 = CONV(chunk_right->odd_subband_2c, e, filter_odd);
+    return snapshot + bitstream_size(profile, chunk->frameSize, skip);
+}
 
-        encoded_tmp[j+6] = (t1 + t2) >> 16;
-        encoded_tmp[j+7] = (t2 - t1) >> 16;
+/* Moves the sections of frames out of their slots so they follow each other,
+ * each frame behind its header with CODEC_DTX, which holds the stereo modes
+ * with CODEC_JOINT. start is the number of the first frame. Returns the words they take. */
+static long _compact_frames(short encoded[], struct encode_chunk_struct *const chunks[], short channels, int start, int frames)
+{
+    short dtx = (chunks[0]->flags & CODEC_DTX) ? 1 : 0;
+    short joint = (chunks[0]->flags & CODEC_JOINT) ? 1 : 0;
+    short size = _slot_size(chunks[0]);
+    short types[MAX_CHANNELS];
+    short modes[MAX_CHANNELS];
+    short offset = _slot_header(chunks[0]);
+    short bits = (channels << 1) + (joint ? STEREO_BITS(channels) : 0);
+    short c, length, sync;
+    const short *slots;
+    unsigned int header;
+    int frame;
+    long words = 0;
+
+    if (!(chunks[0]->flags & (CODEC_ENTROPY | CODEC_DTX | CODEC_SYNC | CODEC_JOINT)))
+        return (long) frames * channels * size;
+
+    for (frame = 0 ; frame < frames ; frame++) {
+        slots = encoded + (long) frame * channels * size;
+        sync = SYNC_FRAME(chunks[0]->flags, chunks[0]->frameSize, start + frame);
+
+        // The header may take the place of the first type and mode
+        header = 0;
+        for (c = 0 ; c < channels ; c++) {
+            modes[c] = joint ? slots[c * size + dtx] : STEREO_LR;
+            types[c] = dtx ? slots[c * size] : DTX_SPEECH;
+            if ((c & 1) && modes[c] == STEREO_MID)
+                types[c] = DTX_NODATA;
+
+            header |= (unsigned int) types[c] << (c << 1);
+            if ((c & 1) && joint)
+                header |= (unsigned int) modes[c] << ((channels << 1) + (c & ~1));
+        }
+
+        if (dtx) {
+            encoded[words++] = (short) header;
+            if (DTX_HEADER_WORDS(bits) > 1)
+                encoded[words++] = (short) (header >> 16);
+        }
+
+        for (c = 0 ; c < channels ; c++) {
+            length = _section_length(chunks[c], _profile(chunks[c], c, modes[c]), slots + c * size, types[c], sync, _skip(chunks[c], c, channels));
+            memmove(encoded + words, slots + c * size + offset, length * sizeof(short));
+            words += length;
+        }
     }
 
-    e = ((BUFFERSIZE_4 - 1) >> 1) + FLENGTH_2;
-    chunk_left->odd_2a_lastvalue = chunk_left->odd_subband_2a[e];
-    chunk_left->odd_2c_lastvalue = chunk_left->odd_subband_2c[e];
-    chunk_right->odd_2a_lastvalue = chunk_right->odd_subband_2a[e];
-    chunk_right->odd_2c_lastvalue = chunk_right->odd_subband_2c[e];
-
-    for (i = 0 ; i < BUFFERSIZE_8 ; i++) {
-        chunk_left->diff_deq_index++;
-        e = i << 3;
-        // for roundDiv precalculation
-        temp_div = div(encoded_tmp[e] - chunk_left->prediction[0], chunk_left->Qstep[0]);
+    return words;
+}
 
-        if (chunk_left->diff_deq_index >= QLENGTH) {
-            chunk_left->diff_deq_index = 0;
-        }
+/* Channels are coded in pairs, so the quantiser advances both in one step */
+struct encode_job {
+    short *const *pcm;
+    struct encode_chunk_struct *const *chunks;
+    short channels;
+    short *encoded;
+};
+
+struct encode_frames_job {
+    const short *pcm;
+    struct encode_chunk_struct *const *chunks;
+    short channels;
+    int frames;
+    short *encoded;
+};
+
+/* Segments of a span, each with its own encoders, start at sync frames */
+struct encode_segments_job {
+    const short *pcm;
+    struct encode_chunk_struct *const *chunks;
+    short channels;
+    short segments;
+    short *encoded;
+    int start;
+    int frames;
+    int bounds[MAX_SEGMENTS + 1];
+    long words[MAX_SEGMENTS];
+};
+
+static inline short _saturate(int value)
+{
+    return (short) (value > 32767 ? 32767 : (value < -32768 ? -32768 : value));
+}
 
-        /*****************************/
-        /** Encoding Subband 1 Left **/
-        /*****************************/
-        // roundDiv
-        if((temp_div.rem << 1) > chunk_left->Qstep[0] && temp_div.quot > 0) {
-            encoded_tmp[e] = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > chunk_left->Qstep[0] && temp_div.quot < 0) {
-            encoded_tmp[e] = temp_div.quot - 1;
-        } else {
-            encoded_tmp[e] = temp_div.quot;
-        }
+/* _encode_analysis() with the lifting filter bank of CODEC_LIFTING, whose
+ * subbands come onto QMF scale only at the leaves */
+static void _encode_analysis_lifting(const short *restrict pcm, struct encode_chunk_struct *restrict chunk, short *restrict values)
+{
+    short i, l, n, b, shift;
+    short depth = chunk->profile->depth;
+    short samples;
+    int bands[2][MAX_FRAMESIZE];
+    int frame[MAX_FRAMESIZE];
+    const int *input = frame;
+    int *output;
 
-        if (encoded_tmp[e] > MAX_LEVEL_1) {
-            encoded_tmp[e] = MAX_LEVEL_1;
-        } else if (encoded_tmp[e] < MIN_LEVEL_1) {
-            encoded_tmp[e] = MIN_LEVEL_1;
-        }
-        chunk_left->diff_deq[0][chunk_left->diff_deq_index] = (short) (encoded_tmp[e] * chunk_left->Qstep[0]);
+    for (i = 0 ; i < chunk->frameSize ; i++)
+        frame[i] = pcm[i];
 
-        // meanAbs
-        temp_sum = SUMABS(chunk_left->diff_deq[0]);
+    for (l = 0 ; l < depth ; l++) {
+        samples = chunk->frameSize >> l;
+        output = bands[l & 1];
 
-        temp_div = div(temp_sum, QLENGTH);
+        for (n = 0 ; n < (1 << l) ; n++, input += samples)
+            lifting_analysis(&chunk->levels[l].lifting[n], input, samples >> 1, output + n * samples, output + n * samples + (samples >> 1));
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            temp_sum = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            temp_sum = temp_div.quot - 1;
-        } else {
-            temp_sum = temp_div.quot;
-        }
-        chunk_left->Qstep[0] = (short)((temp_sum * PHI_1) >> 13);
+        input = output;
+    }
 
-        // Precalculation subband 2 left
-        e += 1;
-        // roundDiv
-        temp_div = div(encoded_tmp[e] - chunk_left->prediction[1], chunk_left->Qstep[1]);
+    samples = chunk->frameSize >> depth;
+    for (b = 0 ; b < (1 << depth) ; b++) {
+        shift = lifting_shift(depth, b);
+        for (i = 0 ; i < samples ; i++)
+            values[SUBBAND_INDEX(depth, chunk->frameSize, b, i)] = _saturate((input[b * samples + i] + (1 << (shift - 1))) >> shift);
+    }
+}
 
-        chunk_left->prediction[0] = (short)((MU_1*(chunk_left->diff_deq[0][chunk_left->diff_deq_index] + chunk_left->prediction[0])) >> 15);
+/* Splits one channel frame into the 2^depth subbands of its tree, level by
+ * level, and lays them out in groups as in codec.h */
+static void _encode_analysis(const short *restrict pcm, struct encode_chunk_struct *restrict chunk, short *restrict values)
+{
+    short i, j, e, l, n, b;
+    short depth = chunk->profile->depth;
 
-        if (chunk_left->Qstep[0] < QMIN) {
-            chunk_left->Qstep[0] = QMIN;
-        } else if (chunk_left->Qstep[0] > QMAX_1) {
-            chunk_left->Qstep[0] = QMAX_1;
-        }
+    /*Taps per polyphase branch*/
+    short taps = chunk->qmf->length >> 1;
 
-        /*****************************/
-        /** Encoding Subband 2 Left **/
-        /*****************************/
-        if((temp_div.rem << 1) > chunk_left->Qstep[1] && temp_div.quot > 0) {
-            encoded_tmp[e] = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > chunk_left->Qstep[1] && temp_div.quot < 0) {
-            encoded_tmp[e] = temp_div.quot - 1;
-        } else {
-            encoded_tmp[e] = temp_div.quot;
-        }
+    /*Input samples per node of the level and its history per node*/
+    short samples;
+    short stride;
 
-        if (encoded_tmp[e] > MAX_LEVEL_2) {
-            encoded_tmp[e] = MAX_LEVEL_2;
-        } else if (encoded_tmp[e] < MIN_LEVEL_2) {
-            encoded_tmp[e] = MIN_LEVEL_2;
-        }
+    /*Outputs of every level, node n of level l at n * (frameSize >> l)*/
+    short bands[2][MAX_FRAMESIZE];
+    const short *input = pcm;
+    short *output;
 
-        chunk_left->diff_deq[1][chunk_left->diff_deq_index] = (short) (encoded_tmp[e] * chunk_left->Qstep[1]);
+    /*Current window into a node's history*/
+    short *history;
+    struct analysis_level_struct *level;
 
-        // meanAbs
-        temp_sum = SUMABS(chunk_left->diff_deq[1]);
+    if (chunk->flags & CODEC_LIFTING) {
+        _encode_analysis_lifting(pcm, chunk, values);
+        return;
+    }
 
-        temp_div = div(temp_sum, QLENGTH);
+    /**************/
+    /** Analysis **/
+    /**************/
+    for (l = 0 ; l < depth ; l++) {
+        level = &chunk->levels[l];
+        samples = chunk->frameSize >> l;
+        stride = LEVEL_HISTORY >> l;
+        output = bands[l & 1];
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            temp_sum = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            temp_sum = temp_div.quot - 1;
-        } else {
-            temp_sum = temp_div.quot;
+        // Mirror the history to the front once the next frame does not fit behind it
+        if (level->window + taps - 1 + (samples >> 1) > stride) {
+            for (n = 0 ; n < (1 << l) ; n++)
+                _mirror_history(level->pairs + ((n * stride) << 1), level->window, taps);
+            level->window = 0;
         }
-        chunk_left->Qstep[1] = (short)((temp_sum * PHI_2) >> 13);
 
-        // Precalculation Subband 3 left
-        e += 1;
-        // roundDiv
-        temp_div = div(encoded_tmp[e] - chunk_left->prediction[2], chunk_left->Qstep[2]);
+        for (n = 0 ; n < (1 << l) ; n++, input += samples) {
+            history = level->pairs + ((n * stride + level->window) << 1);
 
-        chunk_left->prediction[1] = (short)((MU_2*(chunk_left->diff_deq[1][chunk_left->diff_deq_index] + chunk_left->prediction[1])) >> 15);
+            // Polyphase split of the node into (even, odd) pairs
+            j = (taps - 1) << 1;
+            history[j] = input[0];
+            history[j + 1] = level->odd_lastvalue[n];
 
-        if (chunk_left->Qstep[1] < QMIN) {
-            chunk_left->Qstep[1] = QMIN;
-        } else if (chunk_left->Qstep[1] > QMAX_2) {
-            chunk_left->Qstep[1] = QMAX_2;
-        }
+            for (i = 1 ; i < (samples >> 1) ; i++) {
+                e = i << 1;
+                j = (i + taps - 1) << 1;
+                history[j] = input[e];
+                history[j + 1] = input[e - 1];
+            }
 
-        /*****************************/
-        /** Encoding Subband 3 Left **/
-        /*****************************/
-        if((temp_div.rem << 1) > chunk_left->Qstep[2] && temp_div.quot > 0) {
-            encoded_tmp[e] = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > chunk_left->Qstep[2] && temp_div.quot < 0) {
-            encoded_tmp[e] = temp_div.quot - 1;
-        } else {
-            encoded_tmp[e] = temp_div.quot;
-        }
+            level->odd_lastvalue[n] = input[samples - 1];
 
-        if (encoded_tmp[e] > MAX_LEVEL_3) {
-            encoded_tmp[e] = MAX_LEVEL_3;
-        } else if (encoded_tmp[e] < MIN_LEVEL_3) {
-            encoded_tmp[e] = MIN_LEVEL_3;
+            // Children 2n and 2n + 1 of the next level
+            chunk->qmf->analysis(history, samples >> 1, output + n * samples, output + n * samples + (samples >> 1));
         }
 
-        chunk_left->diff_deq[2][chunk_left->diff_deq_index] = (short) (encoded_tmp[e] * chunk_left->Qstep[2]);
-
-        // meanAbs
-        temp_sum = SUMABS(chunk_left->diff_deq[2]);
-
-        temp_div = div(temp_sum, QLENGTH);
+        level->window += samples >> 1;
+        input = output;
+    }
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            temp_sum = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            temp_sum = temp_div.quot - 1;
-        } else {
-            temp_sum = temp_div.quot;
-        }
-        chunk_left->Qstep[2] = (short)((temp_sum * PHI_3) >> 13);
+    samples = chunk->frameSize >> depth;
+    for (b = 0 ; b < (1 << depth) ; b++) {
+        for (i = 0 ; i < samples ; i++)
+            values[SUBBAND_INDEX(depth, chunk->frameSize, b, i)] = input[b * samples + i];
+    }
+}
 
-        // Precalculation Subband 4 Left
-        e += 1;
-        // roundDiv
-        temp_div = div(encoded_tmp[e] - chunk_left->prediction[3], chunk_left->Qstep[3]);
+/* Codes one frame of up to two channels into their slots */
+static void _encode_pair(short *const pcm[], struct encode_chunk_struct *const chunks[], short channels, short *const slots[])
+{
+    short c, g, k, skip;
+    short dtx = (chunks[0]->flags & CODEC_DTX) ? 1 : 0;
+    short joint = (chunks[0]->flags & CODEC_JOINT) ? 1 : 0;
+    short offset = _slot_header(chunks[0]);
+    short sync = SYNC_FRAME(chunks[0]->flags, chunks[0]->frameSize, chunks[0]->frame);
+    short depth = chunks[0]->profile->depth;
+    short groups = GROUPS(depth);
+    short block = chunks[0]->frameSize / groups;
+    short mode = STEREO_LR;
+    short speech = 0;
+    short speaking[2];
+    short types[2] = {DTX_SPEECH, DTX_SPEECH};
+    short values[2][MAX_FRAMESIZE];
+    short *levels[2] = {NULL, NULL};
+    short *section;
+    const struct profile_struct *profile;
+    struct quantizer_struct *states[2] = {NULL, NULL};
+
+    for (c = 0 ; c < channels ; c++)
+        _encode_analysis(pcm[c], chunks[c], values[c]);
 
-        chunk_left->prediction[2] = (short)((MU_3*(chunk_left->diff_deq[2][chunk_left->diff_deq_index] + chunk_left->prediction[2])) >> 15);
+    /******************/
+    /** Joint Stereo **/
+    /******************/
+    if (joint && channels == 2) {
+        mode = stereo_classify(values[0], values[1], chunks[0]->frameSize);
+        if (mode != STEREO_LR)
+            stereo_forward(values[0], values[1], chunks[0]->frameSize);
+
+        // A channel whose signal changes with the mode restarts its quantiser on both ends
+        if ((mode == STEREO_LR) != (chunks[0]->stereo == STEREO_LR))
+            _quantizer_restart(chunks[0]->quantizer, chunks[0]->profile);
+        if (mode != chunks[1]->stereo)
+            _quantizer_restart(chunks[1]->quantizer, _profile(chunks[1], 1, mode));
+
+        chunks[0]->stereo = mode;
+        chunks[1]->stereo = mode;
+    }
 
-        if (chunk_left->Qstep[2] < QMIN) {
-            chunk_left->Qstep[2] = QMIN;
-        } else if (chunk_left->Qstep[2] > QMAX_3) {
-            chunk_left->Qstep[2] = QMAX_3;
-        }
+    for (c = 0 ; c < channels ; c++) {
+        profile = _profile(chunks[c], c, mode);
 
-        /*****************************/
-        /** Encoding Subband 4 Left **/
-        /*****************************/
+        /*********************/
+        /** Voice Detection **/
+        /*********************/
+        if (c == 1 && mode == STEREO_MID)
+            types[c] = DTX_NODATA;
+        else if (dtx)
+            types[c] = dtx_classify(&chunks[c]->dtx, values[c], chunks[c]->frameSize, depth, sync, slots[c] + offset);
 
-        if((temp_div.rem << 1) > chunk_left->Qstep[3] && temp_div.quot > 0) {
-            encoded_tmp[e] = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > chunk_left->Qstep[3] && temp_div.quot < 0) {
-            encoded_tmp[e] = temp_div.quot - 1;
+        // Silence restarts the quantiser on both ends
+        if (types[c] == DTX_SPEECH) {
+            speaking[speech++] = c;
         } else {
-            encoded_tmp[e] = temp_div.quot;
-        }
-
-        if (encoded_tmp[e] > MAX_LEVEL_4) {
-            encoded_tmp[e] = MAX_LEVEL_4;
-        } else if (encoded_tmp[e] < MIN_LEVEL_4) {
-            encoded_tmp[e] = MIN_LEVEL_4;
+            _quantizer_restart(chunks[c]->quantizer, profile);
         }
 
-        chunk_left->diff_deq[3][chunk_left->diff_deq_index] = (short) (encoded_tmp[e] * chunk_left->Qstep[3]);
-        // meanAbs
-        temp_sum = SUMABS(chunk_left->diff_deq[3]);
-
-        temp_div = div(temp_sum, QLENGTH);
-
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            temp_sum = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            temp_sum = temp_div.quot - 1;
-        } else {
-            temp_sum = temp_div.quot;
+        /*****************/
+        /** Sync Points **/
+        /*****************/
+        if (sync && types[c] == DTX_SPEECH) {
+            for (g = 0 ; g < groups ; g++)
+                quantizer_export(&chunks[c]->quantizer[g], slots[c] + offset + g * SYNC_WORDS);
         }
-        chunk_left->Qstep[3] = (short)((temp_sum * PHI_4) >> 13);
-
-        // Precalculations Subband 1 Right
-        e += 1;
-        // roundDiv
-        temp_div = div(encoded_tmp[e] - chunk_right->prediction[0], chunk_right->Qstep[0]);
-
-        chunk_left->prediction[3] = (short)((MU_4*(chunk_left->diff_deq[3][chunk_left->diff_deq_index] + chunk_left->prediction[3])) >> 15);
 
-        if (chunk_left->Qstep[3] < QMIN) {
-            chunk_left->Qstep[3] = QMIN;
-        } else if (chunk_left->Qstep[3] > QMAX_4) {
-            chunk_left->Qstep[3] = QMAX_4;
-        }
-
-        /******************************/
-        /** Encoding Subband 1 Right **/
-        /******************************/
-
-        if((temp_div.rem << 1) > chunk_right->Qstep[0] && temp_div.quot > 0) {
-            encoded_tmp[e] = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > chunk_right->Qstep[0] && temp_div.quot < 0) {
-            encoded_tmp[e] = temp_div.quot - 1;
-        } else {
-            encoded_tmp[e] = temp_div.quot;
-        }
+        chunks[c]->frame++;
+    }
 
-        if (encoded_tmp[e] > MAX_LEVEL_1) {
-            encoded_tmp[e] = MAX_LEVEL_1;
-        } else if (encoded_tmp[e] < MIN_LEVEL_1) {
-            encoded_tmp[e] = MIN_LEVEL_1;
+    /******************/
+    /** Quantisation **/
+    /******************/
+    for (g = 0 ; g < groups ; g++) {
+        for (k = 0 ; k < speech ; k++) {
+            states[k] = &chunks[speaking[k]]->quantizer[g];
+            levels[k] = values[speaking[k]] + g * block;
         }
 
-        chunk_right->diff_deq[0][chunk_left->diff_deq_index] = (short) (encoded_tmp[e] * chunk_right->Qstep[0]);
-
-        // meanAbs
-        temp_sum = SUMABS(chunk_right->diff_deq[0]);
-
-        temp_div = div(temp_sum, QLENGTH);
-
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            temp_sum = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            temp_sum = temp_div.quot - 1;
-        } else {
-            temp_sum = temp_div.quot;
-        }
-        chunk_right->Qstep[0] = (short)((temp_sum * PHI_1) >> 13);
+        quantizer_encode(states, levels, speech, block >> 2);
+    }
 
-        // Precalculation Subband 2 Right
-        e += 1;
-        // roundDiv
-        temp_div = div(encoded_tmp[e] - chunk_right->prediction[1], chunk_right->Qstep[1]);
+    /******************/
+    /** Bit Grouping **/
+    /******************/
+    for (c = 0 ; c < channels ; c++) {
+        if (dtx)
+            slots[c][0] = types[c];
+        if (joint)
+            slots[c][dtx] = mode;
+        if (types[c] != DTX_SPEECH)
+            continue;
+
+        profile = _profile(chunks[c], c, mode);
+        section = slots[c] + offset + (sync ? SYNC_WORDS * groups : 0);
+        skip = _skip(chunks[c], c, channels);
+        if (skip > 0)
+            section[0] = (short) (mode << 14);
+
+        if (chunks[c]->flags & CODEC_ENTROPY)
+            slots[c][offset - 1] = entropy_pack(profile, section, values[c], chunks[c]->frameSize, skip);
+        else
+            bitstream_pack(profile, section, values[c], chunks[c]->frameSize, skip);
+    }
+}
 
-        chunk_right->prediction[0] = (short)((MU_1*(chunk_right->diff_deq[0][chunk_left->diff_deq_index] + chunk_right->prediction[0])) >> 15);
+static void _encode_task(void *arg, short pair)
+{
+    struct encode_job *job = arg;
+    short first = pair << 1;
+    short size = _slot_size(job->chunks[first]);
+    short *encoded[2] = {job->encoded + first * size, job->encoded + (first + 1) * size};
 
-        if (chunk_right->Qstep[0] < QMIN) {
-            chunk_right->Qstep[0] = QMIN;
-        } else if (chunk_right->Qstep[0] > QMAX_1) {
-            chunk_right->Qstep[0] = QMAX_1;
-        }
+    _encode_pair(job->pcm + first, job->chunks + first, MIN(2, job->channels - first), encoded);
+}
 
-        /******************************/
-        /** Encoding Subband 2 Right **/
-        /******************************/
+/* One channel pair over all frames of the span, so its state stays in cache */
+static void _encode_frames_task(void *arg, short pair)
+{
+    struct encode_frames_job *job = arg;
+    short first = pair << 1;
+    short channels = MIN(2, job->channels - first);
+    short frameSize = job->chunks[first]->frameSize;
+    short size = _slot_size(job->chunks[first]);
+    short buffer[2][MAX_FRAMESIZE];
+    short *pcm[2] = {buffer[0], buffer[1]};
+    short *encoded[2];
+    const short *input = job->pcm + first;
+    short i, c;
+    int frame;
+
+    for (frame = 0 ; frame < job->frames ; frame++) {
+        for (i = 0 ; i < frameSize ; i++) {
+            for (c = 0 ; c < channels ; c++)
+                buffer[c][i] = input[c];
+            input += job->channels;
+        }
+
+        encoded[0] = job->encoded + ((long) frame * job->channels + first) * size;
+        encoded[1] = encoded[0] + size;
+        _encode_pair(pcm, job->chunks + first, channels, encoded);
+    }
+}
 
-        if((temp_div.rem << 1) > chunk_right->Qstep[1] && temp_div.quot > 0) {
-            encoded_tmp[e] = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > chunk_right->Qstep[1] && temp_div.quot < 0) {
-            encoded_tmp[e] = temp_div.quot - 1;
-        } else {
-            encoded_tmp[e] = temp_div.quot;
-        }
+/* encode_frames() on the calling thread */
+static long _encode_span(const short pcm[], int frames, struct encode_chunk_struct *const chunks[], short channels, short encoded[])
+{
+    short i;
+    short pairs = (channels + 1) >> 1;
+    struct encode_frames_job job = {pcm, chunks, channels, frames, encoded};
+    int start = chunks[0]->frame;
 
-        if (encoded_tmp[e] > MAX_LEVEL_2) {
-            encoded_tmp[e] = MAX_LEVEL_2;
-        } else if (encoded_tmp[e] < MIN_LEVEL_2) {
-            encoded_tmp[e] = MIN_LEVEL_2;
-        }
+    for (i = 0 ; i < pairs ; i++) {
+        _encode_frames_task(&job, i);
+    }
 
-        chunk_right->diff_deq[1][chunk_left->diff_deq_index] = (short) (encoded_tmp[e] * chunk_right->Qstep[1]);
+    return _compact_frames(encoded, chunks, channels, start, frames);
+}
 
-        // meanAbs
-        temp_sum = SUMABS(chunk_right->diff_deq[1]);
+/* A segment after the first restarts at its sync frame, warmed up on the pcm
+ * before it. Its words are left at the place of its pcm for the stitching. */
+static void _encode_segment_task(void *arg, short segment)
+{
+    struct encode_segments_job *job = arg;
+    struct encode_chunk_struct *const *chunks = job->chunks + segment * job->channels;
+    short frameSize = chunks[0]->frameSize;
+    short scratch[MAX_CHANNELS * MAX_FRAMESIZE];
+    int first = job->bounds[segment];
+    int last = job->bounds[segment + 1];
+    int warmup = MIN((SYNC_WARMUP + frameSize - 1) / frameSize, first);
+    long offset = (long) first * frameSize * job->channels;
+    short c;
+    int frame;
+
+    job->words[segment] = 0;
+    if (first == last)
+        return;
+
+    if (segment > 0) {
+        for (c = 0 ; c < job->channels ; c++) {
+            encode_construct(chunks[c], frameSize, chunks[c]->profile, chunks[c]->qmf, chunks[c]->flags);
+            chunks[c]->frame = job->start + first - warmup;
+        }
+
+        for (frame = first - warmup ; frame < first ; frame++)
+            _encode_span(job->pcm + (long) frame * frameSize * job->channels, 1, chunks, job->channels, scratch);
+    }
 
-        temp_div = div(temp_sum, QLENGTH);
+    job->words[segment] = _encode_span(job->pcm + offset, last - first, chunks, job->channels, job->encoded + offset);
+}
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            temp_sum = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            temp_sum = temp_div.quot - 1;
-        } else {
-            temp_sum = temp_div.quot;
-        }
-        chunk_right->Qstep[1] = (short)((temp_sum * PHI_2) >> 13);
+long encode_segments(const short pcm[], int frames, struct encode_chunk_struct *const chunks[], short channels, short segments, short encoded[])
+{
+    short k, c;
+    int period = SYNC_PERIOD / chunks[0]->frameSize;
+    int bound;
+    long words = 0;
+    struct encode_segments_job job;
+
+    if (!(chunks[0]->flags & CODEC_SYNC) || segments < 2)
+        return encode_frames(pcm, frames, chunks, channels, encoded);
+
+    job.pcm = pcm;
+    job.chunks = chunks;
+    job.channels = channels;
+    job.segments = MIN(segments, MAX_SEGMENTS);
+    job.encoded = encoded;
+    job.start = chunks[0]->frame;
+    job.frames = frames;
+
+    // Even splits, moved up to the next sync frame; none but the first may start at the span
+    job.bounds[0] = 0;
+    for (k = 1 ; k < job.segments ; k++) {
+        bound = job.start + (int) ((long) frames * k / job.segments);
+        if (bound == job.start)
+            bound++;
+        bound = (bound + period - 1) / period * period - job.start;
+
+        if (bound < job.bounds[k - 1])
+            bound = job.bounds[k - 1];
+        job.bounds[k] = MIN(bound, frames);
+    }
+    job.bounds[job.segments] = frames;
 
-        // Precalculation Subband 3 Right
-        e += 1;
-        // roundDiv
-        temp_div = div(encoded_tmp[e] - chunk_right->prediction[2], chunk_right->Qstep[2]);
+    workers_run(_encode_segment_task, &job, job.segments);
 
-        chunk_right->prediction[1] = (short)((MU_2*(chunk_right->diff_deq[1][chunk_left->diff_deq_index] + chunk_right->prediction[1])) >> 15);
+    // Stitch: every segment's words fit within its pcm, so moving them down in order overwrites nothing unread
+    for (k = 0 ; k < job.segments ; k++) {
+        memmove(encoded + words, encoded + (long) job.bounds[k] * chunks[0]->frameSize * channels, job.words[k] * sizeof(short));
+        words += job.words[k];
+    }
 
-        if (chunk_right->Qstep[1] < QMIN) {
-            chunk_right->Qstep[1] = QMIN;
-        } else if (chunk_right->Qstep[1] > QMAX_2) {
-            chunk_right->Qstep[1] = QMAX_2;
-        }
+    // The encoders of the last segment that ran hold the state after the span
+    for (k = job.segments - 1 ; k > 0 && job.bounds[k] == frames ; k--) {}
+    if (k > 0) {
+        for (c = 0 ; c < channels ; c++)
+            *chunks[c] = *chunks[k * channels + c];
+    }
 
-        /******************************/
-        /** Encoding Subband 3 Right **/
-        /******************************/
+    return words;
+}
 
-        if((temp_div.rem << 1) > chunk_right->Qstep[2] && temp_div.quot > 0) {
-            encoded_tmp[e] = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > chunk_right->Qstep[2] && temp_div.quot < 0) {
-            encoded_tmp[e] = temp_div.quot - 1;
-        } else {
-            encoded_tmp[e] = temp_div.quot;
-        }
+long encode_frames(const short pcm[], int frames, struct encode_chunk_struct *const chunks[], short channels, short encoded[])
+{
+    short i;
+    short pairs = (channels + 1) >> 1;
+    struct encode_frames_job job = {pcm, chunks, channels, frames, encoded};
+    int start = chunks[0]->frame;
 
-        if (encoded_tmp[e] > MAX_LEVEL_3) {
-            encoded_tmp[e] = MAX_LEVEL_3;
-        } else if (encoded_tmp[e] < MIN_LEVEL_3) {
-            encoded_tmp[e] = MIN_LEVEL_3;
+    if ((long) frames * chunks[0]->frameSize < PARALLEL_FRAMESIZE) {
+        for (i = 0 ; i < pairs ; i++) {
+            _encode_frames_task(&job, i);
         }
+    } else {
+        workers_run(_encode_frames_task, &job, pairs);
+    }
 
-        chunk_right->diff_deq[2][chunk_left->diff_deq_index] = (short) (encoded_tmp[e] * chunk_right->Qstep[2]);
-
-        // meanAbs
-        temp_sum = SUMABS(chunk_right->diff_deq[2]);
+    return _compact_frames(encoded, chunks, channels, start, frames);
+}
 
-        temp_div = div(temp_sum, QLENGTH);
+short encode(short *const pcm[], struct encode_chunk_struct *const chunks[], short channels, short encoded[])
+{
+    short i;
+    short pairs = (channels + 1) >> 1;
+    struct encode_job job = {pcm, chunks, channels, encoded};
+    int start = chunks[0]->frame;
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            temp_sum = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            temp_sum = temp_div.quot - 1;
-        } else {
-            temp_sum = temp_div.quot;
+    if (chunks[0]->frameSize < PARALLEL_FRAMESIZE) {
+        for (i = 0 ; i < pairs ; i++) {
+            _encode_task(&job, i);
         }
+    } else {
+        workers_run(_encode_task, &job, pairs);
+    }
 
-        chunk_right->Qstep[2] = (short)((temp_sum * PHI_3) >> 13);
-
-        // Precalculation Subband 4 Right
-        e += 1;
-        // roundDiv
-        temp_div = div(encoded_tmp[e] - chunk_right->prediction[3], chunk_right->Qstep[3]);
-
-        chunk_right->prediction[2] = (short)((MU_3*(chunk_right->diff_deq[2][chunk_left->diff_deq_index] + chunk_right->prediction[2])) >> 15);
+    return (short) _compact_frames(encoded, chunks, channels, start, 1);
+}
 
-        if (chunk_right->Qstep[2] < QMIN) {
-            chunk_right->Qstep[2] = QMIN;
-        } else if (chunk_right->Qstep[2] > QMAX_3) {
-            chunk_right->Qstep[2] = QMAX_3;
-        }
+/* A serialised state starts with its version, frameSize, flags, the number of its
+ * profile in profiles[], the depth, the number of its filter bank in qmf_filters[],
+ * the frame in two words, the stereo mode and whether the quantisers use the side
+ * profile */
+#define STATE_HEADER 10
 
-        /******************************/
-        /** Encoding Subband 4 Right **/
-        /******************************/
+/* Words of the serialised state of an encoder of this configuration */
+static short _state_words(short flags, const struct profile_struct *profile, const struct qmf_struct *qmf)
+{
+    short node = (flags & CODEC_LIFTING) ? LIFTING_STATE_WORDS : qmf->length - 1;
 
-        if((temp_div.rem << 1) > chunk_right->Qstep[3] && temp_div.quot > 0) {
-            encoded_tmp[e] = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > chunk_right->Qstep[3] && temp_div.quot < 0) {
-            encoded_tmp[e] = temp_div.quot - 1;
-        } else {
-            encoded_tmp[e] = temp_div.quot;
-        }
+    return STATE_HEADER + ((1 << profile->depth) - 1) * node + GROUPS(profile->depth) * QUANTIZER_STATE_WORDS + 2;
+}
 
-        if (encoded_tmp[e] > MAX_LEVEL_4) {
-            encoded_tmp[e] = MAX_LEVEL_4;
-        } else if (encoded_tmp[e] < MIN_LEVEL_4) {
-            encoded_tmp[e] = MIN_LEVEL_4;
+short encode_serialize(const struct encode_chunk_struct *chunk, short words[])
+{
+    short l, n, g, p;
+    short depth = chunk->profile->depth;
+    short taps = chunk->qmf->length >> 1;
+    short *out = words;
+    const struct analysis_level_struct *level;
+
+    p = profile_index(chunk->profile);
+    if (p < 0)
+        return 0;
+
+    *out++ = CODEC_STATE_VERSION;
+    *out++ = chunk->frameSize;
+    *out++ = chunk->flags;
+    *out++ = p;
+    *out++ = depth;
+    *out++ = (short) (chunk->qmf - qmf_filters);
+    *out++ = STATE_HIGH(chunk->frame);
+    *out++ = STATE_LOW(chunk->frame);
+    *out++ = chunk->stereo;
+    *out++ = (chunk->quantizer[0].profile == chunk->side) ? 1 : 0;
+
+    // Only the history the next frame reads, in front of the window
+    for (l = 0 ; l < depth ; l++) {
+        level = &chunk->levels[l];
+
+        for (n = 0 ; n < (1 << l) ; n++) {
+            if (chunk->flags & CODEC_LIFTING) {
+                lifting_serialize(&level->lifting[n], out);
+                out += LIFTING_STATE_WORDS;
+            } else {
+                memcpy(out, level->pairs + ((n * (LEVEL_HISTORY >> l) + level->window) << 1), ((taps - 1) << 1) * sizeof(short));
+                out += (taps - 1) << 1;
+                *out++ = level->odd_lastvalue[n];
+            }
         }
+    }
 
-        chunk_right->diff_deq[3][chunk_left->diff_deq_index] = (short) (encoded_tmp[e] * chunk_right->Qstep[3]);
+    for (g = 0 ; g < GROUPS(depth) ; g++, out += QUANTIZER_STATE_WORDS)
+        quantizer_serialize(&chunk->quantizer[g], out);
 
-        // meanAbs
-        temp_sum = SUMABS(chunk_right->diff_deq[3]);
+    *out++ = chunk->dtx.hangover;
+    *out++ = chunk->dtx.untilSid;
 
-        temp_div = div(temp_sum, QLENGTH);
+    return (short) (out - words);
+}
 
-        if((temp_div.rem << 1) > QLENGTH && temp_div.quot > 0) {
-            temp_sum = temp_div.quot + 1;
-        } else if (-(temp_div.rem << 1) > QLENGTH && temp_div.quot < 0) {
-            temp_sum = temp_div.quot - 1;
-        } else {
-            temp_sum = temp_div.quot;
+short encode_deserialize(struct encode_chunk_struct *chunk, const short words[], short length)
+{
+    short l, n, g;
+    short frameSize, flags, taps;
+    const short *in = words + STATE_HEADER;
+    const struct profile_struct *profile;
+    const struct qmf_struct *qmf;
+    struct analysis_level_struct *level;
+
+    if (length < STATE_HEADER || words[0] != CODEC_STATE_VERSION)
+        return 0;
+    if (words[3] < 0 || words[3] >= PROFILE_COUNT || words[5] < 0 || words[5] >= QMF_COUNT)
+        return 0;
+
+    frameSize = words[1];
+    flags = words[2];
+    profile = profile_find(profiles[words[3]].name, words[4]);
+    qmf = &qmf_filters[words[5]];
+    taps = qmf->length >> 1;
+
+    if (profile == NULL || frameSize < MIN_FRAMESIZE * GROUPS(profile->depth) || frameSize > MAX_FRAMESIZE || frameSize % (GROUPS(profile->depth) << 2))
+        return 0;
+    if (length < _state_words(flags, profile, qmf))
+        return 0;
+
+    encode_construct(chunk, frameSize, profile, qmf, flags);
+    chunk->frame = STATE_INT(words[6], words[7]);
+    chunk->stereo = (words[8] == STEREO_MS || words[8] == STEREO_MID) ? words[8] : STEREO_LR;
+    if (words[9])
+        _quantizer_restart(chunk->quantizer, chunk->side);
+
+    // The histories go to the front of the windows
+    for (l = 0 ; l < profile->depth ; l++) {
+        level = &chunk->levels[l];
+
+        for (n = 0 ; n < (1 << l) ; n++) {
+            if (flags & CODEC_LIFTING) {
+                lifting_deserialize(&level->lifting[n], in);
+                in += LIFTING_STATE_WORDS;
+            } else {
+                memcpy(level->pairs + ((n * (LEVEL_HISTORY >> l)) << 1), in, ((taps - 1) << 1) * sizeof(short));
+                in += (taps - 1) << 1;
+                level->odd_lastvalue[n] = *in++;
+            }
         }
-        chunk_right->Qstep[3] = (short)((temp_sum * PHI_4) >> 13);
+    }
 
-        chunk_right->prediction[3] = (short)((MU_4*(chunk_right->diff_deq[3][chunk_left->diff_deq_index] + chunk_right->prediction[3])) >> 15);
+    for (g = 0 ; g < GROUPS(profile->depth) ; g++, in += QUANTIZER_STATE_WORDS)
+        quantizer_deserialize(&chunk->quantizer[g], in);
 
-        if (chunk_right->Qstep[3] < QMIN) {
-            chunk_right->Qstep[3] = QMIN;
-        } else if (chunk_right->Qstep[3] > QMAX_4) {
-            chunk_right->Qstep[3] = QMAX_4;
-        }
-    }
+    chunk->dtx.hangover = *in++;
+    chunk->dtx.untilSid = *in++;
 
-    /******************/
-    /** Bit Grouping **/
-    /******************/
-    encoded[0] = ((encoded_tmp[0] - MIN_LEVEL_1) << 11)
-                | ((encoded_tmp[1] - MIN_LEVEL_2) << 8)
-                | ((encoded_tmp[2] - MIN_LEVEL_3) << 6)
-                | ((encoded_tmp[3] - MIN_LEVEL_4) << 4)
-                | ((encoded_tmp[6] - MIN_LEVEL_3) << 2)
-                | ((encoded_tmp[7] - MIN_LEVEL_4));
-    encoded[1] = ((encoded_tmp[4] - MIN_LEVEL_1) << 11)
-                | ((encoded_tmp[5] - MIN_LEVEL_2) << 8)
-                | ((encoded_tmp[8] - MIN_LEVEL_1) << 3)
-                | ((encoded_tmp[9] - MIN_LEVEL_2));
-    encoded[2] = ((encoded_tmp[10] - MIN_LEVEL_3) << 14)
-                | ((encoded_tmp[11] - MIN_LEVEL_4) << 12)
-                | ((encoded_tmp[12] - MIN_LEVEL_1) << 7)
-                | ((encoded_tmp[13] - MIN_LEVEL_2) << 4)
-                | ((encoded_tmp[14] - MIN_LEVEL_3) << 2)
-                | ((encoded_tmp[15] - MIN_LEVEL_4));
-    encoded[3] = ((encoded_tmp[16] - MIN_LEVEL_1) << 11)
-                | ((encoded_tmp[17] - MIN_LEVEL_2) << 8)
-                | ((encoded_tmp[18] - MIN_LEVEL_3) << 6)
-                | ((encoded_tmp[19] - MIN_LEVEL_4) << 4)
-                | ((encoded_tmp[22] - MIN_LEVEL_3) << 2)
-                | ((encoded_tmp[23] - MIN_LEVEL_4));
-    encoded[4] = ((encoded_tmp[20] - MIN_LEVEL_1) << 11)
-                | ((encoded_tmp[21] - MIN_LEVEL_2) << 8)
-                | ((encoded_tmp[24] - MIN_LEVEL_1) << 3)
-                | ((encoded_tmp[25] - MIN_LEVEL_2));
-    encoded[5] = ((encoded_tmp[26] - MIN_LEVEL_3) << 14)
-                | ((encoded_tmp[27] - MIN_LEVEL_4) << 12)
-                | ((encoded_tmp[28] - MIN_LEVEL_1) << 7)
-                | ((encoded_tmp[29] - MIN_LEVEL_2) << 4)
-                | ((encoded_tmp[30] - MIN_LEVEL_3) << 2)
-                | ((encoded_tmp[31] - MIN_LEVEL_4));
-    encoded[6] = ((encoded_tmp[32] - MIN_LEVEL_1) << 11)
-                | ((encoded_tmp[33] - MIN_LEVEL_2) << 8)
-                | ((encoded_tmp[34] - MIN_LEVEL_3) << 6)
-                | ((encoded_tmp[35] - MIN_LEVEL_4) << 4)
-                | ((encoded_tmp[38] - MIN_LEVEL_3) << 2)
-                | ((encoded_tmp[39] - MIN_LEVEL_4));
-    encoded[7] = ((encoded_tmp[36] - MIN_LEVEL_1) << 11)
-                | ((encoded_tmp[37] - MIN_LEVEL_2) << 8);
-
-    return;
+    return (short) (in - words);
 }
@@ -1,21 +1,71 @@
 struct encode_chunk_struct {
-    /*Samples of the previous buffer needed for convolution*/
-    short even_subband_1[FLENGTH/2 - 1 + BUFFERSIZE/4];
-    short odd_subband_1[FLENGTH/2 - 1 + BUFFERSIZE/4];
-    short odd_1_lastvalue;
-
-    short even_subband_2a[FLENGTH/2 - 1 + BUFFERSIZE/8];
-    short odd_subband_2a[FLENGTH/2 - 1 + BUFFERSIZE/8];
-    short odd_2a_lastvalue;
-    short even_subband_2c[FLENGTH/2 - 1 + BUFFERSIZE/8];
-    short odd_subband_2c[FLENGTH/2 - 1 + BUFFERSIZE/8];
-    short odd_2c_lastvalue;
-
-    /*Quantisation*/
-    short prediction[4];
-    short Qstep[4];
-    short diff_deq[4][QLENGTH];
-    short diff_deq_index;
+    /*Temporal sample positions per frame*/
+    short frameSize;
+
+    /*CODEC_* options*/
+    short flags;
+
+    /*Frames coded so far, which places the sync frames*/
+    int frame;
+
+    /*Bit allocation of the stream and of a side channel with CODEC_JOINT*/
+    const struct profile_struct *profile;
+    const struct profile_struct *side;
+
+    /*Analysis filter bank*/
+    const struct qmf_struct *qmf;
+
+    /*Sliding windows of (even, odd) polyphase pairs per tree level, node n of level l
+      at pairs + n * (LEVEL_HISTORY >> l) pairs: frames are appended behind the
+      FLENGTH/2 - 1 pairs of history, which are only mirrored back to the front
+      once the next frame no longer fits*/
+    struct analysis_level_struct {
+        short pairs[LEVEL_HISTORY << 1];
+        short window;
+        short odd_lastvalue[MAX_SUBBANDS/2];
+
+        /*Lifting steps per node with CODEC_LIFTING*/
+        struct lifting_struct lifting[MAX_SUBBANDS/2];
+    } levels[MAX_DEPTH];
+
+    /*Quantisation, one state per group of four lanes*/
+    struct quantizer_struct quantizer[MAX_GROUPS];
+
+    /*Silence detection for CODEC_DTX*/
+    struct dtx_struct dtx;
+
+    /*Joint stereo mode of the channel's pair in the last frame with CODEC_JOINT*/
+    short stereo;
 };
 
-void encode(short buffer[BUFFERSIZE], struct encode_chunk_struct * restrict chunk_left, struct encode_chunk_struct * restrict chunk_right, short encoded[BUFFERSIZE]);
+/*Largest serialised encoder state in words: a header, the live filter history of every node, the quantisers and DTX*/
+#define ENCODE_STATE_WORDS (12 + (MAX_SUBBANDS - 1) * (MAX_FLENGTH - 1) + MAX_GROUPS * QUANTIZER_STATE_WORDS)
+
+void encode_construct(struct encode_chunk_struct *chunk, short frameSize, const struct profile_struct *profile, const struct qmf_struct *qmf, short flags);
+/* Writes the whole state of a channel's encoder, its configuration included, to at most
+ * ENCODE_STATE_WORDS words in the version CODEC_STATE_VERSION, so that a live stream can
+ * move to an encoder elsewhere. Returns the words written, or 0 for a profile that is
+ * not one of profiles[] and so could not be restored. */
+short encode_serialize(const struct encode_chunk_struct *chunk, short words[]);
+/* Constructs chunk from the length words of a serialised state, after which it codes as
+ * the encoder that wrote it. Returns the words read, or 0 for a state of another version
+ * or configuration this build does not have, which leaves chunk unchanged. */
+short encode_deserialize(struct encode_chunk_struct *chunk, const short words[], short length);
+/* Encodes one frame of each channel. pcm[c] holds frameSize samples of channel c,
+ * the frame is written as consecutive channel sections of bitstream_size() words,
+ * or of up to entropy_size() words with CODEC_ENTROPY, behind a header with
+ * CODEC_DTX (see dtx.h), with the stereo modes of CODEC_JOINT (see stereo.h).
+ * Speech sections of sync frames start with a quantiser snapshot with CODEC_SYNC.
+ * encoded[] takes up to frameSize words per channel, as the pcm. Returns the
+ * words written. */
+short encode(short *const pcm[], struct encode_chunk_struct *const chunks[], short channels, short encoded[]);
+/* Encodes frames consecutive frames of interleaved pcm (channels samples per temporal position)
+ * into the same bitstream as that many calls to encode(). encoded[] is as large as pcm[].
+ * Returns the words written. */
+long encode_frames(const short pcm[], int frames, struct encode_chunk_struct *const chunks[], short channels, short encoded[]);
+/* encode_frames() split at sync frames into up to segments parts encoded at once, for long files: chunks holds
+ * segments sets of channels constructed alike, the first of which is the stream's and holds the state after the
+ * span. Each part after the first starts from fresh encoders warmed up on the SYNC_WARMUP temporal samples before
+ * it, so the bitstream differs from that of encode_frames() from there on, but it decodes as any other. Without
+ * CODEC_SYNC this is encode_frames(). */
+long encode_segments(const short pcm[], int frames, struct encode_chunk_struct *const chunks[], short channels, short segments, short encoded[]);
@@ -0,0 +1,271 @@
+#include "globals.h"
+#include "codec.h"
+#include "profile.h"
+#include "bitstream.h"
+#include "entropy.h"
+
+#define PARAMETER_BITS 3
+
+/* Words are filled MSB first; the accumulator holds fewer than 16 pending bits between calls */
+struct bit_writer {
+    short *out;
+    unsigned int acc;
+    short fill;
+};
+
+struct bit_reader {
+    const short *in;
+    const short *end;
+    unsigned int acc;
+    short fill;
+};
+
+/* Writes the n <= 16 low bits of bits */
+static inline void _put(struct bit_writer *w, unsigned int bits, short n)
+{
+    w->acc = (w->acc << n) | bits;
+    w->fill += n;
+
+    if (w->fill >= 16) {
+        w->fill -= 16;
+        *w->out++ = (short) (w->acc >> w->fill);
+    }
+}
+
+/* Reads n <= 16 bits; past the end of the section only zeros are read */
+static inline unsigned int _get(struct bit_reader *r, short n)
+{
+    if (r->fill < n) {
+        r->acc = (r->acc << 16) | (r->in < r->end ? (unsigned short) *r->in++ : 0);
+        r->fill += 16;
+    }
+
+    r->fill -= n;
+    return (r->acc >> r->fill) & ((1u << n) - 1);
+}
+
+static inline unsigned int _zigzag(int level)
+{
+    unsigned int u = (unsigned int) level;
+
+    return (u << 1) ^ (0u - (u >> 31));
+}
+
+/* The first coded subband of the section, in group order, or -1 without bits */
+static short _first(const struct profile_struct *profile, short groups, short *bits)
+{
+    short g, s;
+
+    for (g = 0 ; g < groups ; g++) {
+        for (s = 0 ; s < 4 ; s++) {
+            if (profile[g].nbits[s] > 0) {
+                *bits = profile[g].nbits[s];
+                return (short) ((g << 2) + s);
+            }
+        }
+    }
+
+    return -1;
+}
+
+short entropy_size(const struct profile_struct *profile, short frameSize, short skip)
+{
+    short g, s;
+    short groups = GROUPS(profile->depth);
+    short marker = 0;
+    int bits = skip;
+
+    if (_first(profile, groups, &marker) < 0)
+        return (short) ((skip + 15) >> 4);
+
+    for (g = 0 ; g < groups ; g++) {
+        for (s = 0 ; s < 4 ; s++) {
+            if (profile[g].nbits[s] > 0)
+                bits += profile[g].nbits[s] * (frameSize / groups >> 2) + PARAMETER_BITS;
+        }
+    }
+
+    return (short) ((marker + bits + 15) >> 4);
+}
+
+short entropy_length(const struct profile_struct *profile, short frameSize, const short *encoded, short skip)
+{
+    short levels[MAX_FRAMESIZE];
+
+    return entropy_unpack(profile, levels, encoded, frameSize, skip);
+}
+
+short entropy_pack(const struct profile_struct *profile, short *restrict encoded, const short *restrict levels, short frameSize, short skip)
+{
+    short i, s, k, g;
+    short groups = GROUPS(profile->depth);
+    short block = frameSize / groups;
+    short count = (block >> 2) << 2;
+    short raw = bitstream_size(profile, frameSize, skip);
+    short marker = 0;
+    short first = _first(profile, groups, &marker);
+    short parameter[MAX_GROUPS][4];
+    unsigned int u, q, run, limit[MAX_GROUPS][4];
+    long cost[4][MAX_NBITS];
+    long best, bits;
+    const struct profile_struct *p;
+    const short *l;
+    struct bit_writer w = {encoded, (unsigned short) *encoded >> (16 - skip), skip};
+
+    if (first < 0) {
+        bitstream_pack(profile, encoded, levels, frameSize, skip);
+        return raw;
+    }
+
+    bits = skip + marker;
+    for (g = 0 ; g < groups ; g++) {
+        p = profile + g;
+        l = levels + g * block;
+
+        /*Bits of every Rice parameter below the fixed width*/
+        for (s = 0 ; s < 4 ; s++) {
+            for (k = 0 ; k < p->nbits[s] ; k++)
+                cost[s][k] = 0;
+        }
+
+        for (i = 0 ; i < count ; i++) {
+            s = i & 3;
+            u = _zigzag(l[i]);
+
+            for (k = 0 ; k < p->nbits[s] ; k++)
+                cost[s][k] += (u >> k) + 1 + k;
+        }
+
+        for (s = 0 ; s < 4 ; s++) {
+            if (p->nbits[s] == 0)
+                continue;
+
+            parameter[g][s] = ENTROPY_RAW;
+            best = (long) p->nbits[s] * (count >> 2);
+            for (k = 0 ; k < p->nbits[s] ; k++) {
+                if (cost[s][k] < best) {
+                    best = cost[s][k];
+                    parameter[g][s] = k;
+                }
+            }
+
+            limit[g][s] = (parameter[g][s] == ENTROPY_RAW) ? 0 : ((1u << p->nbits[s]) - 1) >> parameter[g][s];
+            bits += best + PARAMETER_BITS;
+        }
+    }
+
+    // The fixed width section unless it would start with the marker
+    if (((bits + 15) >> 4) >= raw && levels[(first >> 2) * block + (first & 3)] != profile[first >> 2].minLevel[first & 3]) {
+        bitstream_pack(profile, encoded, levels, frameSize, skip);
+        return raw;
+    }
+
+    _put(&w, 0, marker);
+
+    for (g = 0 ; g < groups ; g++) {
+        for (s = 0 ; s < 4 ; s++) {
+            if (profile[g].nbits[s] > 0)
+                _put(&w, parameter[g][s], PARAMETER_BITS);
+        }
+    }
+
+    for (g = 0 ; g < groups ; g++) {
+        p = profile + g;
+        l = levels + g * block;
+
+        for (i = 0 ; i < count ; i++) {
+            s = i & 3;
+
+            if (p->nbits[s] == 0)
+                continue;
+
+            if (parameter[g][s] == ENTROPY_RAW) {
+                _put(&w, (unsigned int) (l[i] - p->minLevel[s]), p->nbits[s]);
+            } else {
+                k = parameter[g][s];
+                u = _zigzag(l[i]);
+
+                // Unary quotient, without the terminating zero at the largest one, then the k remainder bits
+                q = u >> k;
+                for (run = q ; run >= 16 ; run -= 16)
+                    _put(&w, 0xFFFF, 16);
+                _put(&w, (1u << run) - 1, (short) run);
+                if (q < limit[g][s])
+                    _put(&w, 0, 1);
+                _put(&w, u & ((1u << k) - 1), k);
+            }
+        }
+    }
+
+    if (w.fill > 0)
+        *w.out++ = (short) (w.acc << (16 - w.fill));
+
+    return (short) (w.out - encoded);
+}
+
+short entropy_unpack(const struct profile_struct *profile, short *restrict levels, const short *restrict encoded, short frameSize, short skip)
+{
+    short i, s, k, g;
+    short groups = GROUPS(profile->depth);
+    short block = frameSize / groups;
+    short count = (block >> 2) << 2;
+    short marker = 0;
+    short parameter[MAX_GROUPS][4];
+    unsigned int u, q, limit[MAX_GROUPS][4];
+    const struct profile_struct *p;
+    short *l;
+    struct bit_reader r = {encoded, encoded + entropy_size(profile, frameSize, skip), 0, 0};
+
+    if (_first(profile, groups, &marker) < 0) {
+        for (i = 0 ; i < frameSize ; i++)
+            levels[i] = 0;
+        return (short) ((skip + 15) >> 4);
+    }
+
+    _get(&r, skip);
+    if (_get(&r, marker) != 0) {
+        bitstream_unpack(profile, levels, encoded, frameSize, skip);
+        return bitstream_size(profile, frameSize, skip);
+    }
+
+    for (g = 0 ; g < groups ; g++) {
+        p = profile + g;
+
+        for (s = 0 ; s < 4 ; s++) {
+            if (p->nbits[s] == 0)
+                continue;
+
+            parameter[g][s] = (short) _get(&r, PARAMETER_BITS);
+            if (parameter[g][s] >= p->nbits[s])
+                parameter[g][s] = ENTROPY_RAW;
+
+            // Largest quotient of a level in range, which also bounds a corrupt section
+            limit[g][s] = (parameter[g][s] == ENTROPY_RAW) ? 0 : ((1u << p->nbits[s]) - 1) >> parameter[g][s];
+        }
+    }
+
+    for (g = 0 ; g < groups ; g++) {
+        p = profile + g;
+        l = levels + g * block;
+
+        for (i = 0 ; i < count ; i++) {
+            s = i & 3;
+
+            if (p->nbits[s] == 0) {
+                l[i] = 0;
+            } else if (parameter[g][s] == ENTROPY_RAW) {
+                l[i] = (short) _get(&r, p->nbits[s]) + p->minLevel[s];
+            } else {
+                k = parameter[g][s];
+
+                for (q = 0 ; q < limit[g][s] && _get(&r, 1) ; q++) {}
+                u = (q << k) | _get(&r, k);
+
+                l[i] = (short) ((u >> 1) ^ -(u & 1));
+            }
+        }
+    }
+
+    // Whole words read, so the next section starts behind the last code
+    return (short) (r.in - encoded);
+}
@@ -0,0 +1,29 @@
+#ifndef __ENC_ENTROPY_H__
+#define __ENC_ENTROPY_H__
+
+/* Entropy coding of the quantised subband levels.
+ *
+ * A lossless alternative to bitstream_pack() for the same levels[] layout.
+ * Each subband of a channel frame is Rice coded on its zigzag mapped levels
+ * (0, -1, 1, -2, ...) with the parameter that needs the fewest bits for that
+ * frame, or kept at its fixed width when no parameter beats it. Such a section
+ * starts with the code of the lowest level in the first coded subband as a
+ * marker, then 3 bits of parameter per transmitted subband, group by group,
+ * and the codes block by block, MSB first and zero padded to a word; it ends
+ * with its last code. When it would take as many words as bitstream_pack(),
+ * the section is that output instead, unless its first level is the marker:
+ * the option never takes more words than fixed packing but for those frames.
+ * An all zero section decodes as zero levels. As with bitstream_pack(), the
+ * section starts skip bits into its first word, whose top skip bits are kept. */
+#define ENTROPY_RAW 7 /*parameter of a subband kept at its fixed width*/
+
+/* Worst case words of one channel section */
+short entropy_size(const struct profile_struct *profile, short frameSize, short skip);
+/* Words of the section at encoded, at most entropy_size() */
+short entropy_length(const struct profile_struct *profile, short frameSize, const short *encoded, short skip);
+/* Returns the words written */
+short entropy_pack(const struct profile_struct *profile, short *restrict encoded, const short *restrict levels, short frameSize, short skip);
+/* Returns the words read */
+short entropy_unpack(const struct profile_struct *profile, short *restrict levels, const short *restrict encoded, short frameSize, short skip);
+
+#endif
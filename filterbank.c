@@ -0,0 +1,362 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+#include "codec.h"
+#include "filterbank.h"
+#include "qmf_tables.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define __ENC_QMF_X86__
+    #include <immintrin.h>
+#endif
+
+#define QMF_COEFFICIENTS(length) \
+    static const short analysis_even_##length[length/2] = QMF_##length##_ANALYSIS_EVEN; \
+    static const short analysis_odd_##length[length/2] = QMF_##length##_ANALYSIS_ODD; \
+    static const short synthesis_even_##length[length/2] = QMF_##length##_SYNTHESIS_EVEN; \
+    static const short synthesis_odd_##length[length/2] = QMF_##length##_SYNTHESIS_ODD;
+
+QMF_LENGTHS(QMF_COEFFICIENTS)
+
+static const char *qmf_analysis_name = "scalar";
+
+/* Scalar outputs [from, count), also used for the vector tails */
+QMF_INLINE void _qmf_analysis_tail(const short *restrict pairs, short from, short count, short *restrict low, short *restrict high,
+        const short *restrict even, const short *restrict odd, const short taps) {
+    short n, k;
+    int t1;
+    int t2;
+    const short *p;
+
+    for (n = from; n < count; n++) {
+        p = pairs + ((taps - 1 + n) << 1);
+        t1 = 0;
+        t2 = 0;
+
+        QMF_UNROLL
+        for (k = 0; k < taps; k++) {
+            t1 += p[-(k << 1)] * even[k];
+            t2 += p[-(k << 1) + 1] * odd[k];
+        }
+
+        low[n] = (t1 + t2) >> 16;
+        high[n] = (t2 - t1) >> 16;
+    }
+}
+
+#define QMF_SCALAR(length) \
+    static void qmf_analysis_scalar_##length(const short *restrict pairs, short count, short *restrict low, short *restrict high) { \
+        _qmf_analysis_tail(pairs, 0, count, low, high, analysis_even_##length, analysis_odd_##length, length/2); \
+    }
+
+QMF_LENGTHS(QMF_SCALAR)
+
+#ifdef __ENC_QMF_X86__
+    /* One 32-bit lane per tap: (even, odd) coefficients for the sum branch and
+     * (-even, odd) for the difference branch, matching the sample pair layout
+     * so that pmaddwd evaluates one tap of both polyphase branches at once. */
+    #define QMF_TAPS(length) \
+        static int _qmf_sum_taps_##length[length/2]; \
+        static int _qmf_diff_taps_##length[length/2];
+
+    QMF_LENGTHS(QMF_TAPS)
+
+    static void _qmf_prepare_taps(const short *even, const short *odd, short taps, int *sum, int *diff) {
+        short k;
+
+        for (k = 0; k < taps; k++) {
+            sum[k] = (int) (((unsigned int) (unsigned short) odd[k] << 16) | (unsigned short) even[k]);
+            diff[k] = (int) (((unsigned int) (unsigned short) odd[k] << 16) | (unsigned short) -even[k]);
+        }
+    }
+
+    /* SSE2: four outputs per multiply-add */
+    __attribute__((target("sse2")))
+    QMF_INLINE void _qmf_analysis_sse2(const short *restrict pairs, short count, short *restrict low, short *restrict high,
+            const short *restrict even, const short *restrict odd, const int *restrict sumTaps, const int *restrict diffTaps, const short taps) {
+        short n, k;
+        const short *p;
+        __m128i samples, sum, diff;
+
+        for (n = 0; n + 4 <= count; n += 4) {
+            p = pairs + ((taps - 1 + n) << 1);
+            sum = _mm_setzero_si128();
+            diff = _mm_setzero_si128();
+
+            QMF_UNROLL
+            for (k = 0; k < taps; k++) {
+                samples = _mm_loadu_si128((const __m128i *) (p - (k << 1)));
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(samples, _mm_set1_epi32(sumTaps[k])));
+                diff = _mm_add_epi32(diff, _mm_madd_epi16(samples, _mm_set1_epi32(diffTaps[k])));
+            }
+
+            sum = _mm_srai_epi32(sum, 16);
+            diff = _mm_srai_epi32(diff, 16);
+
+            _mm_storel_epi64((__m128i *) (low + n), _mm_packs_epi32(sum, sum));
+            _mm_storel_epi64((__m128i *) (high + n), _mm_packs_epi32(diff, diff));
+        }
+
+        _qmf_analysis_tail(pairs, n, count, low, high, even, odd, taps);
+    }
+
+    /* AVX2: eight outputs per multiply-add */
+    __attribute__((target("avx2")))
+    QMF_INLINE void _qmf_analysis_avx2(const short *restrict pairs, short count, short *restrict low, short *restrict high,
+            const short *restrict even, const short *restrict odd, const int *restrict sumTaps, const int *restrict diffTaps, const short taps) {
+        short n, k;
+        const short *p;
+        __m256i samples, sum, diff;
+
+        for (n = 0; n + 8 <= count; n += 8) {
+            p = pairs + ((taps - 1 + n) << 1);
+            sum = _mm256_setzero_si256();
+            diff = _mm256_setzero_si256();
+
+            QMF_UNROLL
+            for (k = 0; k < taps; k++) {
+                samples = _mm256_loadu_si256((const __m256i *) (p - (k << 1)));
+                sum = _mm256_add_epi32(sum, _mm256_madd_epi16(samples, _mm256_set1_epi32(sumTaps[k])));
+                diff = _mm256_add_epi32(diff, _mm256_madd_epi16(samples, _mm256_set1_epi32(diffTaps[k])));
+            }
+
+            // packs works per 128-bit lane: gather the low quadword of both lanes
+            sum = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_srai_epi32(sum, 16), _mm256_setzero_si256()), 0xD8);
+            diff = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_srai_epi32(diff, 16), _mm256_setzero_si256()), 0xD8);
+
+            _mm_storeu_si128((__m128i *) (low + n), _mm256_castsi256_si128(sum));
+            _mm_storeu_si128((__m128i *) (high + n), _mm256_castsi256_si128(diff));
+        }
+
+        _qmf_analysis_tail(pairs, n, count, low, high, even, odd, taps);
+    }
+
+    #define QMF_VECTOR(length) \
+        __attribute__((target("sse2"))) \
+        static void qmf_analysis_sse2_##length(const short *restrict pairs, short count, short *restrict low, short *restrict high) { \
+            _qmf_analysis_sse2(pairs, count, low, high, analysis_even_##length, analysis_odd_##length, \
+                    _qmf_sum_taps_##length, _qmf_diff_taps_##length, length/2); \
+        } \
+        __attribute__((target("avx2"))) \
+        static void qmf_analysis_avx2_##length(const short *restrict pairs, short count, short *restrict low, short *restrict high) { \
+            _qmf_analysis_avx2(pairs, count, low, high, analysis_even_##length, analysis_odd_##length, \
+                    _qmf_sum_taps_##length, _qmf_diff_taps_##length, length/2); \
+        }
+
+    QMF_LENGTHS(QMF_VECTOR)
+#endif
+
+#define QMF_FILTER(length) \
+    {"qmf" #length, length, analysis_even_##length, analysis_odd_##length, synthesis_even_##length, synthesis_odd_##length, \
+            qmf_analysis_scalar_##length},
+
+struct qmf_struct qmf_filters[QMF_COUNT] = {
+    QMF_LENGTHS(QMF_FILTER)
+};
+
+const struct qmf_struct *qmf_find(const char *name) {
+    short i;
+
+    for (i = 0; i < QMF_COUNT; i++) {
+        if (strcmp(qmf_filters[i].name, name) == 0)
+            return &qmf_filters[i];
+    }
+
+    return NULL;
+}
+
+/*CDF 9/7 lifting steps and the scaling to gains of 1 and 2, scaled with 2^12*/
+#define LIFTING_ALPHA -6497
+#define LIFTING_BETA -217
+#define LIFTING_GAMMA 3616
+#define LIFTING_DELTA 1817
+#define LIFTING_SCALE_1 -766 /*K - 1 for K = 1 / DC gain of the low band*/
+#define LIFTING_SCALE_2 942 /*1/K - 1*/
+#define LIFTING_SCALE_3 -3330 /*-K*/
+
+/*Values grow a bit per level at lifting scale, so the product is taken in two
+  parts of value that each fit 32 bits: the same rounding as one 64 bit product*/
+#define LIFT(coefficient, value) ((coefficient) * ((value) >> 12) + (((coefficient) * ((value) & 4095) + 2048) >> 12))
+
+/* Both directions run each step over the whole frame before the next, so every
+ * pass is an independent loop the compiler vectorises for the target of the
+ * wrapper it is inlined into. Index 0 of a step's array is the value the state
+ * carries over from the frame before. */
+QMF_INLINE void _lifting_analysis(struct lifting_struct *restrict state, const int *restrict input, short count, int *restrict low, int *restrict high) {
+    short n;
+    int even[MAX_FRAMESIZE/2 + 1];
+    int odd[MAX_FRAMESIZE/2 + 1];
+    int predicted[MAX_FRAMESIZE/2 + 1];
+    int updated[MAX_FRAMESIZE/2 + 1];
+    int detail[MAX_FRAMESIZE/2 + 1];
+    int l, h;
+
+    even[0] = state->even;
+    odd[0] = state->odd;
+    predicted[0] = state->predicted;
+    updated[0] = state->updated;
+    detail[0] = state->detail;
+
+    for (n = 0; n < count; n++) {
+        even[n + 1] = input[n << 1];
+        odd[n + 1] = input[(n << 1) + 1];
+    }
+
+    // Input pair n completes the steps of the pairs n - 1 and n - 2 before it
+    for (n = 0; n < count; n++)
+        predicted[n + 1] = odd[n] + LIFT(LIFTING_ALPHA, even[n] + even[n + 1]);
+    for (n = 0; n < count; n++)
+        updated[n + 1] = even[n] + LIFT(LIFTING_BETA, predicted[n] + predicted[n + 1]);
+    for (n = 0; n < count; n++)
+        detail[n + 1] = predicted[n] + LIFT(LIFTING_GAMMA, updated[n] + updated[n + 1]);
+
+    for (n = 0; n < count; n++) {
+        l = updated[n] + LIFT(LIFTING_DELTA, detail[n] + detail[n + 1]);
+        h = detail[n + 1] + LIFT(LIFTING_SCALE_1, l);
+        l += h;
+        h += LIFT(LIFTING_SCALE_2, l);
+        low[n] = l + LIFT(LIFTING_SCALE_3, h);
+        high[n] = h;
+    }
+
+    state->even = even[count];
+    state->odd = odd[count];
+    state->predicted = predicted[count];
+    state->updated = updated[count];
+    state->detail = detail[count];
+}
+
+QMF_INLINE void _lifting_synthesis(struct lifting_struct *restrict state, const int *restrict low, const int *restrict high, short count, int *restrict output) {
+    short n;
+    int even[MAX_FRAMESIZE/2 + 1];
+    int predicted[MAX_FRAMESIZE/2 + 1];
+    int updated[MAX_FRAMESIZE/2 + 1];
+    int detail[MAX_FRAMESIZE/2 + 1];
+    int smooth[MAX_FRAMESIZE/2];
+    int l, h;
+
+    even[0] = state->even;
+    predicted[0] = state->predicted;
+    updated[0] = state->updated;
+    detail[0] = state->detail;
+
+    for (n = 0; n < count; n++) {
+        h = high[n];
+        l = low[n] - LIFT(LIFTING_SCALE_3, h);
+        h -= LIFT(LIFTING_SCALE_2, l);
+        l -= h;
+        smooth[n] = l;
+        detail[n + 1] = h - LIFT(LIFTING_SCALE_1, l);
+    }
+
+    // Steps in reverse, each a pair further back: output pair n is the input pair two before
+    for (n = 0; n < count; n++)
+        updated[n + 1] = smooth[n] - LIFT(LIFTING_DELTA, detail[n] + detail[n + 1]);
+    for (n = 0; n < count; n++)
+        predicted[n + 1] = detail[n] - LIFT(LIFTING_GAMMA, updated[n] + updated[n + 1]);
+    for (n = 0; n < count; n++)
+        even[n + 1] = updated[n] - LIFT(LIFTING_BETA, predicted[n] + predicted[n + 1]);
+
+    for (n = 0; n < count; n++) {
+        output[n << 1] = even[n];
+        output[(n << 1) + 1] = predicted[n] - LIFT(LIFTING_ALPHA, even[n] + even[n + 1]);
+    }
+
+    state->even = even[count];
+    state->predicted = predicted[count];
+    state->updated = updated[count];
+    state->detail = detail[count];
+}
+
+static void _lifting_analysis_scalar(struct lifting_struct *restrict state, const int *restrict input, short count, int *restrict low, int *restrict high) {
+    _lifting_analysis(state, input, count, low, high);
+}
+
+static void _lifting_synthesis_scalar(struct lifting_struct *restrict state, const int *restrict low, const int *restrict high, short count, int *restrict output) {
+    _lifting_synthesis(state, low, high, count, output);
+}
+
+#ifdef __ENC_QMF_X86__
+    __attribute__((target("avx2")))
+    static void _lifting_analysis_avx2(struct lifting_struct *restrict state, const int *restrict input, short count, int *restrict low, int *restrict high) {
+        _lifting_analysis(state, input, count, low, high);
+    }
+
+    __attribute__((target("avx2")))
+    static void _lifting_synthesis_avx2(struct lifting_struct *restrict state, const int *restrict low, const int *restrict high, short count, int *restrict output) {
+        _lifting_synthesis(state, low, high, count, output);
+    }
+#endif
+
+static void (*_lifting_analysis_kernel)(struct lifting_struct *restrict, const int *restrict, short, int *restrict, int *restrict) = _lifting_analysis_scalar;
+static void (*_lifting_synthesis_kernel)(struct lifting_struct *restrict, const int *restrict, const int *restrict, short, int *restrict) = _lifting_synthesis_scalar;
+
+void lifting_analysis(struct lifting_struct *restrict state, const int *restrict input, short count, int *restrict low, int *restrict high) {
+    _lifting_analysis_kernel(state, input, count, low, high);
+}
+
+void lifting_synthesis(struct lifting_struct *restrict state, const int *restrict low, const int *restrict high, short count, int *restrict output) {
+    _lifting_synthesis_kernel(state, low, high, count, output);
+}
+
+short lifting_shift(short depth, short band) {
+    short shift = depth;
+
+    // A bit more for every high branch on the path to the subband
+    for (; band; band >>= 1)
+        shift += band & 1;
+
+    return shift;
+}
+
+void lifting_serialize(const struct lifting_struct *state, short words[]) {
+    const int values[5] = {state->even, state->odd, state->predicted, state->updated, state->detail};
+    short i;
+
+    for (i = 0; i < 5; i++) {
+        words[i << 1] = STATE_HIGH(values[i]);
+        words[(i << 1) + 1] = STATE_LOW(values[i]);
+    }
+}
+
+void lifting_deserialize(struct lifting_struct *state, const short words[]) {
+    state->even = STATE_INT(words[0], words[1]);
+    state->odd = STATE_INT(words[2], words[3]);
+    state->predicted = STATE_INT(words[4], words[5]);
+    state->updated = STATE_INT(words[6], words[7]);
+    state->detail = STATE_INT(words[8], words[9]);
+}
+
+void filterbank_construct() {
+    qmf_analysis_name = "scalar";
+    _lifting_analysis_kernel = _lifting_analysis_scalar;
+    _lifting_synthesis_kernel = _lifting_synthesis_scalar;
+
+    #ifdef __ENC_QMF_X86__
+        short i = 0;
+
+        #define QMF_SELECT(length) \
+            _qmf_prepare_taps(analysis_even_##length, analysis_odd_##length, length/2, _qmf_sum_taps_##length, _qmf_diff_taps_##length); \
+            if (__builtin_cpu_supports("avx2")) \
+                qmf_filters[i].analysis = qmf_analysis_avx2_##length; \
+            else if (__builtin_cpu_supports("sse2")) \
+                qmf_filters[i].analysis = qmf_analysis_sse2_##length; \
+            i++;
+
+        __builtin_cpu_init();
+        QMF_LENGTHS(QMF_SELECT)
+
+        if (__builtin_cpu_supports("avx2")) {
+            qmf_analysis_name = "avx2";
+            _lifting_analysis_kernel = _lifting_analysis_avx2;
+            _lifting_synthesis_kernel = _lifting_synthesis_avx2;
+        } else if (__builtin_cpu_supports("sse2")) {
+            qmf_analysis_name = "sse2";
+        }
+    #endif
+
+    #ifdef VERBOSE
+        printf("QMF analysis kernels: %s, %d to %d taps\n", qmf_analysis_name, qmf_filters[0].length, qmf_filters[QMF_COUNT - 1].length);
+    #endif
+}
@@ -0,0 +1,97 @@
+#ifndef __ENC_FILTERBANK_H__
+#define __ENC_FILTERBANK_H__
+
+/* Polyphase QMF analysis.
+ *
+ * Each channel history holds the (even, odd) polyphase samples interleaved per
+ * time index: pairs[2t] = even[t], pairs[2t+1] = odd[t]. Output n is taken at
+ * time index length/2 - 1 + n, so the first length/2 - 1 pairs are history.
+ *
+ *     low[n]  = (CONV(even, filter_even) + CONV(odd, filter_odd)) >> 16
+ *     high[n] = (CONV(odd, filter_odd) - CONV(even, filter_even)) >> 16
+ *
+ * One channel per call; the vector kernels compute several outputs at once. */
+typedef void (*qmf_analysis_t)(const short *restrict pairs, short count, short *restrict low, short *restrict high);
+
+/* A QMF prototype of qmf_tables.h. Every length has its own kernels with the
+ * tap loops unrolled at compile time; longer filters separate the subbands
+ * better, shorter ones cost less and delay less. */
+struct qmf_struct {
+    const char *name;
+
+    /*Taps of the prototype, at most MAX_FLENGTH*/
+    short length;
+
+    /*Polyphase branches of length/2 taps*/
+    const short *analysis_even;
+    const short *analysis_odd;
+    const short *synthesis_even;
+    const short *synthesis_odd;
+
+    /*Fastest kernel of this length on the host, set by filterbank_construct()*/
+    qmf_analysis_t analysis;
+};
+
+/* Kernels are written once for any number of taps and inlined into a wrapper
+ * per prototype length of QMF_LENGTHS(), where the tap count is a constant:
+ * the compiler then unrolls the tap loops completely. */
+#if defined(__GNUC__)
+    #define QMF_INLINE static inline __attribute__((always_inline))
+    #define QMF_UNROLL _Pragma("GCC unroll 32")
+#else
+    #define QMF_INLINE static inline
+    #define QMF_UNROLL
+#endif
+
+#define QMF_COUNT 5
+#define QMF_DEFAULT 2 /*the 20 taps streams have always used*/
+
+extern struct qmf_struct qmf_filters[QMF_COUNT];
+
+/* Returns the filter bank called name, e.g. "qmf20", or NULL */
+const struct qmf_struct *qmf_find(const char *name);
+
+/* Integer lifting filter bank, the alternative to the QMFs with CODEC_LIFTING.
+ *
+ * The CDF 9/7 biorthogonal pair factored into four lifting steps, each adding
+ * a rounded multiple of the sum of two neighbours of the other phase, and three
+ * more that scale the bands to a gain of 1 and 2. Every step is undone exactly
+ * by subtracting what it added, so the steps are invertible in integer
+ * arithmetic. The bands stay at that scale through the tree, a bit wider per
+ * level, so the filter bank reconstructs its input exactly; each step takes its
+ * product in two 32 bit parts, so a pair of outputs takes 14 multiplies where
+ * the 20 tap QMF takes 20, and 9 and 7 taps separate the bands about as well as
+ * 8 to 16 QMF taps. The codec brings a subband onto
+ * the scale of the QMF subbands, where the profiles and DTX thresholds hold, by
+ * a rounded shift of lifting_shift() bits, and the decoder shifts it back: the
+ * bits it drops are finer than the smallest quantiser step.
+ *
+ * Each node keeps the last values of the lifting steps instead of a window of
+ * history: outputs are two pairs behind the input on both ends. */
+struct lifting_struct {
+    int even;
+    int odd;
+    int predicted;
+    int updated;
+    int detail;
+};
+
+/*QMF length whose synthesis history spans the lifting state, for SYNC_PREROLL()*/
+#define LIFTING_LENGTH 10
+
+/* Splits count pairs of input into count samples of each band */
+void lifting_analysis(struct lifting_struct *restrict state, const int *restrict input, short count, int *restrict low, int *restrict high);
+/* Merges count samples of each band into count pairs of output */
+void lifting_synthesis(struct lifting_struct *restrict state, const int *restrict low, const int *restrict high, short count, int *restrict output);
+/* Bits between subband band of a depth levels tree at lifting scale and at QMF scale */
+short lifting_shift(short depth, short band);
+
+/*Words of a serialised lifting state*/
+#define LIFTING_STATE_WORDS 10
+
+void lifting_serialize(const struct lifting_struct *state, short words[]);
+void lifting_deserialize(struct lifting_struct *state, const short words[]);
+
+void filterbank_construct();
+
+#endif
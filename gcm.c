@@ -0,0 +1,347 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "bigdigits.h"
+#include "gcm.h"
+#include "types.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define __ENC_GCM_X86__
+    #include <immintrin.h>
+#endif
+
+// Keystream generated and hashed per step of gcm_encrypt
+#define GCM_BATCH_BLOCKS 16
+
+// Folds blocks whole blocks of data into the hash y
+typedef void (*ghash_t)(uint8_t *restrict y, const uint8_t *restrict hashKey, const uint8_t *restrict data, size_t blocks);
+
+static ghash_t ghashKernel = NULL;
+static const char *gcm_name = "ctmul64";
+
+static uint64_t _gcm_load64(const uint8_t *bytes) {
+    int i;
+    uint64_t x = 0;
+
+    for (i = 0; i < 8; i++)
+        x = (x << 8) | bytes[i];
+
+    return x;
+}
+
+static void _gcm_store64(uint8_t *bytes, uint64_t x) {
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        bytes[i] = (uint8_t) x;
+        x >>= 8;
+    }
+}
+
+// Carry-less 64x64 multiplication, low 64 bits. Integer multiplications of
+// operands with every fourth bit set keep the carries in the bits in between,
+// so no memory access or branch depends on the data.
+static uint64_t _gcm_bmul64(uint64_t x, uint64_t y) {
+    uint64_t x0, x1, x2, x3;
+    uint64_t y0, y1, y2, y3;
+    uint64_t z0, z1, z2, z3;
+
+    x0 = x & 0x1111111111111111ull;
+    x1 = x & 0x2222222222222222ull;
+    x2 = x & 0x4444444444444444ull;
+    x3 = x & 0x8888888888888888ull;
+    y0 = y & 0x1111111111111111ull;
+    y1 = y & 0x2222222222222222ull;
+    y2 = y & 0x4444444444444444ull;
+    y3 = y & 0x8888888888888888ull;
+
+    z0 = (x0 * y0) ^ (x1 * y3) ^ (x2 * y2) ^ (x3 * y1);
+    z1 = (x0 * y1) ^ (x1 * y0) ^ (x2 * y3) ^ (x3 * y2);
+    z2 = (x0 * y2) ^ (x1 * y1) ^ (x2 * y0) ^ (x3 * y3);
+    z3 = (x0 * y3) ^ (x1 * y2) ^ (x2 * y1) ^ (x3 * y0);
+
+    z0 &= 0x1111111111111111ull;
+    z1 &= 0x2222222222222222ull;
+    z2 &= 0x4444444444444444ull;
+    z3 &= 0x8888888888888888ull;
+
+    return z0 | z1 | z2 | z3;
+}
+
+static uint64_t _gcm_rev64(uint64_t x) {
+    x = ((x & 0x5555555555555555ull) << 1) | ((x >> 1) & 0x5555555555555555ull);
+    x = ((x & 0x3333333333333333ull) << 2) | ((x >> 2) & 0x3333333333333333ull);
+    x = ((x & 0x0F0F0F0F0F0F0F0Full) << 4) | ((x >> 4) & 0x0F0F0F0F0F0F0F0Full);
+    x = ((x & 0x00FF00FF00FF00FFull) << 8) | ((x >> 8) & 0x00FF00FF00FF00FFull);
+    x = ((x & 0x0000FFFF0000FFFFull) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFull);
+
+    return (x << 32) | (x >> 32);
+}
+
+// Portable constant-time GHASH. Karatsuba over the two 64 bit halves, the high
+// halves of the products from the bit reversed operands, then the reduction
+// modulo x^128 + x^7 + x^2 + x + 1 in the bit reflected order of GCM.
+static void _gcm_ghash_ctmul64(uint8_t *restrict y, const uint8_t *restrict hashKey, const uint8_t *restrict data, size_t blocks) {
+    size_t i;
+    uint64_t y0, y1, y2, y0r, y1r, y2r;
+    uint64_t h0, h1, h2, h0r, h1r, h2r;
+    uint64_t z0, z1, z2, z0h, z1h, z2h;
+    uint64_t v0, v1, v2, v3;
+
+    y1 = _gcm_load64(y);
+    y0 = _gcm_load64(y+8);
+    h1 = _gcm_load64(hashKey);
+    h0 = _gcm_load64(hashKey+8);
+    h0r = _gcm_rev64(h0);
+    h1r = _gcm_rev64(h1);
+    h2 = h0 ^ h1;
+    h2r = h0r ^ h1r;
+
+    for (i = 0; i < blocks; i++) {
+        y1 ^= _gcm_load64(data+i*GCM_BLOCK_CHARS);
+        y0 ^= _gcm_load64(data+i*GCM_BLOCK_CHARS+8);
+        y0r = _gcm_rev64(y0);
+        y1r = _gcm_rev64(y1);
+        y2 = y0 ^ y1;
+        y2r = y0r ^ y1r;
+
+        z0 = _gcm_bmul64(y0, h0);
+        z1 = _gcm_bmul64(y1, h1);
+        z2 = _gcm_bmul64(y2, h2);
+        z0h = _gcm_bmul64(y0r, h0r);
+        z1h = _gcm_bmul64(y1r, h1r);
+        z2h = _gcm_bmul64(y2r, h2r);
+        z2 ^= z0 ^ z1;
+        z2h ^= z0h ^ z1h;
+        z0h = _gcm_rev64(z0h) >> 1;
+        z1h = _gcm_rev64(z1h) >> 1;
+        z2h = _gcm_rev64(z2h) >> 1;
+
+        v0 = z0;
+        v1 = z0h ^ z2;
+        v2 = z1 ^ z2h;
+        v3 = z1h;
+
+        v3 = (v3 << 1) | (v2 >> 63);
+        v2 = (v2 << 1) | (v1 >> 63);
+        v1 = (v1 << 1) | (v0 >> 63);
+        v0 = (v0 << 1);
+
+        v2 ^= v0 ^ (v0 >> 1) ^ (v0 >> 2) ^ (v0 >> 7);
+        v1 ^= (v0 << 63) ^ (v0 << 62) ^ (v0 << 57);
+        v3 ^= v1 ^ (v1 >> 1) ^ (v1 >> 2) ^ (v1 >> 7);
+        v2 ^= (v1 << 63) ^ (v1 << 62) ^ (v1 << 57);
+
+        y0 = v2;
+        y1 = v3;
+    }
+
+    _gcm_store64(y, y1);
+    _gcm_store64(y+8, y0);
+}
+
+#ifdef __ENC_GCM_X86__
+    // GHASH with PCLMULQDQ on byte reversed blocks, after Gueron and Kounavis,
+    // Intel carry-less multiplication instruction and its usage for computing the GCM mode
+    __attribute__((target("pclmul,ssse3")))
+    static inline __m128i _gcm_multiply_pclmul(__m128i a, __m128i b) {
+        __m128i t2, t3, t4, t5, t6, t7, t8, t9;
+
+        t3 = _mm_clmulepi64_si128(a, b, 0x00);
+        t4 = _mm_clmulepi64_si128(a, b, 0x10);
+        t5 = _mm_clmulepi64_si128(a, b, 0x01);
+        t6 = _mm_clmulepi64_si128(a, b, 0x11);
+
+        t4 = _mm_xor_si128(t4, t5);
+        t5 = _mm_slli_si128(t4, 8);
+        t4 = _mm_srli_si128(t4, 8);
+        t3 = _mm_xor_si128(t3, t5);
+        t6 = _mm_xor_si128(t6, t4);
+
+        // The 256 bit product one bit left, for the reflected order
+        t7 = _mm_srli_epi32(t3, 31);
+        t8 = _mm_srli_epi32(t6, 31);
+        t3 = _mm_slli_epi32(t3, 1);
+        t6 = _mm_slli_epi32(t6, 1);
+        t9 = _mm_srli_si128(t7, 12);
+        t8 = _mm_slli_si128(t8, 4);
+        t7 = _mm_slli_si128(t7, 4);
+        t3 = _mm_or_si128(t3, t7);
+        t6 = _mm_or_si128(t6, t8);
+        t6 = _mm_or_si128(t6, t9);
+
+        // Reduction
+        t7 = _mm_slli_epi32(t3, 31);
+        t8 = _mm_slli_epi32(t3, 30);
+        t9 = _mm_slli_epi32(t3, 25);
+        t7 = _mm_xor_si128(t7, t8);
+        t7 = _mm_xor_si128(t7, t9);
+        t8 = _mm_srli_si128(t7, 4);
+        t7 = _mm_slli_si128(t7, 12);
+        t3 = _mm_xor_si128(t3, t7);
+
+        t2 = _mm_srli_epi32(t3, 1);
+        t4 = _mm_srli_epi32(t3, 2);
+        t5 = _mm_srli_epi32(t3, 7);
+        t2 = _mm_xor_si128(t2, t4);
+        t2 = _mm_xor_si128(t2, t5);
+        t2 = _mm_xor_si128(t2, t8);
+        t3 = _mm_xor_si128(t3, t2);
+        t6 = _mm_xor_si128(t6, t3);
+
+        return t6;
+    }
+
+    __attribute__((target("pclmul,ssse3")))
+    static void _gcm_ghash_pclmul(uint8_t *restrict y, const uint8_t *restrict hashKey, const uint8_t *restrict data, size_t blocks) {
+        size_t i;
+
+        __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        __m128i h = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) hashKey), reverse);
+        __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) y), reverse);
+
+        for (i = 0; i < blocks; i++) {
+            x = _mm_xor_si128(x, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data+i*GCM_BLOCK_CHARS)), reverse));
+            x = _gcm_multiply_pclmul(x, h);
+        }
+
+        _mm_storeu_si128((__m128i *) y, _mm_shuffle_epi8(x, reverse));
+    }
+#endif
+
+// Picks the backend, once
+static void _gcm_setup() {
+    ghashKernel = _gcm_ghash_ctmul64;
+
+    #ifdef __ENC_GCM_X86__
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3")) {
+            ghashKernel = _gcm_ghash_pclmul;
+            gcm_name = "pclmul";
+        }
+    #endif
+
+    #ifndef __ENC_NO_PRINTS__
+        printf("GHASH backend: %s\n", gcm_name);
+    #endif
+}
+
+// GHASH of size bytes, the last block padded with zeros
+static void _gcm_ghash(uint8_t *restrict y, const uint8_t *restrict hashKey, const uint8_t *restrict data, size_t size) {
+    size_t blocks = size/GCM_BLOCK_CHARS;
+
+    uint8_t last[GCM_BLOCK_CHARS];
+
+    ghashKernel(y, hashKey, data, blocks);
+
+    if (size % GCM_BLOCK_CHARS) {
+        memset(last, 0, GCM_BLOCK_CHARS);
+        memcpy(last, data+blocks*GCM_BLOCK_CHARS, size % GCM_BLOCK_CHARS);
+        ghashKernel(y, hashKey, last, 1);
+    }
+}
+
+// Keystream from inc32(J0) on, J0 being the IV with a big endian block counter of 1
+static void _gcm_crypt(const struct ctr_key *restrict key, const uint8_t *restrict counterBlock, const uint8_t *restrict input, uint8_t *restrict output, size_t offset, size_t length) {
+    size_t i;
+
+    uint8_t keystream[GCM_BATCH_BLOCKS*GCM_BLOCK_CHARS];
+
+    ctr_blocks(key, counterBlock, (uint32_t) (2 + offset/GCM_BLOCK_CHARS), CTR_BIG_ENDIAN, (length + GCM_BLOCK_CHARS - 1)/GCM_BLOCK_CHARS, keystream);
+
+    for (i = 0; i < length; i++)
+        output[offset+i] = input[offset+i] ^ keystream[i];
+}
+
+// The lengths block, then the hash masked with E(K, J0)
+static void _gcm_tag(const struct ctr_key *restrict key, const uint8_t *restrict hashKey, const uint8_t *restrict counterBlock, uint8_t *restrict y, size_t aadSize, size_t size, uint8_t *restrict tag) {
+    int i;
+
+    uint8_t lengths[GCM_BLOCK_CHARS];
+    uint8_t mask[GCM_BLOCK_CHARS];
+
+    _gcm_store64(lengths, (uint64_t) aadSize*8);
+    _gcm_store64(lengths+8, (uint64_t) size*8);
+    ghashKernel(y, hashKey, lengths, 1);
+
+    ctr_blocks(key, counterBlock, 1, CTR_BIG_ENDIAN, 1, mask);
+
+    for (i = 0; i < GCM_TAG_CHARS; i++)
+        tag[i] = y[i] ^ mask[i];
+}
+
+void gcm_hashKey(const struct ctr_key *restrict key, uint8_t *restrict hashKey) {
+    uint8_t zero[GCM_BLOCK_CHARS];
+
+    if (ghashKernel == NULL)
+        _gcm_setup();
+
+    // A zero block with a zero counter is the zero block
+    memset(zero, 0, GCM_BLOCK_CHARS);
+    ctr_blocks(key, zero, 0, CTR_BIG_ENDIAN, 1, hashKey);
+}
+
+void gcm_encrypt(const struct ctr_key *restrict key, const uint8_t *restrict hashKey, const uint8_t *restrict iv, const uint8_t *restrict aad, size_t aadSize, const uint8_t *restrict input, uint8_t *restrict output, size_t size, uint8_t *restrict tag) {
+    size_t offset;
+    size_t length;
+
+    uint8_t counterBlock[GCM_BLOCK_CHARS];
+    uint8_t y[GCM_BLOCK_CHARS];
+
+    memcpy(counterBlock, iv, GCM_IV_CHARS);
+    memset(counterBlock+GCM_IV_CHARS, 0, GCM_BLOCK_CHARS-GCM_IV_CHARS);
+    memset(y, 0, GCM_BLOCK_CHARS);
+
+    _gcm_ghash(y, hashKey, aad, aadSize);
+
+    // Batches are whole blocks but the last, so the hash pads only at the end
+    for (offset = 0; offset < size; offset += length) {
+        length = size - offset;
+        if (length > GCM_BATCH_BLOCKS*GCM_BLOCK_CHARS)
+            length = GCM_BATCH_BLOCKS*GCM_BLOCK_CHARS;
+
+        _gcm_crypt(key, counterBlock, input, output, offset, length);
+        _gcm_ghash(y, hashKey, output+offset, length);
+    }
+
+    _gcm_tag(key, hashKey, counterBlock, y, aadSize, size, tag);
+}
+
+int gcm_decrypt(const struct ctr_key *restrict key, const uint8_t *restrict hashKey, const uint8_t *restrict iv, const uint8_t *restrict aad, size_t aadSize, const uint8_t *restrict input, uint8_t *restrict output, size_t size, const uint8_t *restrict tag) {
+    size_t offset;
+    size_t length;
+    size_t i;
+
+    uint8_t counterBlock[GCM_BLOCK_CHARS];
+    uint8_t y[GCM_BLOCK_CHARS];
+    uint8_t expectedTag[GCM_TAG_CHARS];
+    uint8_t difference = 0;
+
+    memcpy(counterBlock, iv, GCM_IV_CHARS);
+    memset(counterBlock+GCM_IV_CHARS, 0, GCM_BLOCK_CHARS-GCM_IV_CHARS);
+    memset(y, 0, GCM_BLOCK_CHARS);
+
+    _gcm_ghash(y, hashKey, aad, aadSize);
+    _gcm_ghash(y, hashKey, input, size);
+    _gcm_tag(key, hashKey, counterBlock, y, aadSize, size, expectedTag);
+
+    for (i = 0; i < GCM_TAG_CHARS; i++)
+        difference |= expectedTag[i] ^ tag[i];
+    if (difference != 0)
+        return -1;
+
+    for (offset = 0; offset < size; offset += length) {
+        length = size - offset;
+        if (length > GCM_BATCH_BLOCKS*GCM_BLOCK_CHARS)
+            length = GCM_BATCH_BLOCKS*GCM_BLOCK_CHARS;
+
+        _gcm_crypt(key, counterBlock, input, output, offset, length);
+    }
+
+    return 0;
+}
+
+const char *gcm_backend() {
+    return gcm_name;
+}
@@ -0,0 +1,27 @@
+#ifndef __ENC_GCM_H__
+#define __ENC_GCM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ctr.h"
+
+// AES-GCM (NIST SP 800-38D) with 96 bit IVs and full 128 bit tags
+#define GCM_BLOCK_CHARS 16
+#define GCM_IV_CHARS    12
+#define GCM_TAG_CHARS   16
+
+// The hash key H = E(K, 0^128), picking the GHASH backend on the first call
+void gcm_hashKey(const struct ctr_key *restrict key, uint8_t *restrict hashKey);
+
+// Encrypts size bytes and tags them together with aadSize bytes of aad, keystream,
+// encryption and GHASH running over the data once, a batch of blocks at a time
+void gcm_encrypt(const struct ctr_key *restrict key, const uint8_t *restrict hashKey, const uint8_t *restrict iv, const uint8_t *restrict aad, size_t aadSize, const uint8_t *restrict input, uint8_t *restrict output, size_t size, uint8_t *restrict tag);
+
+// Checks the tag in constant time and only then decrypts, returns 0 if it matches.
+// On a mismatch output is left untouched.
+int gcm_decrypt(const struct ctr_key *restrict key, const uint8_t *restrict hashKey, const uint8_t *restrict iv, const uint8_t *restrict aad, size_t aadSize, const uint8_t *restrict input, uint8_t *restrict output, size_t size, const uint8_t *restrict tag);
+
+const char *gcm_backend();
+
+#endif
@@ -4,6 +4,26 @@
 #define BUFFERSIZE_4 10
 #define BUFFERSIZE_8 5
 
+/* frame length in temporal sample positions, set at runtime: a multiple of 4 for the two QMF stages */
+#define MIN_FRAMESIZE 20
+#define MAX_FRAMESIZE 2048
+#define MAX_BUFFERSIZE (2*MAX_FRAMESIZE)
+
+/* channels are coded independently on a planar layout */
+#define MAX_CHANNELS 8
+
+/* spans of fewer temporal samples than this are coded on the calling thread: waking the workers costs more than it saves */
+#define PARALLEL_FRAMESIZE 256
+
+/* worker threads for the channels, POSIX hosts only */
+#if defined(__unix__) || defined(__APPLE__)
+#define ENC_THREADS
+#endif
+#define MAX_WORKERS (MAX_CHANNELS - 1)
+
+/* decoders that may run over one span at once, see decode_segments() */
+#define MAX_SEGMENTS (MAX_WORKERS + 1)
+
 #define INPUTWAVFILE  "input.wav"
 #define OUTPUTWAVFILE "output.wav"
 
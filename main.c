@@ -10,8 +10,19 @@
 #include "wavpcm_io.h"
 #include "globals.h"
 #include "codec.h"
+#include "profile.h"
+#include "quantizer.h"
+#include "dtx.h"
+#include "stereo.h"
+#include "filterbank.h"
 #include "encode.h"
 #include "decode.h"
+#include "bitstream.h"
+#include "workers.h"
+
+#ifndef MIN
+    #define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
 
 void _handshake();
 void _transmit();
@@ -20,18 +31,82 @@ enum state handshakeState;
 
 int main(int argc, char **argv) {
 	size_t bufPos;
+	size_t bufOffset;
+	size_t bufBytes;
 	size_t read;
-
-	short buffer[BUFFERSIZE];
-	short encoded[BUFFERSIZE];
+	short frameSize;
+	short channel;
+	short flags;
+	short lost;
+	short depth;
+	int option;
+	const struct profile_struct *profile;
+	const struct qmf_struct *qmf;
+
+	/* planar: one buffer per channel */
+	static short buffer[MAX_CHANNELS][MAX_FRAMESIZE];
+	static short encoded[MAX_CHANNELS*MAX_FRAMESIZE];
+	static short received[MAX_CHANNELS*MAX_FRAMESIZE];
+	short *buffers[MAX_CHANNELS];
 
 	struct wavpcm_input input;
 	struct wavpcm_output output;
 
-	struct decode_chunk_struct decode_chunk_left;
-	struct decode_chunk_struct decode_chunk_right;
-	struct encode_chunk_struct encode_chunk_left;
-	struct encode_chunk_struct encode_chunk_right;
+	static struct decode_chunk_struct decode_chunk[MAX_CHANNELS];
+	static struct encode_chunk_struct encode_chunk[MAX_CHANNELS];
+	struct decode_chunk_struct *decode_chunks[MAX_CHANNELS];
+	struct encode_chunk_struct *encode_chunks[MAX_CHANNELS];
+
+	/* frame length in temporal sample positions */
+	frameSize = (argc > 1) ? (short) atoi(argv[1]) : BUFFERSIZE/2;
+	if (frameSize < MIN_FRAMESIZE || frameSize > MAX_FRAMESIZE || (frameSize & 3)) {
+		printf("Error: frame size must be a multiple of 4 between %d and %d.\n", MIN_FRAMESIZE, MAX_FRAMESIZE);
+		exit(1);
+	}
+
+	/* codec options, the filter bank by name and the subband tree depth */
+	flags = 0;
+	depth = PROFILE_DEPTH;
+	qmf = &qmf_filters[QMF_DEFAULT];
+	for (option = 3; option < argc; option++) {
+		if (strcmp(argv[option], "entropy") == 0) {
+			flags |= CODEC_ENTROPY;
+		} else if (strcmp(argv[option], "dtx") == 0) {
+			flags |= CODEC_DTX;
+		} else if (strcmp(argv[option], "sync") == 0) {
+			flags |= CODEC_SYNC;
+		} else if (strcmp(argv[option], "lifting") == 0) {
+			flags |= CODEC_LIFTING;
+		} else if (strcmp(argv[option], "joint") == 0) {
+			flags |= CODEC_JOINT;
+		} else if (qmf_find(argv[option]) != NULL) {
+			qmf = qmf_find(argv[option]);
+		} else if (strcmp(argv[option], "bands2") == 0) {
+			depth = 1;
+		} else if (strcmp(argv[option], "bands4") == 0) {
+			depth = 2;
+		} else if (strcmp(argv[option], "bands8") == 0) {
+			depth = 3;
+		} else if (strcmp(argv[option], "bands16") == 0) {
+			depth = 4;
+		} else {
+			printf("Error: unknown option %s, expected entropy, dtx, sync, lifting, joint, qmf8, qmf16, qmf20, qmf32, qmf64 or bands2, bands4, bands8, bands16.\n", argv[option]);
+			exit(1);
+		}
+	}
+
+	/* bit allocation, by name, for the tree */
+	profile = profile_find((argc > 2) ? argv[2] : profiles[PROFILE_DEFAULT].name, depth);
+	if (profile == NULL) {
+		printf("Error: unknown profile %s, expected low, default or high.\n", argv[2]);
+		exit(1);
+	}
+
+	/* every group of four lanes takes whole steps */
+	if ((frameSize % (GROUPS(depth) << 2)) || frameSize < MIN_FRAMESIZE * GROUPS(depth)) {
+		printf("Error: frame size must be a multiple of %d of at least %d for %d subbands.\n", GROUPS(depth) << 2, MIN_FRAMESIZE * GROUPS(depth), 1 << depth);
+		exit(1);
+	}
 
     // Initializations
     srand(time(NULL));
@@ -42,6 +117,7 @@ int main(int argc, char **argv) {
     channel_construct();
     sender_construct();
     receiver_construct();
+    filterbank_construct();
 
     // Handshake
 	#ifndef __ENC_NO_PRINTS__
@@ -59,51 +135,55 @@ int main(int argc, char **argv) {
 	memset(&output, 0, sizeof(struct wavpcm_output));
 	output.resource = OUTPUTWAVFILE;
 
-	/* initialize structs */
-    memset(&encode_chunk_left, 0, sizeof(struct encode_chunk_struct));
-    memset(&encode_chunk_right, 0, sizeof(struct encode_chunk_struct));
-    memset(&decode_chunk_left, 0, sizeof(struct decode_chunk_struct));
-    memset(&decode_chunk_right, 0, sizeof(struct decode_chunk_struct));
-
-    /* initializing for quantisation */
-    encode_chunk_left.Qstep[0] = QSTART;
-    encode_chunk_right.Qstep[0] = QSTART;
-    decode_chunk_left.Qstep[0] = QSTART;
-    decode_chunk_right.Qstep[0] = QSTART;
-    encode_chunk_left.Qstep[1] = QSTART;
-    encode_chunk_right.Qstep[1] = QSTART;
-    decode_chunk_left.Qstep[1] = QSTART;
-    decode_chunk_right.Qstep[1] = QSTART;
-    encode_chunk_left.Qstep[2] = QSTART;
-    encode_chunk_right.Qstep[2] = QSTART;
-    decode_chunk_left.Qstep[2] = QSTART;
-    decode_chunk_right.Qstep[2] = QSTART;
-    encode_chunk_left.Qstep[3] = QSTART;
-    encode_chunk_right.Qstep[3] = QSTART;
-    decode_chunk_left.Qstep[3] = QSTART;
-    decode_chunk_right.Qstep[3] = QSTART;
-
 	wavpcm_input_open(&input);
 	wavpcm_output_copy_settings(&input, &output);
 	wavpcm_output_open(&output);
 
-	for (bufPos = 0; bufPos < input.samplesAvailable ; bufPos += (BUFFERSIZE/2)) {
-		read = wavpcm_input_read(&input, buffer);
-		encode(buffer, &encode_chunk_left, &encode_chunk_right, encoded);
-
-		while (buffer_isModified()) {}
-		buffer_write((field_t *) buffer, BUFFERSIZE*sizeof(short));
-
-		_transmit();
-		receiver_receiveData();
-
-		buffer_read((field_t *) buffer, BUFFERSIZE*sizeof(short));
+	/* initialize structs */
+	for (channel = 0; channel < input.channels; channel++) {
+		buffers[channel] = buffer[channel];
+		encode_chunks[channel] = &encode_chunk[channel];
+		decode_chunks[channel] = &decode_chunk[channel];
+		encode_construct(encode_chunks[channel], frameSize, profile, qmf, flags);
+		decode_construct(decode_chunks[channel], frameSize, profile, qmf, flags);
+	}
 
-		decode(&decode_chunk_left, &decode_chunk_right, encoded, buffer);
-		wavpcm_output_write(&output, buffer, read);
+	/* tasks are channel pairs and the calling thread codes one as well */
+	workers_construct((input.channels + 1) / 2 - 1);
+
+	for (bufPos = 0; bufPos < input.samplesAvailable ; bufPos += frameSize) {
+		read = wavpcm_input_read(&input, buffers, frameSize);
+		/* only the bitstream goes on the channel */
+		bufBytes = encode(buffers, encode_chunks, input.channels, encoded)*sizeof(short);
+
+		/* a frame without data is not sent, the receiver decodes its zero header and stereo word */
+		if ((flags & CODEC_DTX) && encoded[0] == DTX_NODATA) {
+			bufBytes = 0;
+			received[0] = DTX_NODATA;
+			received[1] = STEREO_LR;
+		}
+
+		/* frames larger than a data packet go out in several packets */
+		lost = 0;
+		for (bufOffset = 0; bufOffset < bufBytes; bufOffset += ENC_BUFFER_CHARS) {
+			while (buffer_isModified()) {}
+			buffer_write((field_t *) encoded + bufOffset, MIN(ENC_BUFFER_CHARS, bufBytes - bufOffset));
+
+			_transmit();
+
+			/* a rejected packet loses its frame, which the decoder conceals */
+			if (ENC_ACCEPT_PACKET == receiver_receiveData())
+				buffer_read((field_t *) received + bufOffset, MIN(ENC_BUFFER_CHARS, bufBytes - bufOffset));
+			else
+				lost = 1;
+		}
+
+		decode(decode_chunks, input.channels, lost ? NULL : received, buffers);
+		wavpcm_output_write(&output, buffers, read);
 	}
 
 	wavpcm_output_close(&output);
+	workers_destruct();
 
     exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,102 @@
+#include <string.h>
+#include "globals.h"
+#include "codec.h"
+#include "profile.h"
+
+#define MIN_LEVEL(n) ((n) > 0 ? -(1 << ((n) - 1)) : 0)
+#define MAX_LEVEL(n) ((n) > 0 ? (1 << ((n) - 1)) - 1 : 0)
+#define LEVELS(n1, n2, n3, n4) \
+    {MIN_LEVEL(n1), MIN_LEVEL(n2), MIN_LEVEL(n3), MIN_LEVEL(n4)}, \
+    {MAX_LEVEL(n1), MAX_LEVEL(n2), MAX_LEVEL(n3), MAX_LEVEL(n4)}
+
+/* PHI scales the mean dequantised difference to the next step size, so it
+ * roughly halves for every bit added to a subband */
+const struct profile_struct profiles[PROFILE_COUNT] = {
+    {"low", 2, {4, 2, 2, 0}, {4424, 8684, 10650, 13107}, {1024, 4096, 8192, 8192}, {MU_1, MU_2, MU_3, MU_4}, LEVELS(4, 2, 2, 0)},
+    {"default", 2, {5, 3, 2, 2}, {2212, 4342, 10650, 13107}, {1024, 4096, 8192, 8192}, {MU_1, MU_2, MU_3, MU_4}, LEVELS(5, 3, 2, 2)},
+    {"high", 2, {6, 4, 3, 3}, {1106, 2171, 5325, 6554}, {1024, 4096, 8192, 8192}, {MU_1, MU_2, MU_3, MU_4}, LEVELS(6, 4, 3, 3)}
+};
+
+/* The profiles of other depths follow the rule that gives profiles[], on the
+ * standard speech spectrum of ANSI S3.5 (normal effort): the bits of every
+ * depth go to the subbands by the RMS of that spectrum in them, each bit halving
+ * the error, no subband taking a single bit or more than six. The rule gives the
+ * bits of profiles[] and of depth one; mu is the correlation of a lane with the
+ * sample it predicts from under the same spectrum. PHI and qmax follow the bits
+ * as in profiles[], with qmax halved per level below two. */
+
+/* Two subbands take alternate positions of the four lanes, each lane predicting
+ * from the position before the last */
+static const struct profile_struct profiles_1[PROFILE_COUNT] = {
+    {"low", 1, {4, 0, 4, 0}, {4424, 13107, 4424, 13107}, {4096, 8192, 4096, 8192}, {21107, -10846, 21107, -10846}, LEVELS(4, 0, 4, 0)},
+    {"default", 1, {4, 2, 4, 2}, {4424, 10650, 4424, 10650}, {4096, 8192, 4096, 8192}, {21107, -10846, 21107, -10846}, LEVELS(4, 2, 4, 2)},
+    {"high", 1, {5, 3, 5, 3}, {2212, 5325, 2212, 5325}, {2048, 8192, 2048, 8192}, {21107, -10846, 21107, -10846}, LEVELS(5, 3, 5, 3)}
+};
+
+/* Subband b of eight or sixteen is lane b & 3 of group b >> 2 */
+static const struct profile_struct profiles_3[PROFILE_COUNT][2] = {
+    {{"low", 3, {5, 4, 2, 3}, {2212, 4424, 10650, 5325}, {2048, 4096, 4096, 4096}, {-8519, -13768, -5469, 6165}, LEVELS(5, 4, 2, 3)},
+     {"low", 3, {0, 0, 2, 0}, {13107, 13107, 10650, 13107}, {4096, 4096, 4096, 4096}, {-1895, 2067, 6255, -1964}, LEVELS(0, 0, 2, 0)}},
+    {{"default", 3, {5, 5, 3, 3}, {2212, 2212, 5325, 5325}, {2048, 2048, 4096, 4096}, {-8519, -13768, -5469, 6165}, LEVELS(5, 5, 3, 3)},
+     {"default", 3, {2, 2, 2, 2}, {10650, 10650, 10650, 10650}, {4096, 4096, 4096, 4096}, {-1895, 2067, 6255, -1964}, LEVELS(2, 2, 2, 2)}},
+    {{"high", 3, {6, 6, 4, 5}, {1106, 1106, 4424, 2212}, {1024, 1024, 4096, 2048}, {-8519, -13768, -5469, 6165}, LEVELS(6, 6, 4, 5)},
+     {"high", 3, {2, 3, 3, 3}, {10650, 5325, 5325, 5325}, {4096, 4096, 4096, 4096}, {-1895, 2067, 6255, -1964}, LEVELS(2, 3, 3, 3)}}
+};
+
+static const struct profile_struct profiles_4[PROFILE_COUNT][4] = {
+    {{"low", 4, {4, 5, 3, 4}, {4424, 2212, 5325, 4424}, {2048, 2048, 2048, 2048}, {-16024, 220, -6464, 7239}, LEVELS(4, 5, 3, 4)},
+     {"low", 4, {2, 2, 3, 3}, {10650, 10650, 5325, 5325}, {2048, 2048, 2048, 2048}, {-2584, 2880, 3065, -3209}, LEVELS(2, 2, 3, 3)},
+     {"low", 4, {0, 0, 0, 0}, {13107, 13107, 13107, 13107}, {2048, 2048, 2048, 2048}, {-917, 980, 954, -1053}, LEVELS(0, 0, 0, 0)},
+     {"low", 4, {2, 2, 0, 2}, {10650, 10650, 13107, 10650}, {2048, 2048, 2048, 2048}, {3330, -2981, -938, 1027}, LEVELS(2, 2, 0, 2)}},
+    {{"default", 4, {5, 5, 4, 5}, {2212, 2212, 4424, 2212}, {2048, 2048, 2048, 2048}, {-16024, 220, -6464, 7239}, LEVELS(5, 5, 4, 5)},
+     {"default", 4, {3, 3, 4, 3}, {5325, 5325, 4424, 5325}, {2048, 2048, 2048, 2048}, {-2584, 2880, 3065, -3209}, LEVELS(3, 3, 4, 3)},
+     {"default", 4, {2, 2, 2, 2}, {10650, 10650, 10650, 10650}, {2048, 2048, 2048, 2048}, {-917, 980, 954, -1053}, LEVELS(2, 2, 2, 2)},
+     {"default", 4, {2, 2, 2, 2}, {10650, 10650, 10650, 10650}, {2048, 2048, 2048, 2048}, {3330, -2981, -938, 1027}, LEVELS(2, 2, 2, 2)}},
+    {{"high", 4, {6, 6, 5, 6}, {1106, 1106, 2212, 1106}, {1024, 1024, 2048, 1024}, {-16024, 220, -6464, 7239}, LEVELS(6, 6, 5, 6)},
+     {"high", 4, {4, 4, 5, 4}, {4424, 4424, 2212, 4424}, {2048, 2048, 2048, 2048}, {-2584, 2880, 3065, -3209}, LEVELS(4, 4, 5, 4)},
+     {"high", 4, {2, 3, 3, 3}, {10650, 5325, 5325, 5325}, {2048, 2048, 2048, 2048}, {-917, 980, 954, -1053}, LEVELS(2, 3, 3, 3)},
+     {"high", 4, {4, 3, 3, 3}, {4424, 5325, 5325, 5325}, {2048, 2048, 2048, 2048}, {3330, -2981, -938, 1027}, LEVELS(4, 3, 3, 3)}}
+};
+
+const struct profile_struct *profile_find(const char *name, short depth)
+{
+    short i;
+
+    for (i = 0 ; i < PROFILE_COUNT ; i++) {
+        if (strcmp(profiles[i].name, name) != 0)
+            continue;
+
+        switch (depth) {
+            case 1: return &profiles_1[i];
+            case 2: return &profiles[i];
+            case 3: return profiles_3[i];
+            case 4: return profiles_4[i];
+        }
+    }
+
+    return NULL;
+}
+
+short profile_index(const struct profile_struct *profile)
+{
+    short i;
+
+    for (i = 0 ; i < PROFILE_COUNT ; i++) {
+        if (profile_find(profiles[i].name, profile->depth) == profile)
+            return i;
+    }
+
+    return -1;
+}
+
+const struct profile_struct *profile_side(const struct profile_struct *profile)
+{
+    short i;
+
+    for (i = 1 ; i < PROFILE_COUNT ; i++) {
+        if (strcmp(profiles[i].name, profile->name) == 0)
+            return profile_find(profiles[i - 1].name, profile->depth);
+    }
+
+    return profile_find(profiles[0].name, profile->depth);
+}
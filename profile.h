@@ -0,0 +1,56 @@
+#ifndef __ENC_PROFILE_H__
+#define __ENC_PROFILE_H__
+
+/* Bit allocation profiles.
+ *
+ * A profile fixes the number of bits of each of the four subbands, which in
+ * turn fixes the level range [-2^(n-1), 2^(n-1) - 1] of the quantiser, and the
+ * step size adaptation tuned for it. A subband with 0 bits is not transmitted
+ * and decodes as silence. Encoder and decoder of a stream must use the same
+ * profile for all of its channels.
+ *
+ * The profile also fixes the depth of the subband tree. A profile of more than
+ * four subbands is GROUPS(depth) consecutive profile_structs, one per 4-lane
+ * group in the layout of codec.h; one of two subbands uses two lanes each.
+ * Every depth keeps the bits per temporal sample of its name. */
+#define PROFILE_LOW 0 /*[4,2,2,0], 8 bits per 4 samples*/
+#define PROFILE_DEFAULT 1 /*[5,3,2,2], 12 bits per 4 samples*/
+#define PROFILE_HIGH 2 /*[6,4,3,3], 16 bits per 4 samples*/
+#define PROFILE_COUNT 3
+
+/*Tree depth of profiles[]*/
+#define PROFILE_DEPTH 2
+
+/*Widest subband the quantiser kernels support*/
+#define MAX_NBITS 6
+
+struct profile_struct {
+    const char *name;
+
+    /*Subband tree levels, the same in every group*/
+    short depth;
+
+    short nbits[4];
+
+    /*Quantiser step size adaptation and upper limit; level*qmax must fit a short*/
+    short phi[4];
+    short qmax[4];
+
+    /*Prediction from the last reconstructed sample, scaled with 2^15*/
+    short mu[4];
+
+    short minLevel[4];
+    short maxLevel[4];
+};
+
+extern const struct profile_struct profiles[PROFILE_COUNT];
+
+/* Returns the profile called name for a tree of depth levels, or NULL */
+const struct profile_struct *profile_find(const char *name, short depth);
+/* Returns the number in profiles[] of the name profile_find() returns profile for, or -1 */
+short profile_index(const struct profile_struct *profile);
+/* Returns the profile of the side channel of a stream with the given one, see
+ * stereo.h: the next smaller profile of the same depth, or the smallest */
+const struct profile_struct *profile_side(const struct profile_struct *profile);
+
+#endif
@@ -10,10 +10,11 @@ void senderHello(field_t *restrict sendPacket, digit_t *restrict senderModExp, d
     mpModExp(modExpResult, Enc_GeneratorDigits, senderSecret, Enc_PrimeDigits, ENC_PRIVATE_KEY_DIGITS);
     sendPacket[0] = 0x00;
     memcpy(sendPacket+1, modExpResult, ENC_PRIVATE_KEY_CHARS);
+    sendPacket[ENC_KEY_SUITE_OFFSET] = ENC_SUITES;
     memcpy(senderModExp, modExpResult, ENC_PRIVATE_KEY_DIGITS*sizeof(digit_t));
 }
 
-int receiverHello(field_t *restrict sendPacket, digit_t *restrict receiverModExp, field_t *restrict receivedPacket, digit_t *restrict receiverSecret, digit_t *restrict senderModExp, unsigned char *restrict receiverPrivateExp) {
+int receiverHello(field_t *restrict sendPacket, digit_t *restrict receiverModExp, field_t *restrict receivedPacket, digit_t *restrict receiverSecret, digit_t *restrict senderModExp, unsigned char *restrict receiverPrivateExp, uint8_t *restrict suite) {
     if (0x00 != receivedPacket[0])
         return ENC_REJECT_PACKET_TAG;
 
@@ -25,8 +26,12 @@ int receiverHello(field_t *restrict sendPacket, digit_t *restrict receiverModExp
 
     field_t encryptedSignature[ENC_ENCRYPTED_SIGNATURE_CHARS];
 
-    uint8_t receiverCTRNonce[ENC_CTR_NONCE_CHARS];
-    uint8_t receiverAESKey[ENC_AES_KEY_CHARS];
+    struct enc_cipher_ctx receiverCipher;
+
+    // Choose a suite, the keys depend on it
+    *suite = chooseSuite(receivedPacket[ENC_KEY_SUITE_OFFSET]);
+    if (*suite == 0)
+        return ENC_SUITE_REJECTED;
 
     // Generate y
     getRandomDigit(receiverSecret);
@@ -40,7 +45,7 @@ int receiverHello(field_t *restrict sendPacket, digit_t *restrict receiverModExp
     memcpy(signatureMessage+ENC_PRIVATE_KEY_DIGITS, receiverModExp, ENC_PRIVATE_KEY_DIGITS*sizeof(digit_t));
 
     // Derive Keys
-    receiver_deriveKey(receiverAESKey, receiverCTRNonce, senderModExp);
+    receiver_deriveKey(&receiverCipher, senderModExp, receivedPacket[ENC_KEY_SUITE_OFFSET], *suite);
 
     // Create Signature
     memset(signature, 0, sizeof(signature));
@@ -54,7 +59,7 @@ int receiverHello(field_t *restrict sendPacket, digit_t *restrict receiverModExp
 
     // Encrypt Signature
     mpConvToOctets(signature, ENC_SIGNATURE_DIGITS, cSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
-    _encryptData(encryptedSignature, receiverAESKey, receiverCTRNonce, 0, cSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
+    _encryptData(encryptedSignature, &receiverCipher, 0, cSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
     #ifndef __ENC_NO_ENCRYPTION_PRINTS__
         printf("---| encyptedSignature\n");
         mpConvFromOctets(signature, ENC_ENCRYPTED_SIGNATURE_DIGITS, encryptedSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
@@ -64,11 +69,12 @@ int receiverHello(field_t *restrict sendPacket, digit_t *restrict receiverModExp
     sendPacket[0] = 0x01;
     memcpy(sendPacket+1, receiverModExp, ENC_PRIVATE_KEY_DIGITS*sizeof(digit_t));
     memcpy(sendPacket+ENC_PRIVATE_KEY_CHARS+1, encryptedSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
+    sendPacket[ENC_KEY_SUITE_OFFSET] = *suite;
 
     return ENC_ACCEPT_PACKET;
 }
 
-int senderAcknowledge(field_t *restrict sendPacket, field_t *restrict receivedPacket, digit_t *restrict senderSecret, digit_t *restrict receiverModExp, digit_t *restrict senderModExp, unsigned char *restrict senderPrivateExp) {
+int senderAcknowledge(field_t *restrict sendPacket, field_t *restrict receivedPacket, digit_t *restrict senderSecret, digit_t *restrict receiverModExp, digit_t *restrict senderModExp, unsigned char *restrict senderPrivateExp, uint8_t *restrict suite) {
     if (0x01 != receivedPacket[0])
         return ENC_REJECT_PACKET_TAG;
 
@@ -82,8 +88,13 @@ int senderAcknowledge(field_t *restrict sendPacket, field_t *restrict receivedPa
     field_t encryptedSignature[ENC_ENCRYPTED_SIGNATURE_CHARS];
 
     uint8_t signatureMessage[2*ENC_PRIVATE_KEY_CHARS];
-    uint8_t senderCTRNonce[ENC_CTR_NONCE_CHARS];
-    uint8_t senderAESKey[ENC_AES_KEY_CHARS];
+
+    struct enc_cipher_ctx senderCipher;
+
+    // The receiver has to choose exactly one of the offered suites
+    *suite = receivedPacket[ENC_KEY_SUITE_OFFSET];
+    if ((*suite & ENC_SUITES) == 0 || (*suite & (*suite - 1)) != 0)
+        return ENC_SUITE_REJECTED;
 
     mpSetZero(signature, ENC_SIGN_MODULUS_DIGITS);
 
@@ -94,7 +105,7 @@ int senderAcknowledge(field_t *restrict sendPacket, field_t *restrict receivedPa
     memcpy(signatureMessageDigits+ENC_PRIVATE_KEY_DIGITS, receiverModExp, ENC_PRIVATE_KEY_DIGITS*sizeof(digit_t));
 
     //deriveKey from receiverModExp
-    sender_deriveKey(senderAESKey, senderCTRNonce, receiverModExp);
+    sender_deriveKey(&senderCipher, receiverModExp, ENC_SUITES, *suite);
 
     // Decrypt signature
     memcpy(encryptedSignature, receivedPacket+ENC_PRIVATE_KEY_CHARS+1, ENC_ENCRYPTED_SIGNATURE_CHARS);
@@ -104,7 +115,7 @@ int senderAcknowledge(field_t *restrict sendPacket, field_t *restrict receivedPa
         mpPrintNL(signature, ENC_SIGNATURE_DIGITS);
     #endif
 
-    _decryptData(cSignature, senderAESKey, senderCTRNonce, 0, (unsigned char *) encryptedSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
+    _decryptData(cSignature, &senderCipher, 0, (unsigned char *) encryptedSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
 
     // Verify signature
     mpConvFromOctets(signature, ENC_ENCRYPTED_SIGNATURE_DIGITS, cSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
@@ -129,7 +140,7 @@ int senderAcknowledge(field_t *restrict sendPacket, field_t *restrict receivedPa
     // Encrypt signature
     memset(cSignature, 0, sizeof(cSignature));
     mpConvToOctets(signature, ENC_SIGNATURE_DIGITS, cSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
-    _encryptData(encryptedSignature, senderAESKey, senderCTRNonce, 0, cSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
+    _encryptData(encryptedSignature, &senderCipher, 0, cSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
 
     sendPacket[0] = 0x01;
     mpConvFromOctets(signature, ENC_SIGNATURE_DIGITS, encryptedSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
@@ -138,6 +149,21 @@ int senderAcknowledge(field_t *restrict sendPacket, field_t *restrict receivedPa
     return ENC_ACCEPT_PACKET;
 }
 
+// AES-GCM where AES runs on its own instructions, ChaCha20-Poly1305 where it would
+// run in software, either of them before CTR+HMAC
+uint8_t chooseSuite(uint8_t offeredSuites) {
+    if ((offeredSuites & ENC_SUITE_AES_GCM) && ctr_hardware())
+        return ENC_SUITE_AES_GCM;
+    else if (offeredSuites & ENC_SUITE_CHACHA_POLY)
+        return ENC_SUITE_CHACHA_POLY;
+    else if (offeredSuites & ENC_SUITE_AES_GCM)
+        return ENC_SUITE_AES_GCM;
+    else if (offeredSuites & ENC_SUITE_CTR_HMAC)
+        return ENC_SUITE_CTR_HMAC;
+
+    return 0;
+}
+
 int increaseCounter(uint32_t *counter) {
 	uint32_t nextValue = *counter + 1;
 
@@ -149,3 +175,56 @@ int increaseCounter(uint32_t *counter) {
 		return ENC_ACCEPT_PACKET;
 	}
 }
+
+// Session State
+size_t serializeSession(uint8_t *restrict state, uint8_t role, uint8_t suite, uint8_t *restrict aesKey, uint8_t *restrict hashKey, uint8_t *restrict CTRNonce, uint8_t *restrict chachaKey, uint32_t packetCounter, bool trusted) {
+    uint8_t *position = state;
+
+    *position++ = ENC_SESSION_VERSION;
+    *position++ = role;
+    *position++ = suite;
+
+    memcpy(position, aesKey, ENC_AES_KEY_CHARS);
+    position += ENC_AES_KEY_CHARS;
+    memcpy(position, hashKey, ENC_HMAC_KEY_CHARS);
+    position += ENC_HMAC_KEY_CHARS;
+    memcpy(position, CTRNonce, ENC_CTR_NONCE_CHARS);
+    position += ENC_CTR_NONCE_CHARS;
+    memcpy(position, chachaKey, ENC_CHACHA_KEY_CHARS);
+    position += ENC_CHACHA_KEY_CHARS;
+
+    // Big endian, so the state moves between hosts of either byte order
+    *position++ = (uint8_t) (packetCounter >> 24);
+    *position++ = (uint8_t) (packetCounter >> 16);
+    *position++ = (uint8_t) (packetCounter >> 8);
+    *position++ = (uint8_t) packetCounter;
+
+    *position++ = trusted ? 1 : 0;
+
+    return position - state;
+}
+
+int deserializeSession(uint8_t *restrict state, size_t length, uint8_t role, uint8_t *restrict suite, uint8_t *restrict aesKey, uint8_t *restrict hashKey, uint8_t *restrict CTRNonce, uint8_t *restrict chachaKey, uint32_t *restrict packetCounter, bool *restrict trusted) {
+    uint8_t *position = state + 3;
+
+    if (length < ENC_SESSION_CHARS || state[0] != ENC_SESSION_VERSION || state[1] != role || state[2] == 0 || chooseSuite(state[2]) != state[2])
+        return ENC_INVALID_STATE;
+
+    *suite = state[2];
+
+    memcpy(aesKey, position, ENC_AES_KEY_CHARS);
+    position += ENC_AES_KEY_CHARS;
+    memcpy(hashKey, position, ENC_HMAC_KEY_CHARS);
+    position += ENC_HMAC_KEY_CHARS;
+    memcpy(CTRNonce, position, ENC_CTR_NONCE_CHARS);
+    position += ENC_CTR_NONCE_CHARS;
+    memcpy(chachaKey, position, ENC_CHACHA_KEY_CHARS);
+    position += ENC_CHACHA_KEY_CHARS;
+
+    *packetCounter = ((uint32_t) position[0] << 24) | ((uint32_t) position[1] << 16) | ((uint32_t) position[2] << 8) | position[3];
+    position += 4;
+
+    *trusted = (*position != 0);
+
+    return ENC_ACCEPT_PACKET;
+}
@@ -1,6 +1,7 @@
 #ifndef __ENC_PROTOCOL_H__
 #define __ENC_PROTOCOL_H__
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -16,9 +17,13 @@
 #define ENC_DATA_SIZE_DIGITS        32
 
 // Packet Sizes
-#define ENC_KEY_PACKET_CHARS        317
+#define ENC_KEY_PACKET_CHARS        318
 #define ENC_DATA_PACKET_CHARS       ENC_DATA_SIZE_CHARS + ENC_HMAC_CHARS + 5
 #define ENC_DATA_PACKET_DIGITS      ENC_DATA_PACKET_CHARS/4
+#define ENC_AEAD_PACKET_CHARS       (ENC_DATA_SIZE_CHARS + ENC_AEAD_TAG_CHARS + 5)
+
+// Key packets carry the offered suites from the sender and the chosen one back
+#define ENC_KEY_SUITE_OFFSET        (1 + ENC_PRIVATE_KEY_CHARS + ENC_ENCRYPTED_SIGNATURE_CHARS)
 
 // Diffie-Hellman Size
 #define ENC_DH_SECRET_CHARS         20
@@ -33,13 +38,28 @@
 #define ENC_HMAC_ACCEPTED           5
 #define ENC_HMAC_REJECTED           6
 #define ENC_INVALID_ACK             7
+#define ENC_INVALID_STATE           8
+#define ENC_TAG_REJECTED            9
+#define ENC_SUITE_REJECTED          10
+
+// Session State: version, role, suite, AES key, HMAC key, CTR nonce, ChaCha20 key, packet counter (big endian) and trust
+#define ENC_SESSION_VERSION         3
+#define ENC_SESSION_SENDER          1
+#define ENC_SESSION_RECEIVER        2
+#define ENC_SESSION_CHARS           (3 + ENC_AES_KEY_CHARS + ENC_HMAC_KEY_CHARS + ENC_CTR_NONCE_CHARS + ENC_CHACHA_KEY_CHARS + 4 + 1)
 
 void senderHello(field_t *restrict sendPacket, digit_t *restrict senderModExp, digit_t *restrict senderSecret);
-int receiverHello(field_t *restrict sendPacket, digit_t *restrict receiverModExp, field_t *restrict receivedPacket, digit_t *restrict receiverSecret, digit_t *restrict senderModExp, unsigned char *restrict receiverPrivateExp);
-int senderAcknowledge(field_t *restrict SsendPacket, field_t *restrict receivedPacket, digit_t *restrict senderSecret, digit_t *restrict receiverModExp, digit_t *restrict senderModExp, unsigned char *restrict senderPrivateExp);
+int receiverHello(field_t *restrict sendPacket, digit_t *restrict receiverModExp, field_t *restrict receivedPacket, digit_t *restrict receiverSecret, digit_t *restrict senderModExp, unsigned char *restrict receiverPrivateExp, uint8_t *restrict suite);
+int senderAcknowledge(field_t *restrict SsendPacket, field_t *restrict receivedPacket, digit_t *restrict senderSecret, digit_t *restrict receiverModExp, digit_t *restrict senderModExp, unsigned char *restrict senderPrivateExp, uint8_t *restrict suite);
+
+// The preferred suite of an offer, 0 if none is supported
+uint8_t chooseSuite(uint8_t offeredSuites);
 
 void sendData(field_t *sendPacket);
 
 int increaseCounter(uint32_t *counter);
 
+size_t serializeSession(uint8_t *restrict state, uint8_t role, uint8_t suite, uint8_t *restrict aesKey, uint8_t *restrict hashKey, uint8_t *restrict CTRNonce, uint8_t *restrict chachaKey, uint32_t packetCounter, bool trusted);
+int deserializeSession(uint8_t *restrict state, size_t length, uint8_t role, uint8_t *restrict suite, uint8_t *restrict aesKey, uint8_t *restrict hashKey, uint8_t *restrict CTRNonce, uint8_t *restrict chachaKey, uint32_t *restrict packetCounter, bool *restrict trusted);
+
 #endif
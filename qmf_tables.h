@@ -0,0 +1,41 @@
+/* Generated by qmf_tables.py, do not edit.
+ *
+ * QMF prototype filters scaled with 2^15, split into polyphase branches:
+ * EVEN[k] = h[2k], ODD[k] = h[2k+1]. Synthesis uses twice the taps. */
+#ifndef __ENC_QMF_TABLES_H__
+#define __ENC_QMF_TABLES_H__
+
+/*Calls X(length) for every prototype length, shortest first*/
+#define QMF_LENGTHS(X) X(8) X(16) X(20) X(32) X(64)
+
+/*8 taps: 0.0190 dB reconstruction ripple, -35 dB above 0.85 pi*/
+#define QMF_8_ANALYSIS_EVEN {251, 2022, 16127, -2052}
+#define QMF_8_ANALYSIS_ODD {-2052, 16127, 2022, 251}
+#define QMF_8_SYNTHESIS_EVEN {502, 4044, 32254, -4104}
+#define QMF_8_SYNTHESIS_ODD {-4104, 32254, 4044, 502}
+
+/*16 taps: 0.0063 dB reconstruction ripple, -51 dB above 0.76 pi*/
+#define QMF_16_ANALYSIS_EVEN {48, -82, -371, 3286, 15730, -3010, 979, -203}
+#define QMF_16_ANALYSIS_ODD {-203, 979, -3010, 15730, 3286, -371, -82, 48}
+#define QMF_16_SYNTHESIS_EVEN {96, -164, -742, 6572, 31460, -6020, 1958, -406}
+#define QMF_16_SYNTHESIS_ODD {-406, 1958, -6020, 31460, 6572, -742, -164, 96}
+
+/*20 taps: 0.0040 dB reconstruction ripple, -59 dB above 0.75 pi*/
+#define QMF_20_ANALYSIS_EVEN {-20, 60, 0, -599, 3554, 15618, -3137, 1229, -398, 82}
+#define QMF_20_ANALYSIS_ODD {82, -398, 1229, -3137, 15618, 3554, -599, 0, 60, -20}
+#define QMF_20_SYNTHESIS_EVEN {-40, 120, 0, -1198, 7108, 31236, -6274, 2458, -796, 164}
+#define QMF_20_SYNTHESIS_ODD {164, -796, 2458, -6274, 31236, 7108, -1198, 0, 120, -40}
+
+/*32 taps: 0.0014 dB reconstruction ripple, -65 dB above 0.70 pi*/
+#define QMF_32_ANALYSIS_EVEN {-3, 0, 18, -46, 29, 173, -905, 3864, 15472, -3235, 1500, -685, 262, -72, 10, 1}
+#define QMF_32_ANALYSIS_ODD {1, 10, -72, 262, -685, 1500, -3235, 15472, 3864, -905, 173, 29, -46, 18, 0, -3}
+#define QMF_32_SYNTHESIS_EVEN {-6, 0, 36, -92, 58, 346, -1810, 7728, 30944, -6470, 3000, -1370, 524, -144, 20, 2}
+#define QMF_32_SYNTHESIS_ODD {2, 20, -144, 524, -1370, 3000, -6470, 30944, 7728, -1810, 346, 58, -92, 36, 0, -6}
+
+/*64 taps: 0.0017 dB reconstruction ripple, -77 dB above 0.64 pi*/
+#define QMF_64_ANALYSIS_EVEN {0, 0, -1, 1, 0, -3, 8, -16, 23, -20, -9, 89, -263, 623, -1434, 4332, 15209, -3255, 1780, -1119, 717, -447, 265, -146, 74, -34, 14, -5, 2, -1, 0, 0}
+#define QMF_64_ANALYSIS_ODD {0, 0, -1, 2, -5, 14, -34, 74, -146, 265, -447, 717, -1119, 1780, -3255, 15209, 4332, -1434, 623, -263, 89, -9, -20, 23, -16, 8, -3, 0, 1, -1, 0, 0}
+#define QMF_64_SYNTHESIS_EVEN {0, 0, -2, 2, 0, -6, 16, -32, 46, -40, -18, 178, -526, 1246, -2868, 8664, 30418, -6510, 3560, -2238, 1434, -894, 530, -292, 148, -68, 28, -10, 4, -2, 0, 0}
+#define QMF_64_SYNTHESIS_ODD {0, 0, -2, 4, -10, 28, -68, 148, -292, 530, -894, 1434, -2238, 3560, -6510, 30418, 8664, -2868, 1246, -526, 178, -18, -40, 46, -32, 16, -6, 0, 2, -2, 0, 0}
+
+#endif
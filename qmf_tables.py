@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""Generates qmf_tables.h, the QMF prototype filters of the filter banks.
+
+Each prototype h of even length N is linear phase (h[n] = h[N-1-n]) with a
+DC gain of one. Its taps are fitted by Levenberg-Marquardt so that the two
+band bank H0(z) = H(z), H1(z) = H(-z) reconstructs with little amplitude
+ripple, |H(w)|^2 + |H(pi-w)|^2 = 1, while keeping the stopband above ws
+small. The 20 tap prototype is the one the codec has always used, so its
+streams stay unchanged.
+
+The taps are scaled with 2^15 and split into the polyphase branches the
+kernels read: even[k] = h[2k], odd[k] = h[2k+1]. Synthesis uses twice these.
+
+    python3 qmf_tables.py > qmf_tables.h
+"""
+import math
+
+# Stopband edges as a fraction of pi: longer filters afford a narrower transition
+STOPBAND = {8: 0.85, 16: 0.76, 32: 0.70, 64: 0.64}
+
+LEGACY = {20: [-20, 82, 60, -398, 0, 1229, -599, -3137, 3554, 15618,
+               15618, 3554, -3137, -599, 1229, 0, -398, 60, 82, -20]}
+
+SCALE = 1 << 15
+
+
+def amplitude_basis(n, w):
+    """Amplitude response of the first half of a symmetric filter of length n at w, per tap"""
+    return [2 * math.cos(w * ((n - 1) / 2.0 - k)) for k in range(n // 2)]
+
+
+def solve(a, b):
+    """Gaussian elimination with partial pivoting"""
+    m = len(b)
+    a = [row[:] + [b[i]] for i, row in enumerate(a)]
+    for i in range(m):
+        p = max(range(i, m), key=lambda k: abs(a[k][i]))
+        a[i], a[p] = a[p], a[i]
+        for k in range(i + 1, m):
+            f = a[k][i] / a[i][i]
+            for j in range(i, m + 1):
+                a[k][j] -= f * a[i][j]
+    x = [0.0] * m
+    for i in reversed(range(m)):
+        x[i] = (a[i][m] - sum(a[i][j] * x[j] for j in range(i + 1, m))) / a[i][i]
+    return x
+
+
+def design(n, ws, iterations=60):
+    half = n // 2
+    points = 8 * n
+    stop = [amplitude_basis(n, ws + (math.pi - ws) * i / (points - 1)) for i in range(points)]
+    band = [math.pi / 2 * i / (points - 1) for i in range(points)]
+    lower = [amplitude_basis(n, w) for w in band]
+    upper = [amplitude_basis(n, math.pi - w) for w in band]
+
+    def residuals(h):
+        r, jacobian = [], []
+        for b in stop:
+            r.append(sum(x * y for x, y in zip(h, b)))
+            jacobian.append(b)
+        for b, c in zip(lower, upper):
+            a0 = sum(x * y for x, y in zip(h, b))
+            a1 = sum(x * y for x, y in zip(h, c))
+            r.append(a0 * a0 + a1 * a1 - 1)
+            jacobian.append([2 * a0 * y + 2 * a1 * z for y, z in zip(b, c)])
+        return r, jacobian
+
+    # Start from a Hamming windowed half band sinc
+    h = []
+    for k in range(half):
+        t = (n - 1) / 2.0 - k
+        h.append(math.sin(math.pi * t / 2) / (math.pi * t) * (0.54 - 0.46 * math.cos(2 * math.pi * k / (n - 1))))
+    gain = 2 * sum(h)
+    h = [x / gain for x in h]
+
+    r, jacobian = residuals(h)
+    cost = sum(x * x for x in r)
+    damping = 1e-3
+    for _ in range(iterations):
+        jtj = [[sum(row[i] * row[j] for row in jacobian) for j in range(half)] for i in range(half)]
+        jtr = [sum(row[i] * x for row, x in zip(jacobian, r)) for i in range(half)]
+        while True:
+            a = [row[:] for row in jtj]
+            for i in range(half):
+                a[i][i] += damping * (1 + jtj[i][i])
+            step = solve(a, [-x for x in jtr])
+            trial = [x + d for x, d in zip(h, step)]
+            rt, jt = residuals(trial)
+            ct = sum(x * x for x in rt)
+            if ct < cost:
+                h, r, jacobian, cost = trial, rt, jt, ct
+                damping = max(damping / 3, 1e-9)
+                break
+            damping *= 4
+            if damping > 1e6:
+                return h + h[::-1]
+    return h + h[::-1]
+
+
+def response(taps):
+    h = [x / SCALE for x in taps]
+
+    def magnitude(w):
+        return abs(sum(x * complex(math.cos(w * k), -math.sin(w * k)) for k, x in enumerate(h)))
+
+    ripple = max(abs(magnitude(w) ** 2 + magnitude(math.pi - w) ** 2 - 1) for w in [i * math.pi / 400 for i in range(401)])
+    return magnitude, 10 * math.log10(1 + ripple)
+
+
+def c_array(values):
+    return "{" + ", ".join(str(v) for v in values) + "}"
+
+
+def main():
+    lengths = sorted(list(STOPBAND) + list(LEGACY))
+
+    print("/* Generated by qmf_tables.py, do not edit.")
+    print(" *")
+    print(" * QMF prototype filters scaled with 2^15, split into polyphase branches:")
+    print(" * EVEN[k] = h[2k], ODD[k] = h[2k+1]. Synthesis uses twice the taps. */")
+    print("#ifndef __ENC_QMF_TABLES_H__")
+    print("#define __ENC_QMF_TABLES_H__")
+    print()
+    print("/*Calls X(length) for every prototype length, shortest first*/")
+    print("#define QMF_LENGTHS(X) " + " ".join("X(%d)" % n for n in lengths))
+
+    for n in lengths:
+        if n in LEGACY:
+            taps = LEGACY[n]
+            ws = 0.75
+        else:
+            taps = [int(round(x * SCALE)) for x in design(n, STOPBAND[n] * math.pi)]
+            ws = STOPBAND[n]
+
+        magnitude, ripple = response(taps)
+        stopband = max(magnitude(ws * math.pi + (1 - ws) * math.pi * i / 200) for i in range(201))
+        even, odd = taps[0::2], taps[1::2]
+
+        print()
+        print("/*%d taps: %.4f dB reconstruction ripple, %.0f dB above %.2f pi*/" % (n, ripple, 20 * math.log10(stopband), ws))
+        print("#define QMF_%d_ANALYSIS_EVEN %s" % (n, c_array(even)))
+        print("#define QMF_%d_ANALYSIS_ODD %s" % (n, c_array(odd)))
+        print("#define QMF_%d_SYNTHESIS_EVEN %s" % (n, c_array(2 * v for v in even)))
+        print("#define QMF_%d_SYNTHESIS_ODD %s" % (n, c_array(2 * v for v in odd)))
+
+    print()
+    print("#endif")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,524 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+#include "codec.h"
+#include "profile.h"
+#include "quantizer.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define __ENC_QUANT_X86__
+    #include <immintrin.h>
+#endif
+
+/* ceil(2^32 / d): (a * reciprocal) >> 32 equals a / d for every a < 2^32 / d,
+ * which covers |x - prediction| < 2^17 for all step sizes up to QMAX */
+#define RECIPROCAL(d) (0xFFFFFFFFu / (unsigned int) (d) + 1)
+#define DIVIDE(a, reciprocal) ((unsigned int) (((unsigned long long) (a) * (reciprocal)) >> 32))
+
+static unsigned int qstepReciprocal[QMAX + 1];
+static unsigned int qlengthReciprocal = 0;
+
+/* One channel (4 lanes) or two channels (8 lanes) per call */
+typedef void (*quantizer_single_t)(struct quantizer_struct *restrict state, short values[], short count);
+typedef void (*quantizer_pair_t)(struct quantizer_struct *restrict first, short firstValues[], struct quantizer_struct *restrict second, short secondValues[], short count);
+
+static void _quantizer_encode_scalar(struct quantizer_struct *restrict state, short values[], short count);
+static void _quantizer_decode_scalar(struct quantizer_struct *restrict state, short values[], short count);
+
+static quantizer_single_t encodeSingle = _quantizer_encode_scalar;
+static quantizer_single_t decodeSingle = _quantizer_decode_scalar;
+static quantizer_pair_t encodePair = NULL;
+static quantizer_pair_t decodePair = NULL;
+static const char *quantizer_name = "scalar";
+
+/* Adds the new dequantised difference to the window and adapts the step size:
+ * Qstep = roundDiv(sumAbs, QLENGTH) * PHI >> 13. As in the original roundDiv,
+ * means below one are never rounded up. */
+static inline void _quantizer_adapt(struct quantizer_struct *restrict state, short s, short diff)
+{
+    short *slot = &state->diff_deq[state->diff_deq_index][s];
+    unsigned int sum, mean, rem;
+
+    state->sumAbs[s] += abs(diff) - abs(*slot);
+    *slot = diff;
+
+    sum = (unsigned int) state->sumAbs[s];
+    mean = DIVIDE(sum, qlengthReciprocal);
+    rem = sum - mean * QLENGTH;
+    if ((rem << 1) > QLENGTH && mean > 0)
+        mean++;
+
+    state->Qstep[s] = (short) (((int) mean * state->profile->phi[s]) >> 13);
+    if (state->Qstep[s] < QMIN) {
+        state->Qstep[s] = QMIN;
+    } else if (state->Qstep[s] > state->profile->qmax[s]) {
+        state->Qstep[s] = state->profile->qmax[s];
+    }
+}
+
+static void _quantizer_encode_scalar(struct quantizer_struct *restrict state, short values[], short count)
+{
+    const short *minLevel = state->profile->minLevel;
+    const short *maxLevel = state->profile->maxLevel;
+    const short *mu = state->profile->mu;
+    short i, s, e;
+    short level;
+    short Qstep;
+    short diff;
+    int delta;
+    unsigned int magnitude, quot, rem;
+
+    for (i = 0 ; i < count ; i++) {
+        state->diff_deq_index++;
+        if (state->diff_deq_index >= QLENGTH) {
+            state->diff_deq_index = 0;
+        }
+
+        for (s = 0 ; s < 4 ; s++) {
+            e = (i << 2) + s;
+            Qstep = state->Qstep[s];
+
+            // roundDiv on the magnitude: truncating division is symmetric
+            delta = values[e] - state->prediction[s];
+            magnitude = (unsigned int) abs(delta);
+            quot = DIVIDE(magnitude, qstepReciprocal[Qstep]);
+            rem = magnitude - quot * Qstep;
+            if ((rem << 1) > (unsigned int) Qstep && quot > 0)
+                quot++;
+
+            level = (short) (delta < 0 ? -(int) quot : (int) quot);
+            if (delta < 0 && quot > (unsigned int) -minLevel[s]) {
+                level = minLevel[s];
+            } else if (delta >= 0 && quot > (unsigned int) maxLevel[s]) {
+                level = maxLevel[s];
+            }
+            values[e] = level;
+
+            diff = (short) (level * Qstep);
+            _quantizer_adapt(state, s, diff);
+
+            state->prediction[s] = (short)((mu[s]*(diff + state->prediction[s])) >> 15);
+        }
+    }
+}
+
+static void _quantizer_decode_scalar(struct quantizer_struct *restrict state, short values[], short count)
+{
+    const short *mu = state->profile->mu;
+    short i, s, e;
+    short diff;
+
+    for (i = 0 ; i < count ; i++) {
+        state->diff_deq_index++;
+        if (state->diff_deq_index >= QLENGTH) {
+            state->diff_deq_index = 0;
+        }
+
+        for (s = 0 ; s < 4 ; s++) {
+            e = (i << 2) + s;
+
+            diff = (short) (values[e] * state->Qstep[s]);
+            _quantizer_adapt(state, s, diff);
+
+            values[e] = (short) (diff + state->prediction[s]);
+            state->prediction[s] = (short)((mu[s]*(values[e])) >> 15);
+        }
+    }
+}
+
+#ifdef __ENC_QUANT_X86__
+    /* The vector kernels keep every lane in 32 bits and truncate to short where
+     * the scalar code does. Divisions are estimated in single precision and
+     * then corrected by at most one step on the exact integer remainder, so
+     * the result does not depend on the precision of rcpps. Magnitudes are
+     * limited to 32 * Qstep first: with at most MAX_NBITS bits anything above
+     * is clamped to the level range either way, and it keeps the estimate
+     * within one of the quotient. */
+
+    /*************************/
+    /** SSE4.1: one channel **/
+    /*************************/
+    #define SSE_LOAD4(p) _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *) (p)))
+    #define SSE_STORE4(p, v) _mm_storel_epi64((__m128i *) (p), _mm_packs_epi32((v), (v)))
+    #define SSE_SHORT(v) _mm_srai_epi32(_mm_slli_epi32((v), 16), 16)
+
+    /* Exact (quot, rem) of a / d from an estimate that is off by at most one */
+    __attribute__((target("sse4.1")))
+    static inline __m128i _divide_sse41(__m128i a, __m128i d, __m128 reciprocal, __m128i *rem) {
+        __m128i quot = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(a), reciprocal));
+        __m128i r = _mm_sub_epi32(a, _mm_mullo_epi32(quot, d));
+        __m128i fix = _mm_cmplt_epi32(r, _mm_setzero_si128());
+
+        quot = _mm_add_epi32(quot, fix);
+        r = _mm_add_epi32(r, _mm_and_si128(d, fix));
+        fix = _mm_cmpgt_epi32(r, _mm_sub_epi32(d, _mm_set1_epi32(1)));
+        quot = _mm_sub_epi32(quot, fix);
+        *rem = _mm_sub_epi32(r, _mm_and_si128(d, fix));
+
+        return quot;
+    }
+
+    /* roundDiv rounds up from above half, but never from zero */
+    __attribute__((target("sse4.1")))
+    static inline __m128i _round_sse41(__m128i quot, __m128i rem, __m128i d) {
+        __m128i up = _mm_and_si128(_mm_cmpgt_epi32(_mm_slli_epi32(rem, 1), d), _mm_cmpgt_epi32(quot, _mm_setzero_si128()));
+
+        return _mm_sub_epi32(quot, up);
+    }
+
+    __attribute__((target("sse4.1")))
+    static inline __m128i _adapt_sse41(struct quantizer_struct *restrict state, __m128i diff, __m128i *sumAbs, __m128i phiv, __m128i qmaxv) {
+        const __m128i qlength = _mm_set1_epi32(QLENGTH);
+        short *slot = state->diff_deq[state->diff_deq_index];
+        __m128i mean, rem;
+
+        *sumAbs = _mm_add_epi32(*sumAbs, _mm_sub_epi32(_mm_abs_epi32(diff), _mm_abs_epi32(SSE_LOAD4(slot))));
+        SSE_STORE4(slot, diff);
+
+        mean = _divide_sse41(*sumAbs, qlength, _mm_set1_ps(1.0f / QLENGTH), &rem);
+        mean = _round_sse41(mean, rem, qlength);
+
+        return _mm_min_epi32(_mm_max_epi32(SSE_SHORT(_mm_srai_epi32(_mm_mullo_epi32(mean, phiv), 13)), _mm_set1_epi32(QMIN)), qmaxv);
+    }
+
+    __attribute__((target("sse4.1")))
+    static void _quantizer_encode_sse41(struct quantizer_struct *restrict state, short values[], short count) {
+        const __m128i muv = SSE_LOAD4(state->profile->mu);
+        const __m128i phiv = SSE_LOAD4(state->profile->phi);
+        const __m128i qmaxv = SSE_LOAD4(state->profile->qmax);
+        const __m128i maxLevelv = SSE_LOAD4(state->profile->maxLevel);
+        const __m128i minLevelv = SSE_LOAD4(state->profile->minLevel);
+        __m128i prediction = SSE_LOAD4(state->prediction);
+        __m128i Qstep = SSE_LOAD4(state->Qstep);
+        __m128i sumAbs = _mm_loadu_si128((const __m128i *) state->sumAbs);
+        __m128i delta, magnitude, quot, rem, level, diff;
+        short i;
+
+        for (i = 0 ; i < count ; i++) {
+            state->diff_deq_index++;
+            if (state->diff_deq_index >= QLENGTH) {
+                state->diff_deq_index = 0;
+            }
+
+            delta = _mm_sub_epi32(SSE_LOAD4(values + (i << 2)), prediction);
+            magnitude = _mm_min_epi32(_mm_abs_epi32(delta), _mm_slli_epi32(Qstep, 5));
+            quot = _divide_sse41(magnitude, Qstep, _mm_rcp_ps(_mm_cvtepi32_ps(Qstep)), &rem);
+            quot = _round_sse41(quot, rem, Qstep);
+
+            level = _mm_min_epi32(_mm_max_epi32(_mm_sign_epi32(quot, delta), minLevelv), maxLevelv);
+            SSE_STORE4(values + (i << 2), level);
+
+            diff = SSE_SHORT(_mm_mullo_epi32(level, Qstep));
+            Qstep = _adapt_sse41(state, diff, &sumAbs, phiv, qmaxv);
+            prediction = SSE_SHORT(_mm_srai_epi32(_mm_mullo_epi32(muv, _mm_add_epi32(diff, prediction)), 15));
+        }
+
+        SSE_STORE4(state->prediction, prediction);
+        SSE_STORE4(state->Qstep, Qstep);
+        _mm_storeu_si128((__m128i *) state->sumAbs, sumAbs);
+    }
+
+    __attribute__((target("sse4.1")))
+    static void _quantizer_decode_sse41(struct quantizer_struct *restrict state, short values[], short count) {
+        const __m128i muv = SSE_LOAD4(state->profile->mu);
+        const __m128i phiv = SSE_LOAD4(state->profile->phi);
+        const __m128i qmaxv = SSE_LOAD4(state->profile->qmax);
+        __m128i prediction = SSE_LOAD4(state->prediction);
+        __m128i Qstep = SSE_LOAD4(state->Qstep);
+        __m128i sumAbs = _mm_loadu_si128((const __m128i *) state->sumAbs);
+        __m128i diff, reconstructed;
+        short i;
+
+        for (i = 0 ; i < count ; i++) {
+            state->diff_deq_index++;
+            if (state->diff_deq_index >= QLENGTH) {
+                state->diff_deq_index = 0;
+            }
+
+            diff = SSE_SHORT(_mm_mullo_epi32(SSE_LOAD4(values + (i << 2)), Qstep));
+            Qstep = _adapt_sse41(state, diff, &sumAbs, phiv, qmaxv);
+
+            reconstructed = SSE_SHORT(_mm_add_epi32(diff, prediction));
+            SSE_STORE4(values + (i << 2), reconstructed);
+            prediction = SSE_SHORT(_mm_srai_epi32(_mm_mullo_epi32(muv, reconstructed), 15));
+        }
+
+        SSE_STORE4(state->prediction, prediction);
+        SSE_STORE4(state->Qstep, Qstep);
+        _mm_storeu_si128((__m128i *) state->sumAbs, sumAbs);
+    }
+
+    /*************************/
+    /** AVX2: two channels  **/
+    /*************************/
+    #define AVX_LOAD8(p, q) _mm256_inserti128_si256(_mm256_castsi128_si256(SSE_LOAD4(p)), SSE_LOAD4(q), 1)
+    #define AVX_SHORT(v) _mm256_srai_epi32(_mm256_slli_epi32((v), 16), 16)
+
+    __attribute__((target("avx2")))
+    static inline void _store8_avx2(short *p, short *q, __m256i v) {
+        v = _mm256_packs_epi32(v, v);
+        _mm_storel_epi64((__m128i *) p, _mm256_castsi256_si128(v));
+        _mm_storel_epi64((__m128i *) q, _mm256_extracti128_si256(v, 1));
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i _divide_avx2(__m256i a, __m256i d, __m256 reciprocal, __m256i *rem) {
+        __m256i quot = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(a), reciprocal));
+        __m256i r = _mm256_sub_epi32(a, _mm256_mullo_epi32(quot, d));
+        __m256i fix = _mm256_cmpgt_epi32(_mm256_setzero_si256(), r);
+
+        quot = _mm256_add_epi32(quot, fix);
+        r = _mm256_add_epi32(r, _mm256_and_si256(d, fix));
+        fix = _mm256_cmpgt_epi32(r, _mm256_sub_epi32(d, _mm256_set1_epi32(1)));
+        quot = _mm256_sub_epi32(quot, fix);
+        *rem = _mm256_sub_epi32(r, _mm256_and_si256(d, fix));
+
+        return quot;
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i _round_avx2(__m256i quot, __m256i rem, __m256i d) {
+        __m256i up = _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_slli_epi32(rem, 1), d), _mm256_cmpgt_epi32(quot, _mm256_setzero_si256()));
+
+        return _mm256_sub_epi32(quot, up);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i _adapt_avx2(struct quantizer_struct *restrict first, struct quantizer_struct *restrict second, __m256i diff, __m256i *sumAbs, __m256i phiv, __m256i qmaxv) {
+        const __m256i qlength = _mm256_set1_epi32(QLENGTH);
+        short *firstSlot = first->diff_deq[first->diff_deq_index];
+        short *secondSlot = second->diff_deq[second->diff_deq_index];
+        __m256i mean, rem;
+
+        *sumAbs = _mm256_add_epi32(*sumAbs, _mm256_sub_epi32(_mm256_abs_epi32(diff), _mm256_abs_epi32(AVX_LOAD8(firstSlot, secondSlot))));
+        _store8_avx2(firstSlot, secondSlot, diff);
+
+        mean = _divide_avx2(*sumAbs, qlength, _mm256_set1_ps(1.0f / QLENGTH), &rem);
+        mean = _round_avx2(mean, rem, qlength);
+
+        return _mm256_min_epi32(_mm256_max_epi32(AVX_SHORT(_mm256_srai_epi32(_mm256_mullo_epi32(mean, phiv), 13)), _mm256_set1_epi32(QMIN)), qmaxv);
+    }
+
+    __attribute__((target("avx2")))
+    static void _quantizer_encode_avx2(struct quantizer_struct *restrict first, short firstValues[], struct quantizer_struct *restrict second, short secondValues[], short count) {
+        const __m256i muv = AVX_LOAD8(first->profile->mu, second->profile->mu);
+        const __m256i phiv = AVX_LOAD8(first->profile->phi, second->profile->phi);
+        const __m256i qmaxv = AVX_LOAD8(first->profile->qmax, second->profile->qmax);
+        const __m256i maxLevelv = AVX_LOAD8(first->profile->maxLevel, second->profile->maxLevel);
+        const __m256i minLevelv = AVX_LOAD8(first->profile->minLevel, second->profile->minLevel);
+        __m256i prediction = AVX_LOAD8(first->prediction, second->prediction);
+        __m256i Qstep = AVX_LOAD8(first->Qstep, second->Qstep);
+        __m256i sumAbs = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) first->sumAbs)), _mm_loadu_si128((const __m128i *) second->sumAbs), 1);
+        __m256i delta, magnitude, quot, rem, level, diff;
+        short i, e;
+
+        for (i = 0 ; i < count ; i++) {
+            e = i << 2;
+            if (++first->diff_deq_index >= QLENGTH) {
+                first->diff_deq_index = 0;
+            }
+            if (++second->diff_deq_index >= QLENGTH) {
+                second->diff_deq_index = 0;
+            }
+
+            delta = _mm256_sub_epi32(AVX_LOAD8(firstValues + e, secondValues + e), prediction);
+            magnitude = _mm256_min_epi32(_mm256_abs_epi32(delta), _mm256_slli_epi32(Qstep, 5));
+            quot = _divide_avx2(magnitude, Qstep, _mm256_rcp_ps(_mm256_cvtepi32_ps(Qstep)), &rem);
+            quot = _round_avx2(quot, rem, Qstep);
+
+            level = _mm256_min_epi32(_mm256_max_epi32(_mm256_sign_epi32(quot, delta), minLevelv), maxLevelv);
+            _store8_avx2(firstValues + e, secondValues + e, level);
+
+            diff = AVX_SHORT(_mm256_mullo_epi32(level, Qstep));
+            Qstep = _adapt_avx2(first, second, diff, &sumAbs, phiv, qmaxv);
+            prediction = AVX_SHORT(_mm256_srai_epi32(_mm256_mullo_epi32(muv, _mm256_add_epi32(diff, prediction)), 15));
+        }
+
+        _store8_avx2(first->prediction, second->prediction, prediction);
+        _store8_avx2(first->Qstep, second->Qstep, Qstep);
+        _mm_storeu_si128((__m128i *) first->sumAbs, _mm256_castsi256_si128(sumAbs));
+        _mm_storeu_si128((__m128i *) second->sumAbs, _mm256_extracti128_si256(sumAbs, 1));
+    }
+
+    __attribute__((target("avx2")))
+    static void _quantizer_decode_avx2(struct quantizer_struct *restrict first, short firstValues[], struct quantizer_struct *restrict second, short secondValues[], short count) {
+        const __m256i muv = AVX_LOAD8(first->profile->mu, second->profile->mu);
+        const __m256i phiv = AVX_LOAD8(first->profile->phi, second->profile->phi);
+        const __m256i qmaxv = AVX_LOAD8(first->profile->qmax, second->profile->qmax);
+        __m256i prediction = AVX_LOAD8(first->prediction, second->prediction);
+        __m256i Qstep = AVX_LOAD8(first->Qstep, second->Qstep);
+        __m256i sumAbs = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) first->sumAbs)), _mm_loadu_si128((const __m128i *) second->sumAbs), 1);
+        __m256i diff, reconstructed;
+        short i, e;
+
+        for (i = 0 ; i < count ; i++) {
+            e = i << 2;
+            if (++first->diff_deq_index >= QLENGTH) {
+                first->diff_deq_index = 0;
+            }
+            if (++second->diff_deq_index >= QLENGTH) {
+                second->diff_deq_index = 0;
+            }
+
+            diff = AVX_SHORT(_mm256_mullo_epi32(AVX_LOAD8(firstValues + e, secondValues + e), Qstep));
+            Qstep = _adapt_avx2(first, second, diff, &sumAbs, phiv, qmaxv);
+
+            reconstructed = AVX_SHORT(_mm256_add_epi32(diff, prediction));
+            _store8_avx2(firstValues + e, secondValues + e, reconstructed);
+            prediction = AVX_SHORT(_mm256_srai_epi32(_mm256_mullo_epi32(muv, reconstructed), 15));
+        }
+
+        _store8_avx2(first->prediction, second->prediction, prediction);
+        _store8_avx2(first->Qstep, second->Qstep, Qstep);
+        _mm_storeu_si128((__m128i *) first->sumAbs, _mm256_castsi256_si128(sumAbs));
+        _mm_storeu_si128((__m128i *) second->sumAbs, _mm256_extracti128_si256(sumAbs, 1));
+    }
+#endif
+
+/* Builds the reciprocal tables and picks the kernels, once */
+static void _quantizer_setup()
+{
+    short i;
+
+    for (i = QMIN ; i <= QMAX ; i++)
+        qstepReciprocal[i] = RECIPROCAL(i);
+    qlengthReciprocal = RECIPROCAL(QLENGTH);
+
+    #ifdef __ENC_QUANT_X86__
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("sse4.1")) {
+            encodeSingle = _quantizer_encode_sse41;
+            decodeSingle = _quantizer_decode_sse41;
+            quantizer_name = "sse4.1";
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            encodePair = _quantizer_encode_avx2;
+            decodePair = _quantizer_decode_avx2;
+            quantizer_name = "avx2";
+        }
+    #endif
+
+    #ifdef VERBOSE
+        printf("Quantizer kernel: %s\n", quantizer_name);
+    #endif
+}
+
+void quantizer_construct(struct quantizer_struct *state, const struct profile_struct *profile)
+{
+    short i;
+
+    memset(state, 0, sizeof(struct quantizer_struct));
+    state->profile = profile;
+
+    /* initializing for quantisation */
+    for (i = 0 ; i < 4 ; i++)
+        state->Qstep[i] = QSTART;
+
+    if (qlengthReciprocal == 0)
+        _quantizer_setup();
+}
+
+void quantizer_encode(struct quantizer_struct *const states[], short *const values[], short channels, short count)
+{
+    short c = 0;
+
+    if (encodePair != NULL) {
+        for ( ; c + 1 < channels ; c += 2)
+            encodePair(states[c], values[c], states[c + 1], values[c + 1], count);
+    }
+
+    for ( ; c < channels ; c++)
+        encodeSingle(states[c], values[c], count);
+}
+
+void quantizer_decode(struct quantizer_struct *const states[], short *const values[], short channels, short count)
+{
+    short c = 0;
+
+    if (decodePair != NULL) {
+        for ( ; c + 1 < channels ; c += 2)
+            decodePair(states[c], values[c], states[c + 1], values[c + 1], count);
+    }
+
+    for ( ; c < channels ; c++)
+        decodeSingle(states[c], values[c], count);
+}
+
+/* Every profile keeps qmax << 13 / phi within a short */
+static void _quantizer_flatten(struct quantizer_struct *state)
+{
+    short i, s;
+    short mean;
+
+    for (s = 0 ; s < 4 ; s++) {
+        mean = (short) ((((int) state->Qstep[s] << 13) + (state->profile->phi[s] >> 1)) / state->profile->phi[s]);
+
+        for (i = 0 ; i < QLENGTH ; i++)
+            state->diff_deq[i][s] = mean;
+        state->sumAbs[s] = mean * QLENGTH;
+    }
+
+    state->diff_deq_index = 0;
+}
+
+void quantizer_export(struct quantizer_struct *state, short words[])
+{
+    _quantizer_flatten(state);
+
+    memcpy(words, state->Qstep, 4 * sizeof(short));
+    memcpy(words + 4, state->prediction, 4 * sizeof(short));
+}
+
+void quantizer_import(struct quantizer_struct *state, const short words[])
+{
+    short s;
+
+    // A corrupt snapshot must not leave the step size range the kernels rely on
+    for (s = 0 ; s < 4 ; s++) {
+        state->Qstep[s] = words[s];
+        if (state->Qstep[s] < QMIN) {
+            state->Qstep[s] = QMIN;
+        } else if (state->Qstep[s] > state->profile->qmax[s]) {
+            state->Qstep[s] = state->profile->qmax[s];
+        }
+    }
+
+    memcpy(state->prediction, words + 4, 4 * sizeof(short));
+    _quantizer_flatten(state);
+}
+
+void quantizer_serialize(const struct quantizer_struct *state, short words[])
+{
+    memcpy(words, state->Qstep, 4 * sizeof(short));
+    memcpy(words + 4, state->prediction, 4 * sizeof(short));
+    memcpy(words + 8, state->diff_deq, QLENGTH * 4 * sizeof(short));
+    words[8 + 4 * QLENGTH] = state->diff_deq_index;
+}
+
+void quantizer_deserialize(struct quantizer_struct *state, const short words[])
+{
+    short i, s;
+
+    memcpy(state->Qstep, words, 4 * sizeof(short));
+    memcpy(state->prediction, words + 4, 4 * sizeof(short));
+    memcpy(state->diff_deq, words + 8, QLENGTH * 4 * sizeof(short));
+    state->diff_deq_index = words[8 + 4 * QLENGTH];
+
+    // A corrupt state must not leave the ranges the kernels rely on
+    if (state->diff_deq_index < 0 || state->diff_deq_index >= QLENGTH)
+        state->diff_deq_index = 0;
+
+    for (s = 0 ; s < 4 ; s++) {
+        if (state->Qstep[s] < QMIN) {
+            state->Qstep[s] = QMIN;
+        } else if (state->Qstep[s] > state->profile->qmax[s]) {
+            state->Qstep[s] = state->profile->qmax[s];
+        }
+
+        state->sumAbs[s] = 0;
+        for (i = 0 ; i < QLENGTH ; i++)
+            state->sumAbs[s] += abs(state->diff_deq[i][s]);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef __ENC_QUANTIZER_H__
+#define __ENC_QUANTIZER_H__
+
+/* Adaptive ADPCM quantiser of four subband lanes of a channel.
+ *
+ * values[c] holds 4 entries per step, one per lane: a channel of a deeper
+ * subband tree is coded as GROUPS(depth) states, one per block of its frame
+ * (see codec.h), each with the profile_struct of its group.
+ * quantizer_encode() turns subband samples into levels in place,
+ * quantizer_decode() turns levels back into reconstructed subband samples.
+ * The state is laid out per subband lane, so the vector kernels advance the
+ * four subbands of two channels (8 lanes) in one step. Level ranges and step
+ * size adaptation come from the bit allocation profile. */
+struct quantizer_struct {
+    const struct profile_struct *profile;
+
+    short prediction[4];
+    short Qstep[4];
+    short diff_deq[QLENGTH][4];
+    short diff_deq_index;
+
+    /*Running sum of abs(diff_deq[...][s]) over the window*/
+    int sumAbs[4];
+};
+
+void quantizer_construct(struct quantizer_struct *state, const struct profile_struct *profile);
+void quantizer_encode(struct quantizer_struct *const states[], short *const values[], short channels, short count);
+void quantizer_decode(struct quantizer_struct *const states[], short *const values[], short channels, short count);
+
+/* Sync points: both ends replace the window by the mean difference that gives
+ * the current step size, so the SYNC_WORDS of step sizes and predictions that
+ * quantizer_export() writes restore the whole state with quantizer_import(). */
+void quantizer_export(struct quantizer_struct *state, short words[]);
+void quantizer_import(struct quantizer_struct *state, const short words[]);
+
+/* Live migration: the whole state in QUANTIZER_STATE_WORDS words, the step
+ * sizes, predictions, window and its position, which quantizer_deserialize()
+ * restores exactly into a state constructed with the same profile. */
+#define QUANTIZER_STATE_WORDS (9 + 4 * QLENGTH)
+
+void quantizer_serialize(const struct quantizer_struct *state, short words[]);
+void quantizer_deserialize(struct quantizer_struct *state, const short words[]);
+
+#endif
@@ -25,6 +25,11 @@ digit_t receiver_senderModExp[ENC_PRIVATE_KEY_DIGITS];
 uint8_t receiverAESKey[ENC_AES_KEY_CHARS];
 uint8_t receiverHashKey[ENC_HMAC_KEY_CHARS];
 uint8_t receiverCTRNonce[ENC_CTR_NONCE_CHARS];
+uint8_t receiverChaChaKey[ENC_CHACHA_KEY_CHARS];
+
+struct enc_cipher_ctx receiverCipher;
+
+uint8_t receiverSuite;
 
 uint32_t receiverPacketCounter[1];
 
@@ -36,6 +41,9 @@ void receiver_construct() {
     memset(receiverAESKey, 0, ENC_AES_KEY_CHARS*sizeof(uint8_t));
     memset(receiverHashKey, 0, ENC_HMAC_KEY_CHARS*sizeof(uint8_t));
     memset(receiverCTRNonce, 0, ENC_CTR_NONCE_CHARS*sizeof(uint8_t));
+    memset(receiverChaChaKey, 0, ENC_CHACHA_KEY_CHARS*sizeof(uint8_t));
+    memset(&receiverCipher, 0, sizeof(struct enc_cipher_ctx));
+    receiverSuite = 0;
 
     memset(receiverPacketCounter, 0, sizeof(uint32_t));
 }
@@ -51,13 +59,13 @@ int receiver_receiverHello() {
         printf("--> receiver_receiverHello\n");
     #endif
 
-    returnStatus = receiverHello(sendPacket, receiver_receiverModExp, receivedPacket, receiverSecret, receiver_senderModExp, (unsigned char *) Enc_ReceiverPrivateExp);
+    returnStatus = receiverHello(sendPacket, receiver_receiverModExp, receivedPacket, receiverSecret, receiver_senderModExp, (unsigned char *) Enc_ReceiverPrivateExp, &receiverSuite);
     channel_write(sendPacket, ENC_KEY_PACKET_CHARS);
 
     return returnStatus;
 }
 
-void receiver_deriveKey(uint8_t *restrict aesKey, uint8_t *restrict CTRNonce, digit_t *restrict modExp) {
+void receiver_deriveKey(struct enc_cipher_ctx *restrict cipher, digit_t *restrict modExp, uint8_t offeredSuites, uint8_t suite) {
 	digit_t symmetricKey[ENC_PRIVATE_KEY_DIGITS];
 
     #ifndef __ENC_NO_PRINTS__
@@ -66,9 +74,8 @@ void receiver_deriveKey(uint8_t *restrict aesKey, uint8_t *restrict CTRNonce, di
 
     memcpy(receiver_senderModExp, modExp, ENC_PRIVATE_KEY_DIGITS);
 	_calculateSymmetricKey(symmetricKey, receiver_senderModExp, receiverSecret);
-	_deriveKeys(receiverAESKey, receiverHashKey, receiverCTRNonce, symmetricKey);
-    memcpy(aesKey, receiverAESKey, ENC_AES_KEY_CHARS);
-    memcpy(CTRNonce, receiverCTRNonce, ENC_CTR_NONCE_CHARS);
+	_deriveKeys(receiverAESKey, receiverHashKey, receiverCTRNonce, receiverChaChaKey, &receiverCipher, symmetricKey, offeredSuites, suite);
+    memcpy(cipher, &receiverCipher, sizeof(struct enc_cipher_ctx));
 }
 
 int receiver_receiveData() {
@@ -88,10 +95,42 @@ int receiver_receiveData() {
         printf("--------\n");
     #endif
 
-    channel_read(dataPacket, ENC_DATA_PACKET_CHARS);
+    // The AEAD packets carry a shorter tag than the HMAC
+    channel_read(dataPacket, (receiverSuite != ENC_SUITE_CTR_HMAC) ? ENC_AEAD_PACKET_CHARS : ENC_DATA_PACKET_CHARS);
 
     memcpy(&receivedPacketCounter, dataPacket+1, sizeof(uint32_t));
 
+    // The AEAD suites decrypt with the counter of the packet and only a packet with a valid tag moves the counter
+    if (receiverSuite != ENC_SUITE_CTR_HMAC) {
+        if (dataPacket[0] != ((receiverSuite == ENC_SUITE_AES_GCM) ? 0x04 : 0x05))
+            return ENC_REJECT_PACKET_TAG;
+        else if (*receiverPacketCounter > receivedPacketCounter)
+            return ENC_LOST_PACKET;
+        else if (_openData(data, &receiverCipher, receiverSuite, receivedPacketCounter, dataPacket, 5, dataPacket+5, ENC_DATA_SIZE_CHARS, dataPacket+5+ENC_DATA_SIZE_CHARS) != ENC_ACCEPT_PACKET)
+            return ENC_TAG_REJECTED;
+
+        while (*receiverPacketCounter != receivedPacketCounter) {
+            if (increaseCounter(receiverPacketCounter) == ENC_COUNTER_WRAPAROUND)
+                return ENC_COUNTER_WRAPAROUND;
+        }
+
+        #ifndef __ENC_NO_PRINTS__
+            printf("--| receiverPacketCounter: %d\n", *receiverPacketCounter);
+        #endif
+
+        #ifndef __ENC_NO_ENCRYPTION_PRINTS__
+            printf("--| data\n");
+            mpConvFromOctets(dataDigits, ENC_DATA_SIZE_DIGITS, data, ENC_DATA_SIZE_CHARS);
+            mpPrintNL(dataDigits, ENC_DATA_SIZE_DIGITS);
+            printf("\n");
+        #endif
+
+        while (buffer_isModified()) {}
+        buffer_write(data, ENC_DATA_SIZE_CHARS);
+
+        return ENC_ACCEPT_PACKET;
+    }
+
     if (receiver_checkHmac(dataPacket) == ENC_HMAC_REJECTED) {
         return ENC_HMAC_REJECTED;
     } else if (dataPacket[0] != 0x03) {
@@ -116,7 +155,7 @@ int receiver_receiveData() {
             mpPrintNL(dataDigits, ENC_DATA_SIZE_DIGITS);
         #endif
 
-        _decryptData(data, receiverAESKey, receiverCTRNonce, *receiverPacketCounter, encryptedData, ENC_DATA_SIZE_CHARS);
+        _decryptData(data, &receiverCipher, *receiverPacketCounter, encryptedData, ENC_DATA_SIZE_CHARS);
 
         #ifndef __ENC_NO_ENCRYPTION_PRINTS__
             printf("--| data\n");
@@ -152,7 +191,7 @@ int receiver_checkSenderAcknowledge() {
         memcpy(ackSignature, senderAck+1, ENC_ENCRYPTED_SIGNATURE_CHARS);
 
         // Decrypt Signature
-        _decryptData(decryptedSignature, receiverAESKey, receiverCTRNonce, 0, ackSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
+        _decryptData(decryptedSignature, &receiverCipher, 0, ackSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
         mpConvFromOctets(signature, ENC_ENCRYPTED_SIGNATURE_DIGITS, decryptedSignature, ENC_ENCRYPTED_SIGNATURE_CHARS);
 
         // Calculate alpha^x | alpha^y
@@ -186,3 +225,21 @@ int receiver_checkHmac(field_t *restrict dataPacket) {
 
     return ENC_HMAC_ACCEPTED;
 }
+
+size_t receiver_serialize(uint8_t *restrict state) {
+    return serializeSession(state, ENC_SESSION_RECEIVER, receiverSuite, receiverAESKey, receiverHashKey, receiverCTRNonce, receiverChaChaKey, *receiverPacketCounter, senderTrusted);
+}
+
+int receiver_deserialize(uint8_t *restrict state, size_t length) {
+    int returnStatus;
+
+    #ifndef __ENC_NO_PRINTS__
+        printf("--> receiver_deserialize\n");
+    #endif
+
+    returnStatus = deserializeSession(state, length, ENC_SESSION_RECEIVER, &receiverSuite, receiverAESKey, receiverHashKey, receiverCTRNonce, receiverChaChaKey, receiverPacketCounter, &senderTrusted);
+    if (returnStatus == ENC_ACCEPT_PACKET)
+        _initCipher(&receiverCipher, receiverAESKey, receiverCTRNonce, receiverChaChaKey);
+
+    return returnStatus;
+}
@@ -8,12 +8,19 @@
 #include "channel.h"
 #include "protocol.h"
 
+// Defined in crypto.h, which includes this header before it
+struct enc_cipher_ctx;
+
 
 void receiver_construct();
 
 int receiver_receiverHello();
-void receiver_deriveKey(uint8_t *restrict aesKey, uint8_t *restrict CTRNonce, digit_t *restrict modExp);
+void receiver_deriveKey(struct enc_cipher_ctx *restrict cipher, digit_t *restrict modExp, uint8_t offeredSuites, uint8_t suite);
 int receiver_receiveData();
 int receiver_checkSenderAcknowledge();
 
+// Session State: the keys, packet counter and trust of an established session, ENC_SESSION_CHARS long
+size_t receiver_serialize(uint8_t *restrict state);
+int receiver_deserialize(uint8_t *restrict state, size_t length);
+
 #endif
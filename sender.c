@@ -21,6 +21,11 @@ digit_t sender_receiverModExp[ENC_PRIVATE_KEY_DIGITS];
 uint8_t senderAESKey[ENC_AES_KEY_CHARS];
 uint8_t senderHashKey[ENC_HMAC_KEY_CHARS];
 uint8_t senderCTRNonce[ENC_CTR_NONCE_CHARS];
+uint8_t senderChaChaKey[ENC_CHACHA_KEY_CHARS];
+
+struct enc_cipher_ctx senderCipher;
+
+uint8_t senderSuite;
 
 uint32_t senderPacketCounter[1];
 
@@ -31,6 +36,9 @@ void sender_construct() {
     memset(senderAESKey, 0, ENC_AES_KEY_CHARS);
     memset(senderHashKey, 0, ENC_HMAC_KEY_CHARS);
     memset(senderCTRNonce, 0, ENC_CTR_NONCE_CHARS);
+    memset(senderChaChaKey, 0, ENC_CHACHA_KEY_CHARS);
+    memset(&senderCipher, 0, sizeof(struct enc_cipher_ctx));
+    senderSuite = 0;
 
     memset(senderPacketCounter, 0, sizeof(uint32_t));
 }
@@ -58,14 +66,14 @@ int sender_senderAcknowledge() {
         printf("--> sender_senderAcknowledge\n");
     #endif
 
-    returnStatus = senderAcknowledge(sendPacket, receivedPacket, senderSecret, sender_receiverModExp, sender_senderModExp, (unsigned char *) Enc_SenderPrivateExp);
+    returnStatus = senderAcknowledge(sendPacket, receivedPacket, senderSecret, sender_receiverModExp, sender_senderModExp, (unsigned char *) Enc_SenderPrivateExp, &senderSuite);
 
     channel_write(sendPacket, ENC_KEY_PACKET_CHARS);
 
     return returnStatus;
 }
 
-void sender_deriveKey(uint8_t *restrict aesKey, uint8_t *restrict CTRNonce, digit_t *restrict modExp) {
+void sender_deriveKey(struct enc_cipher_ctx *restrict cipher, digit_t *restrict modExp, uint8_t offeredSuites, uint8_t suite) {
 	digit_t symmetricKey[ENC_PRIVATE_KEY_DIGITS];
 
     #ifndef __ENC_NO_PRINTS__
@@ -74,9 +82,8 @@ void sender_deriveKey(uint8_t *restrict aesKey, uint8_t *restrict CTRNonce, digi
 
     memcpy(sender_receiverModExp, modExp, ENC_PRIVATE_KEY_DIGITS);
 	_calculateSymmetricKey(symmetricKey, sender_receiverModExp, senderSecret);
-	_deriveKeys(senderAESKey, senderHashKey, senderCTRNonce, symmetricKey);
-    memcpy(aesKey, senderAESKey, ENC_AES_KEY_CHARS);
-    memcpy(CTRNonce, senderCTRNonce, ENC_CTR_NONCE_CHARS);
+	_deriveKeys(senderAESKey, senderHashKey, senderCTRNonce, senderChaChaKey, &senderCipher, symmetricKey, offeredSuites, suite);
+    memcpy(cipher, &senderCipher, sizeof(struct enc_cipher_ctx));
 }
 
 int sender_sendData() {
@@ -110,7 +117,25 @@ int sender_sendData() {
         mpPrintNL(dataDigits, ENC_DATA_SIZE_DIGITS);
     #endif
 
-    _encryptData(encryptedData, senderAESKey, senderCTRNonce, *senderPacketCounter, data, ENC_DATA_SIZE_CHARS);
+    // AES-GCM (0x04) and ChaCha20-Poly1305 (0x05): tag | packet counter | data | AEAD tag,
+    // the first 5 bytes authenticated with the data
+    if (senderSuite != ENC_SUITE_CTR_HMAC) {
+        dataPacket[0] = (senderSuite == ENC_SUITE_AES_GCM) ? 0x04 : 0x05;
+        memcpy(dataPacket+1, senderPacketCounter, sizeof(uint32_t));
+        _sealData(dataPacket+5, dataPacket+5+ENC_DATA_SIZE_CHARS, &senderCipher, senderSuite, *senderPacketCounter, dataPacket, 5, data, ENC_DATA_SIZE_CHARS);
+
+        #ifndef __ENC_NO_ENCRYPTION_PRINTS__
+            printf("--| encryptedData\n");
+            mpConvFromOctets(dataDigits, ENC_DATA_SIZE_DIGITS, dataPacket+5, ENC_DATA_SIZE_CHARS);
+            mpPrintNL(dataDigits, ENC_DATA_SIZE_DIGITS);
+        #endif
+
+        channel_write(dataPacket, ENC_AEAD_PACKET_CHARS);
+
+        return increaseCounter(senderPacketCounter);
+    }
+
+    _encryptData(encryptedData, &senderCipher, *senderPacketCounter, data, ENC_DATA_SIZE_CHARS);
 
     #ifndef __ENC_NO_ENCRYPTION_PRINTS__
         printf("--| encryptedData\n");
@@ -141,3 +166,22 @@ int sender_sendData() {
 
     return increaseCounter(senderPacketCounter);
 }
+
+size_t sender_serialize(uint8_t *restrict state) {
+    return serializeSession(state, ENC_SESSION_SENDER, senderSuite, senderAESKey, senderHashKey, senderCTRNonce, senderChaChaKey, *senderPacketCounter, false);
+}
+
+int sender_deserialize(uint8_t *restrict state, size_t length) {
+    int returnStatus;
+    bool trusted;
+
+    #ifndef __ENC_NO_PRINTS__
+        printf("--> sender_deserialize\n");
+    #endif
+
+    returnStatus = deserializeSession(state, length, ENC_SESSION_SENDER, &senderSuite, senderAESKey, senderHashKey, senderCTRNonce, senderChaChaKey, senderPacketCounter, &trusted);
+    if (returnStatus == ENC_ACCEPT_PACKET)
+        _initCipher(&senderCipher, senderAESKey, senderCTRNonce, senderChaChaKey);
+
+    return returnStatus;
+}
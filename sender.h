@@ -7,11 +7,18 @@
 #include "channel.h"
 #include "protocol.h"
 
+// Defined in crypto.h, which includes this header before it
+struct enc_cipher_ctx;
+
 void sender_construct();
 
 void sender_senderHello();
 int sender_senderAcknowledge();
-void sender_deriveKey(uint8_t aesKey[], uint8_t CTRNonce[], digit_t *restrict modExp);
+void sender_deriveKey(struct enc_cipher_ctx *restrict cipher, digit_t *restrict modExp, uint8_t offeredSuites, uint8_t suite);
 int sender_sendData();
 
+// Session State: the keys and packet counter of an established session, ENC_SESSION_CHARS long
+size_t sender_serialize(uint8_t *restrict state);
+int sender_deserialize(uint8_t *restrict state, size_t length);
+
 #endif
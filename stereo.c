@@ -0,0 +1,56 @@
+#include <stdlib.h>
+#include "globals.h"
+#include "codec.h"
+#include "stereo.h"
+
+static inline short _saturate(int value)
+{
+    return (short) (value > 32767 ? 32767 : (value < -32768 ? -32768 : value));
+}
+
+short stereo_classify(const short left[], const short right[], short frameSize)
+{
+    short i;
+    long mid = 0;
+    long side = 0;
+
+    // Magnitudes rather than squares, which a long holds for any frame
+    for (i = 0 ; i < frameSize ; i++) {
+        mid += abs(left[i] + right[i]);
+        side += abs(left[i] - right[i]);
+    }
+
+    if (side * STEREO_MID_RATIO <= mid)
+        return STEREO_MID;
+    if (side * STEREO_MS_RATIO <= mid)
+        return STEREO_MS;
+
+    return STEREO_LR;
+}
+
+void stereo_forward(short *restrict left, short *restrict right, short frameSize)
+{
+    short i;
+    int l, r;
+
+    for (i = 0 ; i < frameSize ; i++) {
+        l = left[i];
+        r = right[i];
+        left[i] = (short) ((l + r) >> 1);
+        right[i] = (short) ((l - r) >> 1);
+    }
+}
+
+void stereo_inverse(short *restrict mid, short *restrict side, short frameSize)
+{
+    short i;
+    int m, s;
+
+    // Reconstructed values may leave the range the encoder's had
+    for (i = 0 ; i < frameSize ; i++) {
+        m = mid[i];
+        s = side[i];
+        mid[i] = _saturate(m + s);
+        side[i] = _saturate(m - s);
+    }
+}
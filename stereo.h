@@ -0,0 +1,36 @@
+#ifndef __ENC_STEREO_H__
+#define __ENC_STEREO_H__
+
+/* Joint stereo.
+ *
+ * With CODEC_JOINT channels 2k and 2k + 1 of a stream form pair k, which every
+ * frame codes in one of the modes below, in 2 bits; a last channel without a
+ * pair has no mode. With CODEC_DTX the modes follow the types in the DTX header,
+ * pair k at bits 2k above them, else the mode of a pair takes the top 2 bits of
+ * the levels of its first channel, whose section every such frame carries.
+ * The transform works on the subband values of a frame rather than on its pcm.
+ * The filter banks are linear, so the result is the same, and the filter
+ * histories stay those of the left and right channel whatever the mode.
+ * The side channel is coded with profile_side() of the stream's profile, and
+ * left out when it is silent next to the mid. Whenever a mode change alters the
+ * signal a channel codes, its quantiser restarts on both ends. */
+#define STEREO_LR 0 /*left and right, as without CODEC_JOINT*/
+#define STEREO_MS 1 /*mid (L + R) / 2 and side (L - R) / 2*/
+#define STEREO_MID 2 /*mid only, the side has no section and decodes as zero*/
+
+#define STEREO_MODE(word, pair) (((word) >> ((pair) << 1)) & 3)
+/*Bits of the modes of a frame of channels*/
+#define STEREO_BITS(channels) (((channels) >> 1) << 1)
+
+/*Side below mid by these factors of their summed magnitudes, about 12 and 30 dB*/
+#define STEREO_MS_RATIO 4
+#define STEREO_MID_RATIO 32
+
+/* Picks the mode of a frame from the subband values of its left and right channel */
+short stereo_classify(const short left[], const short right[], short frameSize);
+/* Turns left and right into mid and side in place */
+void stereo_forward(short *restrict left, short *restrict right, short frameSize);
+/* Turns mid and side back into left and right in place */
+void stereo_inverse(short *restrict mid, short *restrict side, short frameSize);
+
+#endif
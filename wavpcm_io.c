@@ -131,7 +131,7 @@ void wavpcm_input_open (struct wavpcm_input *input) {
     printf("Error: Unsupported bit depth %d cannot be translated.\n", input->bitDepth);
     exit(1);
   }
-  if (input->channels > 2) {
+  if (input->channels < 1 || input->channels > MAX_CHANNELS) {
     printf("Error: Unsupported number of channels %d  cannot be handled.\n", input->channels);
     exit(1);
   }
@@ -142,16 +142,15 @@ void wavpcm_input_open (struct wavpcm_input *input) {
 /**************************************************************************
 ****************** THIS SUB READS DATA FROM AN INPUT SOURCE ***************
 ***************************************************************************/
-int wavpcm_input_read (struct wavpcm_input *input, short destBuffer[BUFFERSIZE]) {
-  /* PCM Wave File. We always declare a buffer of constant size BUFFERSIZE
-   * with all data expanded to 16-bit resolution, and potential mono inputs
-   * duplicated to stereo */
-  int tempBufferSize = BUFFERSIZE / 2;     /* how many temporal samples per buffer, regardless of channels */
+int wavpcm_input_read (struct wavpcm_input *input, short *const destBuffers[], int frameSize) {
+  /* PCM Wave File. We always fill one buffer of frameSize elements per
+   * channel (planar), with all data expanded to 16-bit resolution */
+  int tempBufferSize = frameSize;          /* how many temporal samples per buffer, regardless of channels */
   int blockAlign = (input->bitDepth / 8) * input->channels; /* How many bytes per temporal sample in input */
   int bytesToRead = tempBufferSize * blockAlign;               /* How many bytes to read to fill tempBuffer*/
 
   int readSize; /* bytes actually read */
-  int destPos, copyPos;
+  int destPos, copyPos, channel;
 
   if (fseek(input->fileHandle, input->currentPosition, SEEK_SET)) {
     printf("Read error: unexpected end of file.\n");
@@ -163,30 +162,24 @@ int wavpcm_input_read (struct wavpcm_input *input, short destBuffer[BUFFERSIZE])
   if (input->bitDepth == 8) {
     /* We then need to read the data into that buffer. We don't check readSize here.
      * The reason is that we may have really found the end of the file, which is OK.  */
-    char tempBuffer[BUFFERSIZE];
+    char tempBuffer[MAX_CHANNELS*MAX_FRAMESIZE];
     readSize = fread(tempBuffer, 1, bytesToRead, input->fileHandle);
 
-    for (destPos = 0; destPos<BUFFERSIZE; destPos+=2) {
-      destBuffer[destPos] = 256 * (short) tempBuffer[copyPos]; /* expand 8 bit to 16 bit */
-      if (input->channels == 2)
-	destBuffer[destPos + 1] = 256 * (short) tempBuffer[copyPos + 1];
-      else
-	destBuffer[destPos + 1] = destBuffer[destPos];
+    for (destPos = 0; destPos<frameSize; destPos++) {
+      for (channel = 0; channel < input->channels; channel++)
+	destBuffers[channel][destPos] = 256 * (short) tempBuffer[copyPos + channel]; /* expand 8 bit to 16 bit */
       copyPos += input->channels;
     }
   }
   else if (input->bitDepth == 16) {
     /* We then need to read the data into that buffer. We don't check readSize here.
      * The reason is that we may have really found the end of the file, which is OK.  */
-    short tempBuffer[BUFFERSIZE];
+    short tempBuffer[MAX_CHANNELS*MAX_FRAMESIZE];
     readSize = fread(tempBuffer, 1, bytesToRead, input->fileHandle);
 
-    for (destPos = 0; destPos<BUFFERSIZE; destPos+=2) {
-      destBuffer[destPos] = tempBuffer[copyPos]; /* not expanded */
-      if (input->channels == 2)
-	destBuffer[destPos + 1] = tempBuffer[copyPos + 1];
-      else
-	destBuffer[destPos + 1] = destBuffer[destPos];
+    for (destPos = 0; destPos<frameSize; destPos++) {
+      for (channel = 0; channel < input->channels; channel++)
+	destBuffers[channel][destPos] = tempBuffer[copyPos + channel]; /* not expanded */
       copyPos += input->channels;
     }
   }
@@ -257,7 +250,7 @@ void wavpcm_output_copy_settings (struct wavpcm_input *input, struct wavpcm_outp
     printf("Write error: invalid input samplingRate reference.\n");
     exit(1);
   }
-  if ( (input->channels == 1) || (input->channels == 2) ) {
+  if ( (input->channels >= 1) && (input->channels <= MAX_CHANNELS) ) {
     output->channels = input->channels;
   }
   else {
@@ -270,41 +263,37 @@ void wavpcm_output_copy_settings (struct wavpcm_input *input, struct wavpcm_outp
 /**************************************************************************
 *********************** THIS SUB WRITES TO AN OUTPUT **********************
 ***************************************************************************/
-void wavpcm_output_write (struct wavpcm_output *output, short inputBuffer[BUFFERSIZE], int bytesToWrite)
+void wavpcm_output_write (struct wavpcm_output *output, short *const inputBuffers[], int bytesToWrite)
 {
   /* Declare variables. */
   int curPos = 0;
+  int copyPos = 0;
+  int channel;
   int channels = output->channels;
   int bitDepth = output->bitDepth;
 
-  /* (max) bytesToRead was: BUFFERSIZE/2 * bitDepth/8 * channels */
-  /* -> maximal buffer index is: (2*bytesToWrite)/(bitDepth/8 * channels) */
-  int bufferEndIndex = (2*bytesToWrite)/(bitDepth/8 * channels);
+  /* (max) bytesToRead was: frameSize * bitDepth/8 * channels */
+  /* -> number of temporal samples per channel buffer is: bytesToWrite/(bitDepth/8 * channels) */
+  int bufferEndIndex = bytesToWrite/(bitDepth/8 * channels);
 
-  /* Copy input buffer into tempBuffer, doing any conversions along the way. */
+  /* Interleave the channel buffers into tempBuffer, doing any conversions along the way. */
   if (bitDepth == 8) {
-    /* written sample per sample */
-    char toWrite;
-    for (curPos = 0; curPos < bufferEndIndex; curPos += 2) {/* buffer aways in stereo: curPos +=2 */
-      toWrite = (char) (inputBuffer[curPos] / 256);
-      fwrite(&toWrite, 1, 1, output->fileHandle);
-      if (channels == 2) {
-	toWrite = (char) (inputBuffer[curPos + 1] / 256);
-	fwrite(&toWrite, 1, 1, output->fileHandle);
-      }
+    char tempBuffer[MAX_CHANNELS*MAX_FRAMESIZE];
+    for (curPos = 0; curPos < bufferEndIndex; curPos++) {
+      for (channel = 0; channel < channels; channel++)
+	tempBuffer[copyPos + channel] = (char) (inputBuffers[channel][curPos] / 256);
+      copyPos += channels;
     }
+    fwrite(tempBuffer, 1, copyPos, output->fileHandle);
   }
   else if (bitDepth == 16) {
-    /* written sample per sample */
-    short toWrite;
-    for (curPos = 0; curPos < bufferEndIndex; curPos += 2) {
-      toWrite = inputBuffer[curPos];
-      fwrite(&toWrite, 2, 1, output->fileHandle);
-      if (channels == 2){
-	toWrite = inputBuffer[curPos+1];
-	fwrite(&toWrite, 2, 1, output->fileHandle);
-      }
+    short tempBuffer[MAX_CHANNELS*MAX_FRAMESIZE];
+    for (curPos = 0; curPos < bufferEndIndex; curPos++) {
+      for (channel = 0; channel < channels; channel++)
+	tempBuffer[copyPos + channel] = inputBuffers[channel][curPos];
+      copyPos += channels;
     }
+    fwrite(tempBuffer, 2, copyPos, output->fileHandle);
   }
   else {
     printf("Error: Unsupported bit depth %d cannot be dumped.\n", bitDepth);
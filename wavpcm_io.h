@@ -51,8 +51,8 @@ struct wavpcm_output
 };
 
 void wavpcm_input_open (struct wavpcm_input *input);
-int  wavpcm_input_read (struct wavpcm_input *input, short buffer[BUFFERSIZE]);
+int  wavpcm_input_read (struct wavpcm_input *input, short *const buffers[], int frameSize);
 void wavpcm_output_open (struct wavpcm_output *output);
 void wavpcm_output_copy_settings (struct wavpcm_input *input, struct wavpcm_output *output);
-void wavpcm_output_write (struct wavpcm_output *output, short inputBuffer[BUFFERSIZE], int bufferBytes);
+void wavpcm_output_write (struct wavpcm_output *output, short *const inputBuffers[], int bufferBytes);
 void wavpcm_output_close (struct wavpcm_output *output);
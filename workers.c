@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "globals.h"
+#include "workers.h"
+
+#ifdef ENC_THREADS
+    #include <pthread.h>
+
+    static pthread_t workers[MAX_WORKERS];
+    static short workerCount = 0;
+
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    static pthread_cond_t wakeup = PTHREAD_COND_INITIALIZER;
+    static pthread_cond_t finished = PTHREAD_COND_INITIALIZER;
+
+    /*Current job, guarded by lock*/
+    static worker_task_t jobTask;
+    static void *jobArg;
+    static short jobCount;
+    static short jobNext;
+    static short jobPending;
+    static unsigned int jobGeneration = 0;
+    static short stopping = 0;
+
+    /* Runs tasks of the current job until none are left; called with lock held */
+    static void _drain() {
+        short index;
+
+        while (jobNext < jobCount) {
+            index = jobNext++;
+
+            pthread_mutex_unlock(&lock);
+            jobTask(jobArg, index);
+            pthread_mutex_lock(&lock);
+
+            if (--jobPending == 0) {
+                pthread_cond_signal(&finished);
+            }
+        }
+    }
+
+    static void *_worker(void *unused) {
+        unsigned int generation = 0;
+
+        pthread_mutex_lock(&lock);
+        while (1) {
+            while (!stopping && generation == jobGeneration) {
+                pthread_cond_wait(&wakeup, &lock);
+            }
+
+            if (stopping) {
+                break;
+            }
+
+            generation = jobGeneration;
+            _drain();
+        }
+        pthread_mutex_unlock(&lock);
+
+        return NULL;
+    }
+#endif
+
+void workers_construct(short count) {
+    #ifdef ENC_THREADS
+        if (count > MAX_WORKERS) {
+            count = MAX_WORKERS;
+        }
+
+        stopping = 0;
+        for (workerCount = 0; workerCount < count; workerCount++) {
+            if (pthread_create(&workers[workerCount], NULL, _worker, NULL) != 0) {
+                printf("Failed to start worker thread %d\n", workerCount);
+                exit(1);
+            }
+        }
+
+        #ifdef VERBOSE
+            printf("Worker threads: %d\n", workerCount);
+        #endif
+    #endif
+}
+
+void workers_run(worker_task_t task, void *arg, short count) {
+    short i;
+
+    #ifdef ENC_THREADS
+        if (workerCount > 0 && count > 1) {
+            pthread_mutex_lock(&lock);
+            jobTask = task;
+            jobArg = arg;
+            jobCount = count;
+            jobNext = 0;
+            jobPending = count;
+            jobGeneration++;
+            pthread_cond_broadcast(&wakeup);
+
+            _drain();
+            while (jobPending > 0) {
+                pthread_cond_wait(&finished, &lock);
+            }
+            pthread_mutex_unlock(&lock);
+
+            return;
+        }
+    #endif
+
+    for (i = 0; i < count; i++) {
+        task(arg, i);
+    }
+}
+
+void workers_destruct() {
+    #ifdef ENC_THREADS
+        short i;
+
+        pthread_mutex_lock(&lock);
+        stopping = 1;
+        pthread_cond_broadcast(&wakeup);
+        pthread_mutex_unlock(&lock);
+
+        for (i = 0; i < workerCount; i++) {
+            pthread_join(workers[i], NULL);
+        }
+        workerCount = 0;
+    #endif
+}
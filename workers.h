@@ -0,0 +1,16 @@
+#ifndef __ENC_WORKERS_H__
+#define __ENC_WORKERS_H__
+
+/* Worker pool for data-parallel codec work.
+ *
+ * workers_run() calls task(arg, index) once for every index in [0, count)
+ * and returns when all of them have finished. The calling thread takes part,
+ * so a pool of N workers runs up to N + 1 tasks at a time. Without
+ * ENC_THREADS (e.g. on the DSP) every task runs on the calling thread. */
+typedef void (*worker_task_t)(void *arg, short index);
+
+void workers_construct(short count);
+void workers_run(worker_task_t task, void *arg, short count);
+void workers_destruct();
+
+#endif